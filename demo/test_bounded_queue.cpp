@@ -0,0 +1,128 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <queue>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+#include "bounded_queue.h"
+
+// producer -> consumer handoff latency of BoundedQueue against the std::queue + usleep(2000) polling that
+// MapBuilder used before, for frames arriving at a camera rate and for a burst of back-to-back frames
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+// the polling of the old MapBuilder: the producer waits while the queue holds more than max_size items and the
+// consumer sleeps 2 ms whenever the queue is empty
+class PollingQueue{
+public:
+  explicit PollingQueue(size_t max_size) : _max_size(max_size), _shutdown(false){}
+
+  void Push(const TimePoint& item){
+    while(Size() > _max_size){
+      usleep(2000);
+    }
+    std::unique_lock<std::mutex> locker(_mutex);
+    _queue.push(item);
+  }
+
+  bool Pop(TimePoint& item){
+    while(true){
+      {
+        std::unique_lock<std::mutex> locker(_mutex);
+        if(!_queue.empty()){
+          item = _queue.front();
+          _queue.pop();
+          return true;
+        }
+        if(_shutdown) return false;
+      }
+      usleep(2000);
+    }
+  }
+
+  void Shutdown(){
+    std::unique_lock<std::mutex> locker(_mutex);
+    _shutdown = true;
+  }
+
+private:
+  size_t Size(){
+    std::unique_lock<std::mutex> locker(_mutex);
+    return _queue.size();
+  }
+
+private:
+  size_t _max_size;
+  bool _shutdown;
+  std::queue<TimePoint> _queue;
+  std::mutex _mutex;
+};
+
+// push frame_num timestamps every interval_us and return the latency of each handoff in ms, the consumer
+// spends work_us on every item like a pipeline stage
+template <class Queue>
+std::vector<double> MeasureHandoff(Queue& queue, int frame_num, int interval_us, int work_us, double& total_ms){
+  std::vector<double> latencies;
+  latencies.reserve(frame_num);
+  TimePoint start = std::chrono::steady_clock::now();
+  std::thread consumer([&](){
+    TimePoint item;
+    while(queue.Pop(item)){
+      latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - item).count() / 1000.0);
+      if(work_us > 0) std::this_thread::sleep_for(std::chrono::microseconds(work_us));
+    }
+  });
+
+  for(int i = 0; i < frame_num; i++){
+    if(interval_us > 0){
+      std::this_thread::sleep_until(start + std::chrono::microseconds((long)i * interval_us));
+    }
+    queue.Push(std::chrono::steady_clock::now());
+  }
+  queue.Shutdown();
+  consumer.join();
+  total_ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+  return latencies;
+}
+
+void PrintLatency(const std::string& name, std::vector<double> latencies, double total_ms){
+  std::sort(latencies.begin(), latencies.end());
+  double sum = 0;
+  for(double latency : latencies) sum += latency;
+  size_t n = std::max(latencies.size(), (size_t)1);
+  std::cout << name << ": mean = " << sum / n << " ms, p50 = " << latencies[n / 2] << " ms, p99 = "
+            << latencies[std::min(n - 1, n * 99 / 100)] << " ms, max = " << latencies.back() << " ms, total = "
+            << total_ms << " ms" << std::endl;
+}
+
+template <class Queue>
+void TestQueue(const std::string& name, Queue& queue, int frame_num, int interval_us, int work_us){
+  double total_ms = 0;
+  std::vector<double> latencies = MeasureHandoff(queue, frame_num, interval_us, work_us, total_ms);
+  PrintLatency(name, latencies, total_ms);
+}
+
+int main(int argc, char **argv){
+  const int frame_num = 400;
+
+  // 200 Hz input, a consumer that keeps up
+  {
+    BoundedQueue<TimePoint> bounded_queue(4);
+    PollingQueue polling_queue(3);
+    TestQueue("camera rate, BoundedQueue", bounded_queue, frame_num, 5000, 1000);
+    TestQueue("camera rate, usleep polling", polling_queue, frame_num, 5000, 1000);
+  }
+
+  // back-to-back input, the producer is throttled by the consumer, so the latency is mostly the wait behind the
+  // queued items and the total time shows if the consumer is kept busy
+  {
+    BoundedQueue<TimePoint> bounded_queue(4);
+    PollingQueue polling_queue(3);
+    TestQueue("burst, BoundedQueue", bounded_queue, frame_num, 0, 1000);
+    TestQueue("burst, usleep polling", polling_queue, frame_num, 0, 1000);
+  }
+  return 0;
+}
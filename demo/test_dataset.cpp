@@ -0,0 +1,45 @@
+#include <iostream>
+#include <chrono>
+#include <opencv2/opencv.hpp>
+#include <ros/ros.h>
+
+#include "dataset.h"
+
+// measure the throughput of the dataset layer alone, e.g. to choose prefetch_thread_num for batch runs
+int main(int argc, char **argv) {
+  ros::init(argc, argv, "air_slam");
+
+  std::string dataroot;
+  bool use_imu = false;
+  int prefetch_thread_num = 2;
+  int prefetch_buffer_size = 8;
+  ros::param::get("~dataroot", dataroot);
+  ros::param::get("~use_imu", use_imu);
+  ros::param::get("~prefetch_thread_num", prefetch_thread_num);
+  ros::param::get("~prefetch_buffer_size", prefetch_buffer_size);
+
+  Dataset dataset(dataroot, use_imu);
+  std::cout << "dataset length = " << dataset.GetDatasetLength() << std::endl;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  dataset.StartPrefetch(prefetch_thread_num, prefetch_buffer_size);
+
+  size_t idx;
+  cv::Mat image_left, image_right;
+  double timestamp;
+  ImuDataList batch_imu_data;
+  int image_num = 0;
+  size_t imu_num = 0;
+  while(ros::ok() && dataset.GetNextData(idx, image_left, image_right, batch_imu_data, timestamp)){
+    image_num++;
+    imu_num += batch_imu_data.size();
+  }
+
+  auto stop = std::chrono::high_resolution_clock::now();
+  double cost_time = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() / 1000.0;
+  std::cout << "prefetch_thread_num = " << prefetch_thread_num << ", prefetch_buffer_size = " << prefetch_buffer_size << std::endl;
+  std::cout << "Read " << image_num << " stereo pairs and " << imu_num << " imu data in " << cost_time << " s" << std::endl;
+  std::cout << "Average Dataset FPS = " << image_num / cost_time << std::endl;
+
+  return 0;
+}
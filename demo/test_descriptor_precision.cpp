@@ -0,0 +1,138 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <malloc.h>
+#include <Eigen/Core>
+
+#include "utils.h"
+#include "map.h"
+#include "compact_descriptors.h"
+
+// accuracy and memory of the fp16 and int8 keyframe descriptors on a saved map:
+// test_descriptor_precision <map_root>, where map_root contains AirSLAM_mapv0.bin
+
+std::shared_ptr<Map> LoadMap(const std::string& map_path){
+  std::shared_ptr<Map> map = std::shared_ptr<Map>(new Map());
+  std::ifstream ifs(map_path, std::ios::binary);
+  boost::archive::binary_iarchive ia(ifs);
+  ia >> map;
+  // the float descriptors are the reference, also if the map was saved with compressed descriptors
+  for(auto& kv : map->GetAllKeyframes()){
+    kv.second->GetAllFeatures().DecompressDescriptors();
+    kv.second->GetJunctions().DecompressDescriptors();
+  }
+  return map;
+}
+
+size_t SerializedSize(std::shared_ptr<Map> map){
+  std::ostringstream oss;
+  boost::archive::binary_oarchive oa(oss);
+  oa << map;
+  return oss.str().size();
+}
+
+size_t DescriptorBytes(std::shared_ptr<Map> map){
+  size_t bytes = 0;
+  for(auto& kv : map->GetAllKeyframes()){
+    bytes += kv.second->GetAllFeatures().DescriptorBytes() + kv.second->GetJunctions().DescriptorBytes();
+  }
+  return bytes;
+}
+
+// resident memory in MB
+double ResidentMemory(){
+  malloc_trim(0);
+  std::ifstream ifs("/proc/self/status");
+  std::string line;
+  while(std::getline(ifs, line)){
+    if(line.compare(0, 6, "VmRSS:") == 0) return std::stod(line.substr(6)) / 1024.0;
+  }
+  return -1;
+}
+
+int NearestNeighbor(const Eigen::Matrix<float, 256, 1>& descriptor, const FeatureSet::Descriptors& descriptors){
+  int best_idx = -1;
+  float best_score = -2;
+  for(int j = 0; j < descriptors.cols(); j++){
+    float score = descriptor.dot(descriptors.col(j));
+    if(score > best_score){
+      best_score = score;
+      best_idx = j;
+    }
+  }
+  return best_idx;
+}
+
+void RunPrecision(const std::string& map_path, int precision){
+  double memory_before = ResidentMemory();
+  std::shared_ptr<Map> map = LoadMap(map_path);
+  double memory_float = ResidentMemory() - memory_before;
+  size_t bytes_float = DescriptorBytes(map);
+  size_t map_size_float = SerializedSize(map);
+
+  for(auto& kv : map->GetAllKeyframes()){
+    kv.second->CompressDescriptors(precision);
+  }
+  double memory_compressed = ResidentMemory() - memory_before;
+  size_t bytes_compressed = DescriptorBytes(map);
+  size_t map_size = SerializedSize(map);
+
+  // accuracy against the float descriptors of a second copy of the map: the reconstruction error and
+  // the nearest neighbor of each descriptor in the next keyframe
+  std::shared_ptr<Map> reference_map = LoadMap(map_path);
+  std::map<int, FramePtr>& keyframes = map->GetAllKeyframes();
+  std::map<int, FramePtr>& reference_keyframes = reference_map->GetAllKeyframes();
+  double max_error = 0, sum_error = 0, decode_time = 0;
+  size_t value_num = 0, nn_num = 0, same_nn_num = 0;
+  FeatureSet::Descriptors decoded, next_decoded;
+  for(auto it = keyframes.begin(); it != keyframes.end(); ++it){
+    const FeatureSet& features = it->second->GetAllFeatures();
+    const FeatureSet::Descriptors& reference = reference_keyframes[it->first]->GetAllFeatures().descriptors;
+    decoded.resize(256, features.Size());
+    auto t0 = std::chrono::high_resolution_clock::now();
+    features.DecodeDescriptors(decoded.data());
+    auto t1 = std::chrono::high_resolution_clock::now();
+    decode_time += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() / 1000.0;
+    if(decoded.size() == 0) continue;
+
+    Eigen::ArrayXXf error = (decoded - reference).array().abs();
+    max_error = std::max(max_error, (double)error.maxCoeff());
+    sum_error += error.sum();
+    value_num += error.size();
+
+    auto next = std::next(it);
+    if(next == keyframes.end()) continue;
+    const FeatureSet::Descriptors& next_reference = reference_keyframes[next->first]->GetAllFeatures().descriptors;
+    const FeatureSet& next_features = next->second->GetAllFeatures();
+    next_decoded.resize(256, next_features.Size());
+    next_features.DecodeDescriptors(next_decoded.data());
+    if(next_decoded.size() == 0) continue;
+    for(int i = 0; i < decoded.cols(); i++){
+      nn_num++;
+      same_nn_num += (NearestNeighbor(decoded.col(i), next_decoded) == NearestNeighbor(reference.col(i), next_reference));
+    }
+  }
+
+  std::cout << "precision " << precision << ": keyframes = " << keyframes.size()
+            << ", descriptors = " << bytes_float / 1048576.0 << " -> " << bytes_compressed / 1048576.0 << " MB"
+            << ", resident memory = " << memory_float << " -> " << memory_compressed << " MB"
+            << ", map size = " << map_size_float / 1048576.0 << " -> " << map_size / 1048576.0 << " MB" << std::endl;
+  std::cout << "    max error = " << max_error << ", mean error = " << sum_error / std::max(value_num, (size_t)1)
+            << ", same nearest neighbor = " << 100.0 * same_nn_num / std::max(nn_num, (size_t)1) << " %"
+            << ", decoding = " << decode_time / std::max(keyframes.size(), (size_t)1) << " ms per keyframe" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  if(argc < 2){
+    std::cout << "Usage: test_descriptor_precision <map_root>" << std::endl;
+    return 0;
+  }
+  std::string map_path = ConcatenateFolderAndFileName(argv[1], "AirSLAM_mapv0.bin");
+  std::ifstream ifs(map_path, std::ios::binary | std::ios::ate);
+  std::cout << "map = " << map_path << ", " << ifs.tellg() / 1048576.0 << " MB" << std::endl;
+
+  RunPrecision(map_path, Float16Descriptor);
+  RunPrecision(map_path, Int8Descriptor);
+  return 0;
+}
@@ -12,6 +12,128 @@
 
 #include "plnet.h"
 #include "feature_detector.h"
+#include "point_matcher.h"
+#include "inference_engine.h"
+
+double ElapsedMs(std::chrono::high_resolution_clock::time_point start){
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+}
+
+// run SuperPoint, PLNet and LightGlue on the images with the backend and print their mean latency
+void TestBackend(int backend, std::vector<cv::Mat>& images, PLNetConfig plnet_config,
+    PointMatcherConfig point_matcher_config, const std::string& save_root){
+  plnet_config.backend = backend;
+  point_matcher_config.backend = backend;
+  FeatureDetectorPtr feature_detector = std::shared_ptr<FeatureDetector>(new FeatureDetector(plnet_config));
+  PointMatcherPtr point_matcher = std::shared_ptr<PointMatcher>(new PointMatcher(point_matcher_config));
+
+  std::string backend_name = InferenceBackendName(backend);
+  double superpoint_time = 0, plnet_time = 0, lightglue_time = 0;
+  int frame_num = 0, match_num = 0;
+  FeatureSet last_features;
+  for(size_t i = 0; i < images.size() && ros::ok(); ++i){
+    FeatureSet features, plnet_features;
+    std::vector<Eigen::Vector4d> lines;
+
+    auto before_superpoint = std::chrono::high_resolution_clock::now();
+    feature_detector->Detect(images[i], features);
+    double superpoint_ms = ElapsedMs(before_superpoint);
+
+    auto before_plnet = std::chrono::high_resolution_clock::now();
+    feature_detector->Detect(images[i], plnet_features, lines);
+    double plnet_ms = ElapsedMs(before_plnet);
+
+    double lightglue_ms = 0;
+    std::vector<cv::DMatch> matches;
+    if(i > 0){
+      auto before_lightglue = std::chrono::high_resolution_clock::now();
+      point_matcher->MatchingPoints(last_features, features, matches);
+      lightglue_ms = ElapsedMs(before_lightglue);
+    }
+    last_features = features;
+
+    // the first frame warms up the engines and is not counted
+    if(i > 0){
+      superpoint_time += superpoint_ms;
+      plnet_time += plnet_ms;
+      lightglue_time += lightglue_ms;
+      match_num += matches.size();
+      frame_num++;
+    }
+
+    std::cout << backend_name << " i = " << i << ", keypoints = " << features.Size() << ", lines = " << lines.size()
+              << ", matches = " << matches.size() << ", SuperPoint = " << superpoint_ms << " ms, PLNet = "
+              << plnet_ms << " ms, LightGlue = " << lightglue_ms << " ms" << std::endl;
+    SaveLineDetectionResult(images[i], lines, save_root, backend_name + "_" + std::to_string(i));
+  }
+
+  frame_num = std::max(frame_num, 1);
+  std::cout << backend_name << " mean latency: SuperPoint = " << superpoint_time / frame_num << " ms, PLNet = "
+            << plnet_time / frame_num << " ms, LightGlue = " << lightglue_time / frame_num << " ms, matches = "
+            << match_num / frame_num << std::endl;
+}
+
+// relocalization-like matching of one query to K candidate keyframes, K sequential MatchingPoints calls against
+// one MatchingPointsBatch call, the candidates are the frames with the same number of keypoints as the first one
+void TestBatchMatching(int backend, std::vector<cv::Mat>& images, PLNetConfig plnet_config,
+    PointMatcherConfig point_matcher_config, int candidate_num){
+  plnet_config.backend = backend;
+  point_matcher_config.backend = backend;
+  point_matcher_config.max_batch_size = candidate_num;
+  // an engine file of its own, the one of TestBackend is built for single pairs
+  std::string& engine_file = point_matcher_config.engine_file;
+  engine_file = engine_file.substr(0, engine_file.rfind(".engine")) + "_batch" + std::to_string(candidate_num) + ".engine";
+  FeatureDetectorPtr feature_detector = std::shared_ptr<FeatureDetector>(new FeatureDetector(plnet_config));
+  PointMatcherPtr point_matcher = std::shared_ptr<PointMatcher>(new PointMatcher(point_matcher_config));
+
+  std::vector<FeatureSet> features;
+  for(size_t i = 0; i < images.size(); ++i){
+    FeatureSet image_features;
+    feature_detector->Detect(images[i], image_features);
+    if(features.empty() || image_features.Size() == features[0].Size()) features.push_back(image_features);
+  }
+  if((int)features.size() < candidate_num + 1){
+    std::cout << "not enough frames with " << (features.empty() ? 0 : features[0].Size()) << " keypoints" << std::endl;
+    return;
+  }
+
+  std::string backend_name = InferenceBackendName(backend);
+  double sequential_time = 0, batch_time = 0;
+  int sequential_match_num = 0, batch_match_num = 0, query_num = 0;
+  for(size_t q = 0; q + candidate_num < features.size() && ros::ok(); ++q){
+    std::vector<const FeatureSet*> candidates;
+    for(int k = 1; k <= candidate_num; ++k) candidates.push_back(&features[q + k]);
+
+    auto before_sequential = std::chrono::high_resolution_clock::now();
+    int match_num = 0;
+    for(const FeatureSet* candidate : candidates){
+      std::vector<cv::DMatch> matches;
+      match_num += point_matcher->MatchingPoints(features[q], *candidate, matches, true);
+    }
+    double sequential_ms = ElapsedMs(before_sequential);
+
+    auto before_batch = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<cv::DMatch>> matches_list;
+    int batch_num = point_matcher->MatchingPointsBatch(features[q], candidates, matches_list, true);
+    double batch_ms = ElapsedMs(before_batch);
+
+    // the first query warms up the engines and is not counted
+    if(q > 0){
+      sequential_time += sequential_ms;
+      batch_time += batch_ms;
+      sequential_match_num += match_num;
+      batch_match_num += batch_num;
+      query_num++;
+    }
+  }
+
+  query_num = std::max(query_num, 1);
+  std::cout << backend_name << " " << candidate_num << " candidates of " << features[0].Size() << " keypoints: "
+            << candidate_num << " sequential calls = " << sequential_time / query_num << " ms ("
+            << sequential_match_num / query_num << " matches), batch = " << batch_time / query_num << " ms ("
+            << batch_match_num / query_num << " matches)" << std::endl;
+}
 
 int main(int argc, char **argv) {
   ros::init(argc, argv, "air_slam");
@@ -28,6 +150,8 @@ int main(int argc, char **argv) {
 
   MakeDir(save_root);
 
+  CameraPtr _camera = std::shared_ptr<Camera>(new Camera(camera_config_path));
+
   PLNetConfig plnet_config;
   plnet_config.use_superpoint = 1;
   plnet_config.max_keypoints = 400;
@@ -35,47 +159,41 @@ int main(int argc, char **argv) {
   plnet_config.remove_borders = 4;
   plnet_config.line_threshold = 0.5;
   plnet_config.line_length_threshold = 50;
+  plnet_config.cpu_threads = 0;
   plnet_config.SetModelPath(model_dir);
 
-  CameraPtr _camera = std::shared_ptr<Camera>(new Camera(camera_config_path));
-
-  FeatureDetectorPtr feature_detector = std::shared_ptr<FeatureDetector>(new FeatureDetector(plnet_config));
+  PointMatcherConfig point_matcher_config;
+  point_matcher_config.matcher = 0;
+  point_matcher_config.image_width = _camera->ImageWidth();
+  point_matcher_config.image_height = _camera->ImageHeight();
+  point_matcher_config.onnx_file = ConcatenateFolderAndFileName(model_dir, "superpoint_lightglue.onnx");
+  point_matcher_config.engine_file = ConcatenateFolderAndFileName(model_dir, "superpoint_lightglue.engine");
+  point_matcher_config.cpu_threads = 0;
 
   std::vector<std::string> image_names;
   GetFileNames(dataroot, image_names);
-  size_t dataset_length = image_names.size();
-  // dataset_length = 14;
-  for(size_t i = 0; i < dataset_length && ros::ok(); ++i){
-    std::cout << "i ====== " << i << std::endl;
-
+  size_t dataset_length = std::min(image_names.size(), (size_t)50);
+  std::vector<cv::Mat> images;
+  for(size_t i = 0; i < dataset_length; ++i){
     std::string image_path = ConcatenateFolderAndFileName(dataroot, image_names[i]);
     cv::Mat image = cv::imread(image_path, 0);
-
     cv::Mat image_left_rect;
     _camera->UndistortImage(image, image_left_rect);
-
-    Eigen::Matrix<float, 259, Eigen::Dynamic> features;
-    std::vector<float> line_scores;
-    std::vector<Eigen::Vector4d> lines;
-
-    auto before_infer = std::chrono::high_resolution_clock::now();
-
-    cv::Mat resized_image;
-    cv::resize(image_left_rect, resized_image, cv::Size(512, 512));
-
-    // feature_detector->Detect(image_left_rect, features);
-    feature_detector->Detect(image_left_rect, features, lines);
-
-    SaveLineDetectionResult(image_left_rect, lines, save_root, std::to_string(i));
-    // SaveDetectorResult(image_left_rect, features, save_root, std::to_string(i));
-
-    std::cout << "lines ====== " << lines.size() << std::endl;
-
-    auto after_infer = std::chrono::high_resolution_clock::now();
-    auto cost_time = std::chrono::duration_cast<std::chrono::milliseconds>(after_infer - before_infer).count();
-    std::cout << "One Frame Processinh Time: " << cost_time << " ms." << std::endl;
+    images.push_back(image_left_rect);
   }
 
+  std::vector<int> backends;
+#ifdef WITH_TENSORRT
+  backends.push_back(TensorRTBackend);
+#endif
+  backends.push_back(OpenCVBackend);
+  for(int backend : backends){
+    TestBackend(backend, images, plnet_config, point_matcher_config, save_root);
+  }
+  for(int backend : backends){
+    TestBatchMatching(backend, images, plnet_config, point_matcher_config, 3);
+    TestBatchMatching(backend, images, plnet_config, point_matcher_config, 5);
+  }
 
   ros::shutdown();
 
@@ -0,0 +1,243 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <Eigen/Core>
+
+#include "keypoint_decoder.h"
+
+// micro benchmark of KeypointDecoder on synthetic score and descriptor maps, checked against the straightforward
+// implementations (scan all pixels and sort all candidates, sample the channel-first descriptor map, suppress
+// the keypoints by brute force)
+void ReferenceDetectKeypoints(const float* heat_map, Eigen::Matrix<float, 259, Eigen::Dynamic>& features,
+    int h, int w, float threshold, int border, int top_k){
+  std::vector<float> scores_v, kpt_xs, kpt_ys;
+  for(int i = 0; i < w * h; ++i){
+    if(heat_map[i] < threshold) continue;
+    int y = i / w;
+    int x = i - y * w;
+    if(x < border || x > w - border || y < border || y > h - border) continue;
+    scores_v.emplace_back(heat_map[i]);
+    kpt_xs.emplace_back(float(x));
+    kpt_ys.emplace_back(float(y));
+  }
+
+  std::vector<size_t> indexes(scores_v.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+  if((int)scores_v.size() > top_k){
+    std::sort(indexes.begin(), indexes.end(), [&scores_v](size_t i1, size_t i2){
+      return scores_v[i1] > scores_v[i2] || (scores_v[i1] == scores_v[i2] && i1 < i2);
+    });
+    indexes.resize(top_k);
+  }
+  features.resize(259, indexes.size());
+  for(size_t i = 0; i < indexes.size(); ++i){
+    features(0, i) = scores_v[indexes[i]];
+    features(1, i) = kpt_xs[indexes[i]];
+    features(2, i) = kpt_ys[indexes[i]];
+  }
+}
+
+template<int Rows>
+void ReferenceExtractDescriptors(const float *descriptors, Eigen::Matrix<float, Rows, Eigen::Dynamic> &features, 
+    int h, int w, int s){
+  float sx = 2.f / (w * s - s / 2 - 0.5);
+  float bx = (1 - s) / (w * s - s / 2 - 0.5) - 1;
+  float sy = 2.f / (h * s - s / 2 - 0.5);
+  float by = (1 - s) / (h * s - s / 2 - 0.5) - 1;
+  auto clip = [](int val, int max){ return val < 0 ? 0 : std::min(val, max - 1); };
+
+  Eigen::Array<float, 1, Eigen::Dynamic> kpts_x_norm = features.block(1, 0, 1, features.cols()).array() * sx + bx;
+  Eigen::Array<float, 1, Eigen::Dynamic> kpts_y_norm = features.block(2, 0, 1, features.cols()).array() * sy + by;
+  kpts_x_norm = (kpts_x_norm + 1) * 0.5;
+  kpts_y_norm = (kpts_y_norm + 1) * 0.5;
+
+  for(int j = 0; j < features.cols(); ++j){
+    float ix = kpts_x_norm(0, j) * (w - 1);
+    float iy = kpts_y_norm(0, j) * (h - 1);
+    int ix_nw = clip(std::floor(ix), w);
+    int iy_nw = clip(std::floor(iy), h);
+    int ix_ne = clip(ix_nw + 1, w);
+    int iy_ne = clip(iy_nw, h);
+    int ix_sw = clip(ix_nw, w);
+    int iy_sw = clip(iy_nw + 1, h);
+    int ix_se = clip(ix_nw + 1, w);
+    int iy_se = clip(iy_nw + 1, h);
+    float nw = (ix_se - ix) * (iy_se - iy);
+    float ne = (ix - ix_sw) * (iy_sw - iy);
+    float sw = (ix_ne - ix) * (iy - iy_ne);
+    float se = (ix - ix_nw) * (iy - iy_nw);
+    for (int i = 0; i < Rows - 3; ++i) {
+      float nw_val = descriptors[i * h * w + iy_nw * w + ix_nw];
+      float ne_val = descriptors[i * h * w + iy_ne * w + ix_ne];
+      float sw_val = descriptors[i * h * w + iy_sw * w + ix_sw];
+      float se_val = descriptors[i * h * w + iy_se * w + ix_se];
+      features(i+3, j) = nw_val * nw + ne_val * ne + sw_val * sw + se_val * se;
+    }
+  }
+
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> descriptor_matrix = features.block(3, 0, features.rows() - 3, features.cols());
+  descriptor_matrix.colwise().normalize();
+  features.block(3, 0, features.rows() - 3, features.cols()) = descriptor_matrix;
+}
+
+// greedy suppression by brute force, the candidates are sorted by score
+void ReferenceNms(const float* heat_map, int w, int radius, int top_k, std::vector<int>& candidates){
+  std::sort(candidates.begin(), candidates.end(), [heat_map](int i1, int i2){
+    return heat_map[i1] > heat_map[i2] || (heat_map[i1] == heat_map[i2] && i1 < i2);
+  });
+  std::vector<int> kept;
+  for(int index : candidates){
+    if(top_k >= 0 && (int)kept.size() >= top_k) break;
+    bool suppressed = false;
+    for(int k : kept){
+      if(std::abs(k % w - index % w) <= radius && std::abs(k / w - index / w) <= radius){
+        suppressed = true;
+        break;
+      }
+    }
+    if(!suppressed) kept.push_back(index);
+  }
+  candidates = kept;
+}
+
+template<int DescriptorDim, int Stride>
+void RunDescriptorBenchmark(const std::vector<float>& heat_map, int h, int w, int top_k, int repeat){
+  typedef KeypointDecoder<DescriptorDim, Stride> Decoder;
+  std::mt19937 rng(1);
+  std::normal_distribution<float> normal(0.0f, 1.0f);
+  std::vector<float> descriptors(DescriptorDim * (h / Stride) * (w / Stride));
+  for(float& d : descriptors) d = normal(rng);
+
+  Decoder decoder;
+  typename Decoder::Features features;
+  decoder.DetectKeypoints(heat_map.data(), h, w, 0.004f, 4, top_k, 0, features);
+  features.descriptors.setZero(DescriptorDim, features.Size());
+  typename Decoder::Features::PackedFeatures reference_features = features.ToPacked();
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i < repeat; i++){
+    ReferenceExtractDescriptors(descriptors.data(), reference_features, h / Stride, w / Stride, Stride);
+  }
+  auto t1 = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i < repeat; i++){
+    decoder.SetDescriptorMap(descriptors.data(), h, w);
+    decoder.SampleDescriptors(features);
+  }
+  auto t2 = std::chrono::high_resolution_clock::now();
+
+  float max_diff = (features.ToPacked() - reference_features).cwiseAbs().maxCoeff();
+  double reference_time = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() / 1000.0 / repeat;
+  double time = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() / 1000.0 / repeat;
+  std::cout << "descriptors " << DescriptorDim << "/" << Stride << ": keypoints = " << features.Size()
+            << ", reference = " << reference_time << " ms, SetDescriptorMap + SampleDescriptors = " << time
+            << " ms, max difference = " << max_diff << std::endl;
+}
+
+void RunBenchmark(const std::string& name, const std::vector<float>& heat_map, int h, int w, float threshold,
+    int border, int top_k, int repeat){
+  KeypointDecoder<> decoder;
+  FeatureSet features;
+  FeatureSet::PackedFeatures reference_features;
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i < repeat; i++){
+    ReferenceDetectKeypoints(heat_map.data(), reference_features, h, w, threshold, border, top_k);
+  }
+  auto t1 = std::chrono::high_resolution_clock::now();
+  for(int i = 0; i < repeat; i++){
+    decoder.DetectKeypoints(heat_map.data(), h, w, threshold, border, top_k, 0, features);
+  }
+  auto t2 = std::chrono::high_resolution_clock::now();
+
+  bool same = (features.Size() == reference_features.cols()) &&
+      features.scores.isApprox(reference_features.row(0)) &&
+      features.keypoints.isApprox(reference_features.middleRows<2>(1));
+  double reference_time = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() / 1000.0 / repeat;
+  double time = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() / 1000.0 / repeat;
+  std::cout << name << ": keypoints = " << features.Size() << ", reference = " << reference_time << " ms, "
+            << "DetectKeypoints = " << time << " ms, " << (same ? "same results" : "DIFFERENT RESULTS") << std::endl;
+}
+
+void RunNmsCheck(const std::vector<float>& heat_map, int h, int w, float threshold, int border, int top_k,
+    int radius){
+  KeypointDecoder<> decoder;
+  FeatureSet features;
+  auto t0 = std::chrono::high_resolution_clock::now();
+  decoder.DetectKeypoints(heat_map.data(), h, w, threshold, border, top_k, radius, features);
+  auto t1 = std::chrono::high_resolution_clock::now();
+
+  std::vector<int> candidates;
+  KeypointDecoder<>::ThresholdScan(heat_map.data(), h, w, threshold, border, candidates);
+  ReferenceNms(heat_map.data(), w, radius, top_k, candidates);
+  bool same = (features.Size() == (int)candidates.size());
+  for(size_t i = 0; same && i < candidates.size(); ++i){
+    same = (int)features.keypoints(0, i) == candidates[i] % w && (int)features.keypoints(1, i) == candidates[i] / w;
+  }
+  double time = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() / 1000.0;
+  std::cout << "nms radius " << radius << ": keypoints = " << features.Size() << ", DetectKeypoints = " << time
+            << " ms, " << (same ? "same results" : "DIFFERENT RESULTS") << std::endl;
+}
+
+void RunJunctionCheck(const std::vector<float>& heat_map, int h, int w, int border){
+  std::mt19937 rng(2);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  // line endpoints in the order of the lines, shared endpoints are repeated
+  std::vector<std::vector<bool>> junction_map(h, std::vector<bool>(w, false));
+  std::vector<int> junction_indexes;
+  for(int y = 0; y < h; y++){
+    for(int x = 0; x < w; x++){
+      if(uniform(rng) >= 0.001f) continue;
+      junction_map[y][x] = true;
+      junction_indexes.push_back(y * w + x);
+      if(uniform(rng) < 0.5f) junction_indexes.push_back(y * w + x);
+    }
+  }
+  std::shuffle(junction_indexes.begin(), junction_indexes.end(), rng);
+
+  KeypointDecoder<> decoder;
+  FeatureSet junctions;
+  decoder.DetectJunctions(heat_map.data(), junction_indexes, h, w, border, junctions);
+
+  std::vector<float> js, jx, jy;
+  for(int y = border; y < h - border; y++){
+    for(int x = border; x < w - border; x++){
+      if(!junction_map[y][x]) continue;
+      js.push_back(heat_map[x + y * w]);
+      jx.push_back(x);
+      jy.push_back(y);
+    }
+  }
+  bool same = (junctions.Size() == (int)js.size());
+  for(size_t i = 0; same && i < js.size(); ++i){
+    same = junctions.scores(i) == js[i] && junctions.keypoints(0, i) == jx[i] && junctions.keypoints(1, i) == jy[i];
+  }
+  std::cout << "junctions: " << junctions.Size() << ", " << (same ? "same results" : "DIFFERENT RESULTS") << std::endl;
+}
+
+int main(int argc, char **argv) {
+  const int h = 512, w = 512, border = 4, top_k = 400, repeat = 50;
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+  // sparse: few pixels above the threshold, as in a textureless scene
+  std::vector<float> sparse_map(h * w);
+  for(float& score : sparse_map) score = uniform(rng) < 0.002f ? 0.01f + uniform(rng) : 0.001f * uniform(rng);
+  RunBenchmark("sparse", sparse_map, h, w, 0.004f, border, top_k, repeat);
+
+  // dense: most pixels above the threshold, as in a highly textured scene
+  std::vector<float> dense_map(h * w);
+  for(float& score : dense_map) score = uniform(rng);
+  RunBenchmark("dense", dense_map, h, w, 0.004f, border, top_k, repeat);
+
+  RunNmsCheck(sparse_map, h, w, 0.004f, border, top_k, 4);
+  RunNmsCheck(dense_map, h, w, 0.004f, border, top_k, 4);
+  RunJunctionCheck(dense_map, h, w, border);
+
+  RunDescriptorBenchmark<256, 8>(dense_map, h, w, top_k, repeat);
+  RunDescriptorBenchmark<130, 4>(dense_map, h, w, top_k, repeat);
+
+  return 0;
+}
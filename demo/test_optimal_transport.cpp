@@ -0,0 +1,111 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "log_optimal_transport.h"
+
+// micro benchmark of LogOptimalTransport on random SuperGlue-like scores, checked against the straightforward
+// scalar implementation (std::exp and std::log over the whole matrix, strided column pass, no early stop)
+void ReferenceLogOptimalTransport(const float* scores, float* Z, int m, int n, float alpha, int iters){
+  const int rows = m + 1;
+  const int cols = n + 1;
+  std::vector<float> couplings(rows * cols);
+  for(int i = 0; i < rows; ++i){
+    for(int j = 0; j < cols; ++j){
+      couplings[i * cols + j] = (i == m || j == n) ? alpha : scores[i * n + j];
+    }
+  }
+
+  float norm = -std::log(m + n);
+  std::vector<float> log_mu(rows, norm), log_nu(cols, norm);
+  log_mu[m] = std::log(n) + norm;
+  log_nu[n] = std::log(m) + norm;
+
+  std::vector<float> u(rows, 0), v(cols, 0);
+  for(int k = 0; k < iters; ++k){
+    for(int i = 0; i < rows; ++i){
+      float expsum = 0;
+      for(int j = 0; j < cols; ++j) expsum += std::exp(couplings[i * cols + j] + v[j]);
+      u[i] = log_mu[i] - std::log(expsum);
+    }
+    for(int j = 0; j < cols; ++j){
+      float expsum = 0;
+      for(int i = 0; i < rows; ++i) expsum += std::exp(couplings[i * cols + j] + u[i]);
+      v[j] = log_nu[j] - std::log(expsum);
+    }
+  }
+
+  for(int i = 0; i < rows; ++i){
+    for(int j = 0; j < cols; ++j){
+      Z[i * cols + j] = couplings[i * cols + j] + u[i] + v[j] - norm;
+    }
+  }
+}
+
+// the column of the max of each row without the dustbins, as decoded by SuperGlue
+std::vector<int> RowArgmax(const std::vector<float>& Z, int m, int n){
+  std::vector<int> indexes(m);
+  for(int i = 0; i < m; ++i){
+    const float* row = Z.data() + i * (n + 1);
+    indexes[i] = std::max_element(row, row + n) - row;
+  }
+  return indexes;
+}
+
+int main(int argc, char **argv){
+  const int rounds = 10;
+  const float alpha = 2.3457;
+  const int iters = 100;
+  std::mt19937 rng(0);
+  std::normal_distribution<float> noise(0.0f, 1.0f);
+
+  float max_exp_error = 0;
+  for(float x = -87.0f; x <= 0.0f; x += 0.001f){
+    max_exp_error = std::max(max_exp_error, std::abs(LogOptimalTransport::Exp(x) / std::exp(x) - 1.0f));
+  }
+  std::cout << "max relative error of Exp = " << max_exp_error << std::endl;
+
+  LogOptimalTransport optimal_transport;
+  for(int num : {100, 200, 400, 800}){
+    // dot products of normalized descriptors scaled by sqrt(256) as in SuperGlue, and a few good matches
+    const int m = num, n = num - 17;
+    std::vector<float> scores(m * n);
+    for(float& s : scores) s = 2.0f * noise(rng);
+    for(int i = 0; i < std::min(m, n); i += 2) scores[i * n + (i * 7) % n] += 12.0f;
+
+    std::vector<float> Z_reference((m + 1) * (n + 1)), Z_full((m + 1) * (n + 1)), Z_early((m + 1) * (n + 1));
+    double reference_time = 0, full_time = 0, early_time = 0;
+    int early_iters = 0;
+    for(int r = 0; r < rounds; ++r){
+      auto t0 = std::chrono::high_resolution_clock::now();
+      ReferenceLogOptimalTransport(scores.data(), Z_reference.data(), m, n, alpha, iters);
+      auto t1 = std::chrono::high_resolution_clock::now();
+      optimal_transport.Solve(scores.data(), m, n, alpha, iters, 0, Z_full.data());
+      auto t2 = std::chrono::high_resolution_clock::now();
+      early_iters = optimal_transport.Solve(scores.data(), m, n, alpha, iters, 1e-3, Z_early.data());
+      auto t3 = std::chrono::high_resolution_clock::now();
+      reference_time += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() / 1000.0;
+      full_time += std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() / 1000.0;
+      early_time += std::chrono::duration_cast<std::chrono::microseconds>(t3 - t2).count() / 1000.0;
+    }
+
+    float max_full_error = 0, max_early_error = 0;
+    for(size_t k = 0; k < Z_reference.size(); ++k){
+      max_full_error = std::max(max_full_error, std::abs(Z_full[k] - Z_reference[k]));
+      max_early_error = std::max(max_early_error, std::abs(Z_early[k] - Z_reference[k]));
+    }
+    std::vector<int> reference_indexes = RowArgmax(Z_reference, m, n);
+    bool same_full = (RowArgmax(Z_full, m, n) == reference_indexes);
+    bool same_early = (RowArgmax(Z_early, m, n) == reference_indexes);
+
+    std::cout << m << " x " << n << ": reference = " << reference_time / rounds << " ms, " << iters
+              << " iterations = " << full_time / rounds << " ms (max error " << max_full_error
+              << (same_full ? ", same argmax" : ", DIFFERENT argmax") << "), early stop after " << early_iters
+              << " iterations = " << early_time / rounds << " ms (max error " << max_early_error
+              << (same_early ? ", same argmax" : ", DIFFERENT argmax") << ")" << std::endl;
+  }
+  return 0;
+}
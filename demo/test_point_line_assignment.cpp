@@ -0,0 +1,195 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+
+#include "frame.h"
+#include "line_processor.h"
+
+// micro benchmark of AssignPointsToLines and MatchLines on random lines with keypoints scattered on and around
+// them, checked against the exhaustive test of every point against every line and the dense matching matrix
+void ReferenceAssignPointsToLines(const std::vector<Eigen::Vector4d>& lines, const Eigen::Matrix2Xf& points, 
+    std::vector<std::map<int, double>>& relation){
+  relation.clear();
+  for(const Eigen::Vector4d& line : lines){
+    const double lx1 = line(0), ly1 = line(1), lx2 = line(2), ly2 = line(3);
+    const double A = ly2 - ly1, B = lx1 - lx2, C = lx2 * ly1 - lx1 * ly2;
+    const double D = std::sqrt(A * A + B * B);
+    std::map<int, double> points_on_line;
+    for(int j = 0; j < points.cols(); j++){
+      const double px = points(0, j), py = points(1, j);
+      if(px < std::min(lx1, lx2) - 3 || px > std::max(lx1, lx2) + 3 || 
+          py < std::min(ly1, ly2) - 3 || py > std::max(ly1, ly2) + 3) continue;
+      float pl_distance = std::abs(A * px + B * py + C) / D;
+      if(pl_distance > 3) continue;
+      double side1 = std::pow(lx1 - px, 2) + std::pow(ly1 - py, 2);
+      double side2 = std::pow(lx2 - px, 2) + std::pow(ly2 - py, 2);
+      if(side1 <= 9 || side2 <= 9 || ((side1 < D * D + side2) && (side2 < D * D + side1))){
+        points_on_line[j] = pl_distance;
+      }
+    }
+    relation.push_back(points_on_line);
+  }
+}
+
+void ReferenceMatchLines(const PointsOnLines& points_on_line0, const PointsOnLines& points_on_line1, 
+    const std::vector<cv::DMatch>& point_matches, size_t point_num0, size_t point_num1, std::vector<int>& line_matches){
+  size_t line_num0 = points_on_line0.LineNum();
+  size_t line_num1 = points_on_line1.LineNum();
+  line_matches.assign(line_num0, -1);
+  if(point_num0 == 0 || point_num1 == 0 || line_num0 == 0 || line_num1 == 0) return;
+  std::vector<std::vector<int>> assigned_lines0(point_num0), assigned_lines1(point_num1);
+  for(size_t i = 0; i < line_num0; i++){
+    for(const PointOnLine& point : points_on_line0[i]) assigned_lines0[point.index].push_back(i);
+  }
+  for(size_t i = 0; i < line_num1; i++){
+    for(const PointOnLine& point : points_on_line1[i]) assigned_lines1[point.index].push_back(i);
+  }
+
+  Eigen::MatrixXi matching_matrix = Eigen::MatrixXi::Zero(line_num0, line_num1);
+  for(auto& point_match : point_matches){
+    for(auto& l0 : assigned_lines0[point_match.queryIdx]){
+      for(auto& l1 : assigned_lines1[point_match.trainIdx]) matching_matrix(l0, l1) += 1;
+    }
+  }
+
+  std::vector<Eigen::VectorXi::Index> row_max_location(line_num0);
+  for(size_t i = 0; i < line_num0; i++) matching_matrix.row(i).maxCoeff(&row_max_location[i]);
+  for(size_t j = 0; j < line_num1; j++){
+    Eigen::VectorXi::Index col_max_location;
+    int col_max_val = matching_matrix.col(j).maxCoeff(&col_max_location);
+    if(col_max_val < 2 || row_max_location[col_max_location] != j) continue;
+    float score = (float)(col_max_val * col_max_val) / std::min(points_on_line0[col_max_location].size(), points_on_line1[j].size());
+    if(score < 0.8) continue;
+    line_matches[col_max_location] = j;
+  }
+}
+
+bool SameRelation(const PointsOnLines& relation0, const PointsOnLines& relation1){
+  if(relation0.offsets != relation1.offsets || relation0.PointNum() != relation1.PointNum()) return false;
+  for(size_t k = 0; k < relation0.PointNum(); k++){
+    if(relation0.points[k].index != relation1.points[k].index || 
+        relation0.points[k].distance != relation1.points[k].distance) return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv){
+  const int rounds = 100;
+  const int image_width = 752, image_height = 480;
+  const double grid_width_inv = static_cast<double>(FRAME_GRID_COLS) / image_width;
+  const double grid_height_inv = static_cast<double>(FRAME_GRID_ROWS) / image_height;
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<double> uniform_x(0, image_width - 1), uniform_y(0, image_height - 1);
+  std::uniform_real_distribution<double> uniform(0, 1), offset(-4, 4), angle(0, M_PI), length(50, 250);
+
+  for(std::pair<int, int> size : {std::make_pair(400, 100), std::make_pair(2000, 300)}){
+    const int point_num = size.first, line_num = size.second;
+    std::vector<Eigen::Vector4d> lines(line_num);
+    // segments longer than line_length_threshold as detected by PLNet
+    for(Eigen::Vector4d& line : lines){
+      double x1 = uniform_x(rng), y1 = uniform_y(rng), theta = angle(rng), l = length(rng);
+      double x2 = std::min(std::max(x1 + l * std::cos(theta), 0.0), image_width - 1.0);
+      double y2 = std::min(std::max(y1 + l * std::sin(theta), 0.0), image_height - 1.0);
+      line << x1, y1, x2, y2;
+    }
+
+    // half of the points near a line, as the keypoints on the line segments of a real image
+    Eigen::Matrix2Xf points(2, point_num);
+    for(int j = 0; j < point_num; j++){
+      if(j % 2 == 0){
+        points(0, j) = uniform_x(rng);
+        points(1, j) = uniform_y(rng);
+      }else{
+        const Eigen::Vector4d& line = lines[rng() % line_num];
+        double t = uniform(rng);
+        points(0, j) = std::min(std::max(line(0) + t * (line(2) - line(0)) + offset(rng), 0.0), image_width - 1.0);
+        points(1, j) = std::min(std::max(line(1) + t * (line(3) - line(1)) + offset(rng), 0.0), image_height - 1.0);
+      }
+    }
+
+    // bucketed as Frame::AddLeftFeatures
+    std::vector<std::vector<int>> grid(FRAME_GRID_COLS * FRAME_GRID_ROWS);
+    for(int j = 0; j < point_num; j++){
+      int grid_x = std::min(std::max((int)std::round(points(0, j) * grid_width_inv), 0), FRAME_GRID_COLS - 1);
+      int grid_y = std::min(std::max((int)std::round(points(1, j) * grid_height_inv), 0), FRAME_GRID_ROWS - 1);
+      grid[grid_x * FRAME_GRID_ROWS + grid_y].push_back(j);
+    }
+
+    std::vector<std::map<int, double>> relation_reference;
+    PointsOnLines relation;
+    double reference_time = 0, grid_time = 0;
+    for(int r = 0; r < rounds; ++r){
+      auto t0 = std::chrono::high_resolution_clock::now();
+      ReferenceAssignPointsToLines(lines, points, relation_reference);
+      auto t1 = std::chrono::high_resolution_clock::now();
+      AssignPointsToLines(lines, points, grid.data(), FRAME_GRID_COLS, FRAME_GRID_ROWS, 
+          grid_width_inv, grid_height_inv, relation);
+      auto t2 = std::chrono::high_resolution_clock::now();
+      reference_time += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() / 1000.0;
+      grid_time += std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() / 1000.0;
+    }
+
+    PointsOnLines relation_expected;
+    relation_expected.FromMaps(relation_reference);
+    std::cout << point_num << " points x " << line_num << " lines: exhaustive = " << reference_time / rounds
+              << " ms, grid = " << grid_time / rounds << " ms, " << relation.PointNum() << " points on lines, "
+              << (SameRelation(relation, relation_expected) ? "same relation" : "DIFFERENT relation") << std::endl;
+
+    // a second view with the points and lines moved by up to one pixel and shuffled, 80% of the points matched
+    std::vector<int> order(point_num), line_order(line_num);
+    std::iota(order.begin(), order.end(), 0);
+    std::iota(line_order.begin(), line_order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    std::shuffle(line_order.begin(), line_order.end(), rng);
+    std::uniform_real_distribution<double> move(-1, 1);
+    Eigen::Matrix2Xf points1(2, point_num);
+    std::vector<std::vector<int>> grid1(FRAME_GRID_COLS * FRAME_GRID_ROWS);
+    std::vector<cv::DMatch> point_matches;
+    for(int j = 0; j < point_num; j++){
+      points1(0, order[j]) = std::min(std::max(points(0, j) + move(rng), 0.0), image_width - 1.0);
+      points1(1, order[j]) = std::min(std::max(points(1, j) + move(rng), 0.0), image_height - 1.0);
+      if(uniform(rng) < 0.8) point_matches.emplace_back(j, order[j], 0);
+    }
+    for(int j = 0; j < point_num; j++){
+      int grid_x = std::min(std::max((int)std::round(points1(0, j) * grid_width_inv), 0), FRAME_GRID_COLS - 1);
+      int grid_y = std::min(std::max((int)std::round(points1(1, j) * grid_height_inv), 0), FRAME_GRID_ROWS - 1);
+      grid1[grid_x * FRAME_GRID_ROWS + grid_y].push_back(j);
+    }
+    std::vector<Eigen::Vector4d> lines1(line_num);
+    for(int i = 0; i < line_num; i++){
+      lines1[line_order[i]] = lines[i] + Eigen::Vector4d(move(rng), move(rng), move(rng), move(rng));
+    }
+    PointsOnLines relation1;
+    AssignPointsToLines(lines1, points1, grid1.data(), FRAME_GRID_COLS, FRAME_GRID_ROWS, 
+        grid_width_inv, grid_height_inv, relation1);
+
+    std::vector<int> line_matches_reference, line_matches;
+    double dense_time = 0, sparse_time = 0;
+    for(int r = 0; r < rounds; ++r){
+      auto t0 = std::chrono::high_resolution_clock::now();
+      ReferenceMatchLines(relation, relation1, point_matches, point_num, point_num, line_matches_reference);
+      auto t1 = std::chrono::high_resolution_clock::now();
+      MatchLines(relation, relation1, point_matches, point_num, point_num, line_matches);
+      auto t2 = std::chrono::high_resolution_clock::now();
+      dense_time += std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() / 1000.0;
+      sparse_time += std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() / 1000.0;
+    }
+
+    int line_match_num = 0, right_line_match_num = 0;
+    for(int i = 0; i < line_num; i++){
+      if(line_matches[i] < 0) continue;
+      line_match_num++;
+      right_line_match_num += (line_matches[i] == line_order[i]);
+    }
+    std::cout << point_matches.size() << " point matches: dense MatchLines = " << dense_time / rounds 
+              << " ms, sparse = " << sparse_time / rounds << " ms, " << line_match_num << " line matches (" 
+              << right_line_match_num << " right), " 
+              << (line_matches == line_matches_reference ? "same matches" : "DIFFERENT matches") << std::endl;
+  }
+  return 0;
+}
@@ -8,6 +8,7 @@
 #include "read_configs.h"
 #include "dataset.h"
 #include "map_builder.h"
+#include "latency_stats.h"
 
 int main(int argc, char **argv) {
   ros::init(argc, argv, "air_slam");
@@ -21,23 +22,27 @@ int main(int argc, char **argv) {
   ros::param::get("~dataroot", configs.dataroot);
   ros::param::get("~camera_config_path", configs.camera_config_path);
   ros::param::get("~saving_dir", configs.saving_dir);
+  ros::param::get("~feature_log_mode", configs.feature_log_mode);
+  ros::param::get("~feature_log_path", configs.feature_log_path);
 
   ros::NodeHandle nh;
   MapBuilder map_builder(configs, nh);
   std::cout << "map_builder done" << std::endl;
 
   Dataset dataset(configs.dataroot, map_builder.UseIMU());
-  size_t dataset_length = dataset.GetDatasetLength();
+  int prefetch_thread_num = 2;
+  ros::param::get("~prefetch_thread_num", prefetch_thread_num);
+  dataset.StartPrefetch(prefetch_thread_num, 8);
   std::cout << "dataset done" << std::endl;
 
   double sum_time = 0;
   int image_num = 0;
-  for(size_t i = 0; i < dataset_length && ros::ok(); ++i){
+  size_t i;
+  cv::Mat image_left, image_right;
+  double timestamp;
+  ImuDataList batch_imu_data;
+  while(ros::ok() && dataset.GetNextData(i, image_left, image_right, batch_imu_data, timestamp)){
     std::cout << "i ====== " << i << std::endl;
-    cv::Mat image_left, image_right;
-    double timestamp;
-    ImuDataList batch_imu_data;
-    if(!dataset.GetData(i, image_left, image_right, batch_imu_data, timestamp)) continue;
 
     InputDataPtr data = std::shared_ptr<InputData>(new InputData());
     data->index = i;
@@ -52,9 +57,9 @@ int main(int argc, char **argv) {
     auto cost_time = std::chrono::duration_cast<std::chrono::milliseconds>(after_infer - before_infer).count();
     sum_time += (double)cost_time;
     image_num++;
-    std::cout << "One Frame Processinh Time: " << cost_time << " ms." << std::endl;
+    std::cout << "AddInput Blocking Time: " << cost_time << " ms." << std::endl;
   }
-  std::cout << "Average FPS = " << image_num / (sum_time / 1000.0) << std::endl;
+  std::cout << "Average Input FPS = " << image_num / (sum_time / 1000.0) << std::endl;
 
 
   std::cout << "Waiting to stop..." << std::endl; 
@@ -63,10 +68,16 @@ int main(int argc, char **argv) {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
   }
   std::cout << "Map building has been stopped" << std::endl; 
+  std::cout << "Image buffer allocations after warm-up: " << map_builder.ImageAllocationCount() << std::endl;
+  map_builder.PrintQueueStats();
 
   std::string trajectory_path = ConcatenateFolderAndFileName(configs.saving_dir, "trajectory_v0.txt");
   map_builder.SaveTrajectory(trajectory_path);
   map_builder.SaveMap(configs.saving_dir);
+
+  LatencyStats::Instance().Print();
+  LatencyStats::Instance().SaveToJson(ConcatenateFolderAndFileName(configs.saving_dir, "latency.json"));
+  LatencyStats::Instance().SaveToCsv(ConcatenateFolderAndFileName(configs.saving_dir, "latency.csv"));
   ros::shutdown();
 
   return 0;
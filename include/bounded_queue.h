@@ -0,0 +1,152 @@
+#ifndef BOUNDED_QUEUE_H_
+#define BOUNDED_QUEUE_H_
+
+#include <deque>
+#include <mutex>
+#include <iterator>
+#include <algorithm>
+#include <condition_variable>
+
+// Bounded blocking FIFO used to hand data between pipeline threads. Producers block
+// while the queue is full and consumers block while it is empty, both are woken up
+// immediately by the other side instead of polling. After Shutdown() no more items
+// are accepted, but the items already queued can still be popped.
+template <class T>
+class BoundedQueue{
+public:
+  explicit BoundedQueue(size_t capacity) : _capacity(capacity), _shutdown(false), _max_size(0), _push_num(0), _size_sum(0){
+  }
+
+  // return false if the queue has been shut down
+  bool Push(const T& item){
+    std::unique_lock<std::mutex> locker(_mutex);
+    _not_full.wait(locker, [this]{ return _shutdown || _queue.size() < _capacity; });
+    if(_shutdown) return false;
+    PushBack(item);
+    locker.unlock();
+    _not_empty.notify_one();
+    return true;
+  }
+
+  // return false if the queue is full or has been shut down
+  bool TryPush(const T& item){
+    std::unique_lock<std::mutex> locker(_mutex);
+    if(_shutdown || _queue.size() >= _capacity) return false;
+    PushBack(item);
+    locker.unlock();
+    _not_empty.notify_one();
+    return true;
+  }
+
+  // make room by dropping the oldest queued items that can_drop(item) accepts, instead of waiting for the
+  // consumer. If latest_only is set, all droppable items are dropped even if the queue is not full.
+  // on_drop(dropped_item, next_item) is called before an item is dropped, next_item is the item queued after
+  // it or the new item. Wait like Push() only if no queued item can be dropped. Return the number of dropped
+  // items, or -1 if the queue has been shut down.
+  template <class CanDrop, class OnDrop>
+  int PushDropping(const T& item, bool latest_only, CanDrop can_drop, OnDrop on_drop){
+    std::unique_lock<std::mutex> locker(_mutex);
+    int dropped_num = 0;
+    while(true){
+      if(_shutdown) return -1;
+      for(auto it = _queue.begin(); it != _queue.end() && (latest_only || _queue.size() >= _capacity);){
+        if(can_drop(*it)){
+          auto next = std::next(it);
+          on_drop(*it, (next != _queue.end()) ? *next : item);
+          it = _queue.erase(it);
+          dropped_num++;
+        }else{
+          ++it;
+        }
+      }
+      if(_queue.size() < _capacity) break;
+      _not_full.wait(locker);
+    }
+    PushBack(item);
+    locker.unlock();
+    _not_empty.notify_one();
+    return dropped_num;
+  }
+
+  // return false only if the queue has been shut down and all items have been popped
+  bool Pop(T& item){
+    std::unique_lock<std::mutex> locker(_mutex);
+    _not_empty.wait(locker, [this]{ return _shutdown || !_queue.empty(); });
+    if(_queue.empty()) return false;
+    item = _queue.front();
+    _queue.pop_front();
+    locker.unlock();
+    _not_full.notify_one();
+    return true;
+  }
+
+  bool TryPop(T& item){
+    std::unique_lock<std::mutex> locker(_mutex);
+    if(_queue.empty()) return false;
+    item = _queue.front();
+    _queue.pop_front();
+    locker.unlock();
+    _not_full.notify_one();
+    return true;
+  }
+
+  void Shutdown(){
+    std::unique_lock<std::mutex> locker(_mutex);
+    _shutdown = true;
+    locker.unlock();
+    _not_empty.notify_all();
+    _not_full.notify_all();
+  }
+
+  bool IsShutdown(){
+    std::unique_lock<std::mutex> locker(_mutex);
+    return _shutdown;
+  }
+
+  size_t Size(){
+    std::unique_lock<std::mutex> locker(_mutex);
+    return _queue.size();
+  }
+
+  bool Empty(){
+    std::unique_lock<std::mutex> locker(_mutex);
+    return _queue.empty();
+  }
+
+  size_t Capacity() const{
+    return _capacity;
+  }
+
+  // occupancy statistics, sampled after each push
+  size_t MaxSize(){
+    std::unique_lock<std::mutex> locker(_mutex);
+    return _max_size;
+  }
+
+  double MeanSize(){
+    std::unique_lock<std::mutex> locker(_mutex);
+    return _push_num > 0 ? (double)_size_sum / _push_num : 0.0;
+  }
+
+private:
+  void PushBack(const T& item){
+    _queue.push_back(item);
+    _max_size = std::max(_max_size, _queue.size());
+    _push_num++;
+    _size_sum += _queue.size();
+  }
+
+private:
+  const size_t _capacity;
+  bool _shutdown;
+  std::deque<T> _queue;
+  std::mutex _mutex;
+  std::condition_variable _not_empty;
+  std::condition_variable _not_full;
+
+  size_t _max_size;
+  size_t _push_num;
+  size_t _size_sum;
+};
+
+#endif  // BOUNDED_QUEUE_H_
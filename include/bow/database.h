@@ -72,9 +72,9 @@ public:
   void LoadVocabulary(SuperpointVocabularyPtr voc);
 
   void FrameToBow(FramePtr frame, DBoW2::WordIdToFeatures& word_features, DBoW2::BowVector& bow_vector);
-  void FrameToBow(const Eigen::Matrix<float, 259, Eigen::Dynamic>& features_eigen, DBoW2::WordIdToFeatures& word_features, DBoW2::BowVector& bow_vector);
+  void FrameToBow(const FeatureSet& features_eigen, DBoW2::WordIdToFeatures& word_features, DBoW2::BowVector& bow_vector);
   void FrameToBow(FramePtr frame, DBoW2::WordIdToFeatures& word_features, DBoW2::BowVector& bow_vector, std::vector<DBoW2::WordId>& word_of_features);
-  void FrameToBow(const Eigen::Matrix<float, 259, Eigen::Dynamic>& features_eigen, 
+  void FrameToBow(const FeatureSet& features_eigen, 
     DBoW2::WordIdToFeatures& word_features, DBoW2::BowVector& bow_vector, std::vector<DBoW2::WordId>& word_of_features);
 
   void AddFrame(FramePtr frame);
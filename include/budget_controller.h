@@ -0,0 +1,44 @@
+#ifndef BUDGET_CONTROLLER_H_
+#define BUDGET_CONTROLLER_H_
+
+#include <mutex>
+#include <string>
+#include <memory>
+#include <fstream>
+
+#include "read_configs.h"
+
+// Adapts the detection budget (keypoint top-k and minimal line length) to the measured frame time.
+// The frame time is the time of the slowest pipeline stage, i.e. max(feature extraction, tracking).
+// The budget is reduced when the smoothed frame time is over the target and restored when it is well
+// below, but never reduced while too few inliers are tracked. Every decision is written to a csv log.
+class BudgetController{
+public:
+  BudgetController(const BudgetControllerConfig& config, const PLNetConfig& plnet_config, const std::string& log_path);
+  ~BudgetController();
+
+  // called by the tracking thread after each tracked frame
+  void Update(int frame_id, double feature_time, double tracking_time, int track_inliers);
+
+  // called by the feature thread before each detection
+  void GetBudget(int& max_keypoints, float& line_length_threshold);
+
+private:
+  std::mutex _mutex;
+  BudgetControllerConfig _config;
+
+  int _max_keypoints_upper;
+  float _line_length_threshold_lower;
+
+  int _max_keypoints;
+  float _line_length_threshold;
+
+  double _smoothed_frame_time;
+  int _frames_since_change;
+
+  std::ofstream _log;
+};
+
+typedef std::shared_ptr<BudgetController> BudgetControllerPtr;
+
+#endif  // BUDGET_CONTROLLER_H_
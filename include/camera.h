@@ -25,7 +25,9 @@ public:
   Camera& operator=(const Camera& camera); // deep copy
   
   void ReadCameraNode(YAML::Node& cam_node, cv::Mat& K, cv::Mat& D, Eigen::Matrix4d& Tbc);
+  // if the output images are already allocated with the right size and type, they are written in place
   void UndistortImage(cv::Mat& image_left, cv::Mat& image_left_rect);
+  // the left and right images are remapped in parallel
   void UndistortImage(
       cv::Mat& image_left, cv::Mat& image_right, cv::Mat& image_left_rect, cv::Mat& image_right_rect);
   double ImageHeight();
@@ -93,6 +95,10 @@ public:
   static double IMU_G_VALUE;
 
 private:
+  // the rectification maps are kept in the fixed-point CV_16SC2 + CV_16UC1 format, which is
+  // faster to remap and 6 instead of 8 bytes per pixel (25% smaller) than the two CV_32FC1 maps
+  void ConvertMapsToFixedPoint();
+
   friend class boost::serialization::access;
   template<class Archive>
   void serialize(Archive & ar, const unsigned int version){
@@ -116,6 +122,8 @@ private:
     SerializeCVMat(ar, _mapl2, version);
     SerializeCVMat(ar, _mapr1, version);
     SerializeCVMat(ar, _mapr2, version);
+    // maps saved by older versions are in float
+    if(Archive::is_loading::value) ConvertMapsToFixedPoint();
 
     ar & _use_imu;
     ar & boost::serialization::make_array(_Tbc.data(), _Tbc.size());
@@ -0,0 +1,171 @@
+#ifndef COMPACT_DESCRIPTORS_H_
+#define COMPACT_DESCRIPTORS_H_
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "3rdparty/tensorrtbuffer/include/half.h"
+
+#if defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+enum DescriptorPrecision {
+  Float32Descriptor = 0,
+  Float16Descriptor = 1,
+  Int8Descriptor = 2,    // int8 values with one scale per descriptor
+};
+
+// Descriptors stored as fp16 or int8, for the keyframes kept in the map. The values are column-major
+// DescriptorDim x N like the float descriptors, Decode converts them back with F16C/AVX2/SSE2/NEON when available.
+template<int DescriptorDim>
+struct CompactDescriptors{
+  int precision;
+  int size;
+  std::vector<half_float::half> half_values;
+  std::vector<int8_t> int8_values;
+  std::vector<float> scales;
+
+  CompactDescriptors() : precision(Float32Descriptor), size(0) {}
+
+  void Clear(){
+    precision = Float32Descriptor;
+    size = 0;
+    std::vector<half_float::half>().swap(half_values);
+    std::vector<int8_t>().swap(int8_values);
+    std::vector<float>().swap(scales);
+  }
+
+  size_t Bytes() const{
+    return half_values.size() * sizeof(half_float::half) + int8_values.size() * sizeof(int8_t) +
+        scales.size() * sizeof(float);
+  }
+
+  void Encode(const float* descriptors, int n, int descriptor_precision){
+    Clear();
+    precision = descriptor_precision;
+    size = n;
+    if(precision == Float16Descriptor){
+      half_values.resize((size_t)n * DescriptorDim);
+      EncodeHalf(descriptors, half_values.data(), (size_t)n * DescriptorDim);
+    }else if(precision == Int8Descriptor){
+      int8_values.resize((size_t)n * DescriptorDim);
+      scales.resize(n);
+      for(int j = 0; j < n; ++j){
+        const float* descriptor = descriptors + (size_t)j * DescriptorDim;
+        int8_t* values = int8_values.data() + (size_t)j * DescriptorDim;
+        float max_value = 0;
+        for(int i = 0; i < DescriptorDim; ++i){
+          max_value = std::max(max_value, std::abs(descriptor[i]));
+        }
+        scales[j] = max_value / 127.0f;
+        float inv_scale = max_value > 0 ? 127.0f / max_value : 0.0f;
+        for(int i = 0; i < DescriptorDim; ++i){
+          values[i] = (int8_t)std::lround(descriptor[i] * inv_scale);
+        }
+      }
+    }else{
+      precision = Float32Descriptor;
+      size = 0;
+    }
+  }
+
+  // decode the idx-th descriptor to DescriptorDim floats
+  void Decode(int idx, float* descriptor) const{
+    if(precision == Float16Descriptor){
+      DecodeHalf(half_values.data() + (size_t)idx * DescriptorDim, descriptor, DescriptorDim);
+    }else if(precision == Int8Descriptor){
+      DecodeInt8(int8_values.data() + (size_t)idx * DescriptorDim, scales[idx], descriptor, DescriptorDim);
+    }
+  }
+
+  // decode all descriptors to a column-major DescriptorDim x size matrix
+  void Decode(float* descriptors) const{
+    if(precision == Float16Descriptor){
+      DecodeHalf(half_values.data(), descriptors, (size_t)size * DescriptorDim);
+    }else if(precision == Int8Descriptor){
+      for(int j = 0; j < size; ++j){
+        Decode(j, descriptors + (size_t)j * DescriptorDim);
+      }
+    }
+  }
+
+  static void EncodeHalf(const float* input, half_float::half* output, size_t n){
+    size_t i = 0;
+#if defined(__F16C__)
+    for(; i + 8 <= n; i += 8){
+      __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), h);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for(; i + 4 <= n; i += 4){
+      vst1_u16(reinterpret_cast<uint16_t*>(output + i), vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(input + i))));
+    }
+#endif
+    for(; i < n; ++i){
+      output[i] = half_float::half(input[i]);
+    }
+  }
+
+  static void DecodeHalf(const half_float::half* input, float* output, size_t n){
+    size_t i = 0;
+#if defined(__F16C__)
+    for(; i + 8 <= n; i += 8){
+      __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+      _mm256_storeu_ps(output + i, _mm256_cvtph_ps(h));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for(; i + 4 <= n; i += 4){
+      vst1q_f32(output + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t*>(input + i)))));
+    }
+#endif
+    for(; i < n; ++i){
+      output[i] = float(input[i]);
+    }
+  }
+
+  static void DecodeInt8(const int8_t* input, float scale, float* output, int n){
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256 scale_v = _mm256_set1_ps(scale);
+    for(; i + 8 <= n; i += 8){
+      __m256i v = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(input + i)));
+      _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale_v));
+    }
+#elif defined(__SSE2__)
+    const __m128 scale_v = _mm_set1_ps(scale);
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 16 <= n; i += 16){
+      // sign extend 16 int8 to int16 and then to int32
+      __m128i v8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+      __m128i sign8 = _mm_cmpgt_epi8(zero, v8);
+      __m128i v16[2] = {_mm_unpacklo_epi8(v8, sign8), _mm_unpackhi_epi8(v8, sign8)};
+      for(int k = 0; k < 2; ++k){
+        __m128i sign16 = _mm_cmpgt_epi16(zero, v16[k]);
+        __m128i lo = _mm_unpacklo_epi16(v16[k], sign16);
+        __m128i hi = _mm_unpackhi_epi16(v16[k], sign16);
+        _mm_storeu_ps(output + i + 8 * k, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale_v));
+        _mm_storeu_ps(output + i + 8 * k + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale_v));
+      }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for(; i + 8 <= n; i += 8){
+      int16x8_t v16 = vmovl_s8(vld1_s8(input + i));
+      vst1q_f32(output + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v16))), scale));
+      vst1q_f32(output + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v16))), scale));
+    }
+#endif
+    for(; i < n; ++i){
+      output[i] = input[i] * scale;
+    }
+  }
+};
+
+#endif  // COMPACT_DESCRIPTORS_H_
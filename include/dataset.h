@@ -2,6 +2,9 @@
 #define DATASET_H_
 
 #include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <Eigen/Dense>
 #include <Eigen/SparseCore>
 #include <opencv2/core/core.hpp>
@@ -14,16 +17,46 @@
 class Dataset{
 public:
   Dataset(const std::string& dataroot, bool use_imu);
+  ~Dataset();
   void ReadImuData(const std::string& imu_file_path, ImuDataList& all_imu_data);
   size_t GetDatasetLength();
   bool GetData(size_t idx, cv::Mat& left_image, cv::Mat& right_image, ImuDataList& batch_imu_data, double& timestamp);
 
+  // decode the images of the following frames with thread_num threads, at most buffer_size frames ahead
+  void StartPrefetch(int thread_num, size_t buffer_size);
+  // get the frames in order, the frames that can not be read are skipped, return false at the end of the dataset
+  bool GetNextData(size_t& idx, cv::Mat& left_image, cv::Mat& right_image, ImuDataList& batch_imu_data, double& timestamp);
+
+private:
+  void PrefetchThread();
+  void StopPrefetch();
+
 private:
   bool _use_imu;
   std::vector<std::string> _left_images;
   std::vector<std::string> _right_images;
   std::vector<ImuDataList> _imu_data;
   std::vector<double> _timestamps;
+
+  struct PrefetchSlot{
+    size_t idx;
+    bool ready;
+    bool good;
+    cv::Mat left_image;
+    cv::Mat right_image;
+    ImuDataList batch_imu_data;
+    double timestamp;
+  };
+
+  // ring of decoded frames, frame idx is stored in slot idx % size
+  std::vector<PrefetchSlot> _prefetch_slots;
+  std::vector<std::thread> _prefetch_threads;
+  std::mutex _prefetch_mutex;
+  std::condition_variable _slot_ready;
+  std::condition_variable _slot_free;
+  size_t _next_load_idx;
+  size_t _next_read_idx;
+  bool _stop_prefetch;
 };
 
 #endif // DATASET_H_
\ No newline at end of file
@@ -16,15 +16,15 @@
 #include "frame.h"
 
 void SaveDetectorResult(
-    cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dynamic>& features, std::string save_root, std::string idx);
+    cv::Mat& image, FeatureSet& features, std::string save_root, std::string idx);
 
 void SaveMatchingResult(
     cv::Mat& image1, const std::vector<cv::KeyPoint>& keypoints1, 
     cv::Mat& image2, const std::vector<cv::KeyPoint>& keypoints2, 
     std::vector<cv::DMatch>& matches, std::string save_path);
 
-void SaveStereoMatchResult(cv::Mat& image_left, cv::Mat& image_right, Eigen::Matrix<float, 259, Eigen::Dynamic>& features_left, 
-    Eigen::Matrix<float, 259, Eigen::Dynamic>&features_right, std::vector<cv::DMatch>& stereo_matches, std::string stereo_save_root, int frame_id);
+void SaveStereoMatchResult(cv::Mat& image_left, cv::Mat& image_right, FeatureSet& features_left, 
+    FeatureSet&features_right, std::vector<cv::DMatch>& stereo_matches, std::string stereo_save_root, int frame_id);
 
 
 void SaveTrackingResult(cv::Mat& last_image, cv::Mat& image, FramePtr last_frame, FramePtr frame, 
@@ -34,17 +34,17 @@ void SaveLineDetectionResult(cv::Mat& image, std::vector<Eigen::Vector4d>& lines
 void SaveLineDetectionResult(cv::Mat& image, std::vector<Eigen::Vector4d>& lines, std::vector<Eigen::Vector2i>& junctions, std::string save_root, std::string idx);
 
 void SavePointLineRelation(cv::Mat& image, std::vector<Eigen::Vector4d>& lines, Eigen::Matrix2Xd& points, 
-    std::vector<std::map<int, double>>& relation,  std::string save_root, std::string idx);
+    PointsOnLines& relation,  std::string save_root, std::string idx);
 
-cv::Mat DrawLinePointRelation(cv::Mat& image, const Eigen::Matrix<float, 259, Eigen::Dynamic>& features,
-    const std::vector<Eigen::Vector4d>& lines, const std::vector<std::map<int, double>>& points_on_line, std::vector<int>& line_ids);
+cv::Mat DrawLinePointRelation(cv::Mat& image, const FeatureSet& features,
+    const std::vector<Eigen::Vector4d>& lines, const PointsOnLines& points_on_line, std::vector<int>& line_ids);
 
 void SaveStereoLineMatch(cv::Mat& image_left, cv::Mat& image_right, 
-    Eigen::Matrix<float, 259, Eigen::Dynamic>& feature_left,
-    Eigen::Matrix<float, 259, Eigen::Dynamic>& feature_right,
+    FeatureSet& feature_left,
+    FeatureSet& feature_right,
     std::vector<Eigen::Vector4d>& lines_left, std::vector<Eigen::Vector4d>& lines_right,
-    std::vector<std::map<int, double>>& points_on_line_left, 
-    std::vector<std::map<int, double>>& points_on_line_right,
+    PointsOnLines& points_on_line_left, 
+    PointsOnLines& points_on_line_right,
     std::vector<int>& right_to_left_line_matches, std::string save_root, std::string idx);
   
 
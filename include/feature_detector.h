@@ -8,26 +8,45 @@
 class FeatureDetector{
 public:
   FeatureDetector(const PLNetConfig& plnet_config);
+  virtual ~FeatureDetector() {}
 
-  bool Detect(cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dynamic> &features);
-  bool Detect(cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dynamic> &features, std::vector<Eigen::Vector4d>& lines);
-  bool Detect(cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dynamic> &features, std::vector<Eigen::Vector4d>& lines, Eigen::Matrix<float, 259, Eigen::Dynamic>& junctions);
+  virtual bool Detect(cv::Mat& image, FeatureSet &features);
+  virtual bool Detect(cv::Mat& image, FeatureSet &features, std::vector<Eigen::Vector4d>& lines);
+  virtual bool Detect(cv::Mat& image, FeatureSet &features, std::vector<Eigen::Vector4d>& lines, FeatureSet& junctions);
 
-  bool Detect(cv::Mat& image_left, cv::Mat& image_right, Eigen::Matrix<float, 259, Eigen::Dynamic> & left_features, 
-      Eigen::Matrix<float, 259, Eigen::Dynamic> & right_features);
+  virtual bool Detect(cv::Mat& image_left, cv::Mat& image_right, FeatureSet & left_features, 
+      FeatureSet & right_features);
 
-  bool Detect(cv::Mat& image_left, cv::Mat& image_right, Eigen::Matrix<float, 259, Eigen::Dynamic> & left_features, 
-      Eigen::Matrix<float, 259, Eigen::Dynamic> & right_features, std::vector<Eigen::Vector4d>& left_lines, 
+  virtual bool Detect(cv::Mat& image_left, cv::Mat& image_right, FeatureSet & left_features, 
+      FeatureSet & right_features, std::vector<Eigen::Vector4d>& left_lines, 
       std::vector<Eigen::Vector4d>& right_lines);
 
-  bool Detect(cv::Mat& image_left, cv::Mat& image_right, Eigen::Matrix<float, 259, Eigen::Dynamic> & left_features, 
-      Eigen::Matrix<float, 259, Eigen::Dynamic> & right_features, std::vector<Eigen::Vector4d>& left_lines, 
-      std::vector<Eigen::Vector4d>& right_lines, Eigen::Matrix<float, 259, Eigen::Dynamic>& junctions);
+  virtual bool Detect(cv::Mat& image_left, cv::Mat& image_right, FeatureSet & left_features, 
+      FeatureSet & right_features, std::vector<Eigen::Vector4d>& left_lines, 
+      std::vector<Eigen::Vector4d>& right_lines, FeatureSet& junctions);
+
+  // change the keypoint top-k and the minimal line length of all networks, must not be called during detection
+  virtual void SetDetectionBudget(int max_keypoints, float line_length_threshold);
+
+  // use the networks of the right image if stereo_parallel is set, otherwise the same as Detect
+  virtual bool DetectRight(cv::Mat& image, FeatureSet &features);
+  virtual bool DetectRight(cv::Mat& image, FeatureSet &features, std::vector<Eigen::Vector4d>& lines);
+
+protected:
+  // for derived detectors that do not run the networks, e.g. FeatureDetectorReplayer
+  FeatureDetector();
+
+private:
+  void BuildNetworks(SuperPointPtr& superpoint, PLNetPtr& plnet);
 
 private:
   PLNetConfig _plnet_config;
   SuperPointPtr _superpoint;
   PLNetPtr _plnet;
+
+  // networks for the right image when stereo_parallel is set
+  SuperPointPtr _superpoint_right;
+  PLNetPtr _plnet_right;
 };
 
 typedef std::shared_ptr<FeatureDetector> FeatureDetectorPtr;
@@ -0,0 +1,144 @@
+#ifndef FEATURE_LOG_H_
+#define FEATURE_LOG_H_
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <Eigen/Core>
+#include <opencv2/opencv.hpp>
+
+#include "feature_detector.h"
+#include "point_matcher.h"
+
+// Binary log of the outputs of FeatureDetector and PointMatcher. With the recorder classes the outputs
+// of the networks are written in the order of the calls, the replayer classes read them back in the same
+// order, so the tracking and mapping backend can run deterministically without any network.
+enum FeatureLogRecordType {
+  PointFeatures = 0,
+  LineFeatures = 1,
+  JunctionFeatures = 2,
+  StereoPointFeatures = 3,
+  StereoLineFeatures = 4,
+  StereoJunctionFeatures = 5,
+  RightPointFeatures = 6,
+  RightLineFeatures = 7,
+  PointMatches = 8,
+};
+
+struct FeatureLogRecord{
+  int type;
+  bool good;
+  std::vector<FeatureSet> features;
+  std::vector<std::vector<Eigen::Vector4d>> lines;
+  std::vector<cv::DMatch> matches;
+
+  FeatureLogRecord() : type(-1), good(false) {}
+};
+
+class FeatureLog{
+public:
+  enum Mode {
+    Record = 1,
+    Replay = 2,
+  };
+
+  FeatureLog(const std::string& file_path, Mode mode);
+  ~FeatureLog();
+
+  bool IsOpen();
+  Mode GetMode();
+
+  void Write(const FeatureLogRecord& record);
+  // return false at the end of the log or if the next record is not of the expected type
+  bool Read(int expected_type, FeatureLogRecord& record);
+
+private:
+  std::mutex _mutex;
+  Mode _mode;
+  std::ofstream _ofs;
+  std::ifstream _ifs;
+  size_t _record_num;
+};
+
+typedef std::shared_ptr<FeatureLog> FeatureLogPtr;
+
+class FeatureDetectorRecorder : public FeatureDetector{
+public:
+  FeatureDetectorRecorder(const PLNetConfig& plnet_config, FeatureLogPtr feature_log);
+
+  bool Detect(cv::Mat& image, FeatureSet &features) override;
+  bool Detect(cv::Mat& image, FeatureSet &features, std::vector<Eigen::Vector4d>& lines) override;
+  bool Detect(cv::Mat& image, FeatureSet &features, std::vector<Eigen::Vector4d>& lines,
+      FeatureSet& junctions) override;
+
+  bool Detect(cv::Mat& image_left, cv::Mat& image_right, FeatureSet & left_features,
+      FeatureSet & right_features) override;
+  bool Detect(cv::Mat& image_left, cv::Mat& image_right, FeatureSet & left_features,
+      FeatureSet & right_features, std::vector<Eigen::Vector4d>& left_lines,
+      std::vector<Eigen::Vector4d>& right_lines) override;
+  bool Detect(cv::Mat& image_left, cv::Mat& image_right, FeatureSet & left_features,
+      FeatureSet & right_features, std::vector<Eigen::Vector4d>& left_lines,
+      std::vector<Eigen::Vector4d>& right_lines, FeatureSet& junctions) override;
+
+  bool DetectRight(cv::Mat& image, FeatureSet &features) override;
+  bool DetectRight(cv::Mat& image, FeatureSet &features, std::vector<Eigen::Vector4d>& lines) override;
+
+private:
+  FeatureLogPtr _feature_log;
+};
+
+class FeatureDetectorReplayer : public FeatureDetector{
+public:
+  FeatureDetectorReplayer(FeatureLogPtr feature_log);
+
+  bool Detect(cv::Mat& image, FeatureSet &features) override;
+  bool Detect(cv::Mat& image, FeatureSet &features, std::vector<Eigen::Vector4d>& lines) override;
+  bool Detect(cv::Mat& image, FeatureSet &features, std::vector<Eigen::Vector4d>& lines,
+      FeatureSet& junctions) override;
+
+  bool Detect(cv::Mat& image_left, cv::Mat& image_right, FeatureSet & left_features,
+      FeatureSet & right_features) override;
+  bool Detect(cv::Mat& image_left, cv::Mat& image_right, FeatureSet & left_features,
+      FeatureSet & right_features, std::vector<Eigen::Vector4d>& left_lines,
+      std::vector<Eigen::Vector4d>& right_lines) override;
+  bool Detect(cv::Mat& image_left, cv::Mat& image_right, FeatureSet & left_features,
+      FeatureSet & right_features, std::vector<Eigen::Vector4d>& left_lines,
+      std::vector<Eigen::Vector4d>& right_lines, FeatureSet& junctions) override;
+
+  bool DetectRight(cv::Mat& image, FeatureSet &features) override;
+  bool DetectRight(cv::Mat& image, FeatureSet &features, std::vector<Eigen::Vector4d>& lines) override;
+
+private:
+  bool ReadFeatures(int type, std::vector<FeatureSet*> features,
+      std::vector<std::vector<Eigen::Vector4d>*> lines);
+
+private:
+  FeatureLogPtr _feature_log;
+};
+
+class PointMatcherRecorder : public PointMatcher{
+public:
+  PointMatcherRecorder(const PointMatcherConfig& config, FeatureLogPtr feature_log);
+
+  int MatchingPoints(const FeatureSet& features0,
+      const FeatureSet& features1,
+      std::vector<cv::DMatch>& matches,  bool outlier_rejection=false) override;
+
+private:
+  FeatureLogPtr _feature_log;
+};
+
+class PointMatcherReplayer : public PointMatcher{
+public:
+  PointMatcherReplayer(FeatureLogPtr feature_log);
+
+  int MatchingPoints(const FeatureSet& features0,
+      const FeatureSet& features1,
+      std::vector<cv::DMatch>& matches,  bool outlier_rejection=false) override;
+
+private:
+  FeatureLogPtr _feature_log;
+};
+
+#endif  // FEATURE_LOG_H_
@@ -0,0 +1,120 @@
+#ifndef FEATURE_SET_H_
+#define FEATURE_SET_H_
+
+#include <Eigen/Core>
+
+#include "compact_descriptors.h"
+
+// Point features of an image as a structure of arrays. The descriptors are a contiguous DescriptorDim x N matrix,
+// so every descriptor column is aligned and the whole matrix can be used in matrix products without copies.
+// ToPacked and FromPacked convert from and to the (DescriptorDim + 3) x N form, where each column is score, x, y
+// and the descriptor, for the code and the files that still use it.
+// After CompressDescriptors, the descriptors are only kept in compact_descriptors and descriptors is empty, so
+// the descriptors must be read by DecodeDescriptor, DecodeDescriptors or DecodedDescriptors.
+template<int DescriptorDim>
+struct BasicFeatureSet{
+  typedef Eigen::Matrix<float, DescriptorDim, Eigen::Dynamic> Descriptors;
+  typedef Eigen::Matrix<float, DescriptorDim + 3, Eigen::Dynamic> PackedFeatures;
+
+  // 1 x N
+  Eigen::Matrix<float, 1, Eigen::Dynamic> scores;
+  // 2 x N, x in the first row and y in the second row
+  Eigen::Matrix<float, 2, Eigen::Dynamic> keypoints;
+  // DescriptorDim x N, normalized
+  Descriptors descriptors;
+  // fp16 or int8 descriptors of a compressed feature set
+  CompactDescriptors<DescriptorDim> compact_descriptors;
+
+  BasicFeatureSet() {}
+  explicit BasicFeatureSet(const PackedFeatures& packed){
+    FromPacked(packed);
+  }
+
+  int Size() const{
+    return scores.cols();
+  }
+
+  void Resize(int n){
+    scores.resize(1, n);
+    keypoints.resize(2, n);
+    descriptors.resize(DescriptorDim, n);
+    compact_descriptors.Clear();
+  }
+
+  bool DescriptorsCompressed() const{
+    return compact_descriptors.precision != Float32Descriptor;
+  }
+
+  // convert the descriptors to precision (DescriptorPrecision) and release the float descriptors
+  void CompressDescriptors(int precision){
+    if(precision == Float32Descriptor || DescriptorsCompressed()) return;
+    compact_descriptors.Encode(descriptors.data(), Size(), precision);
+    Descriptors().swap(descriptors);
+  }
+
+  void DecompressDescriptors(){
+    if(!DescriptorsCompressed()) return;
+    descriptors.resize(DescriptorDim, Size());
+    compact_descriptors.Decode(descriptors.data());
+    compact_descriptors.Clear();
+  }
+
+  void DecodeDescriptor(int idx, float* descriptor) const{
+    if(DescriptorsCompressed()){
+      compact_descriptors.Decode(idx, descriptor);
+    }else{
+      std::memcpy(descriptor, descriptors.col(idx).data(), sizeof(float) * DescriptorDim);
+    }
+  }
+
+  // to a column-major DescriptorDim x N buffer
+  void DecodeDescriptors(float* output) const{
+    if(DescriptorsCompressed()){
+      compact_descriptors.Decode(output);
+    }else{
+      std::memcpy(output, descriptors.data(), sizeof(float) * descriptors.size());
+    }
+  }
+
+  // descriptors itself if they are not compressed, otherwise buffer with the decoded descriptors
+  const Descriptors& DecodedDescriptors(Descriptors& buffer) const{
+    if(!DescriptorsCompressed()) return descriptors;
+    buffer.resize(DescriptorDim, Size());
+    compact_descriptors.Decode(buffer.data());
+    return buffer;
+  }
+
+  size_t DescriptorBytes() const{
+    return descriptors.size() * sizeof(float) + compact_descriptors.Bytes();
+  }
+
+  void FromPacked(const PackedFeatures& packed){
+    scores = packed.row(0);
+    keypoints = packed.template middleRows<2>(1);
+    descriptors = packed.template bottomRows<DescriptorDim>();
+    compact_descriptors.Clear();
+  }
+
+  void ToPacked(PackedFeatures& packed) const{
+    packed.resize(DescriptorDim + 3, Size());
+    packed.row(0) = scores;
+    packed.template middleRows<2>(1) = keypoints;
+    if(DescriptorsCompressed()){
+      for(int i = 0; i < Size(); ++i){
+        compact_descriptors.Decode(i, packed.col(i).data() + 3);
+      }
+    }else{
+      packed.template bottomRows<DescriptorDim>() = descriptors;
+    }
+  }
+
+  PackedFeatures ToPacked() const{
+    PackedFeatures packed;
+    ToPacked(packed);
+    return packed;
+  }
+};
+
+typedef BasicFeatureSet<256> FeatureSet;
+
+#endif  // FEATURE_SET_H_
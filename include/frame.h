@@ -13,6 +13,7 @@
 #include <boost/serialization/set.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/version.hpp>
 
 #include "utils.h"
 #include "mappoint.h"
@@ -40,13 +41,13 @@ public:
 
   // point features
   bool FindGrid(float& x, float& y, int& grid_x, int& grid_y);
-  void AddFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_left, 
-      Eigen::Matrix<float, 259, Eigen::Dynamic>& features_right, std::vector<Eigen::Vector4d>& lines_left, 
+  void AddFeatures(FeatureSet& features_left, 
+      FeatureSet& features_right, std::vector<Eigen::Vector4d>& lines_left, 
       std::vector<Eigen::Vector4d>& lines_right, std::vector<cv::DMatch>& stereo_matches);
-  void AddLeftFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_left, std::vector<Eigen::Vector4d>& lines_left);
-  int AddRightFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_right, std::vector<Eigen::Vector4d>& lines_right, std::vector<cv::DMatch>& stereo_matches);
+  void AddLeftFeatures(FeatureSet& features_left, std::vector<Eigen::Vector4d>& lines_left);
+  int AddRightFeatures(FeatureSet& features_right, std::vector<Eigen::Vector4d>& lines_right, std::vector<cv::DMatch>& stereo_matches);
 
-  Eigen::Matrix<float, 259, Eigen::Dynamic>& GetAllFeatures();
+  FeatureSet& GetAllFeatures();
 
   size_t FeatureNum();
 
@@ -59,6 +60,8 @@ public:
   std::vector<double>& GetAllRightPosition(); 
 
   bool GetDescriptor(size_t idx, Eigen::Matrix<float, 256, 1>& descriptor) const;
+  // store the point and junction descriptors as DescriptorPrecision, for the keyframes that are no longer tracked
+  void CompressDescriptors(int precision);
 
   double GetDepth(size_t idx);
   std::vector<double>& GetAllDepth();
@@ -92,14 +95,15 @@ public:
   void InsertMapline(size_t idx, MaplinePtr mapline);
   std::vector<MaplinePtr>& GetAllMaplines();
   const std::vector<MaplinePtr>& GetConstAllMaplines();
-  std::map<int, double> GetPointsOnLine(size_t idx);
-  const std::vector<std::map<int, double>>& GetPointsOnLines();
+  // a view of the points on line idx, empty if idx is out of range
+  PointsOnLines::Span GetPointsOnLine(size_t idx);
+  const PointsOnLines& GetPointsOnLines();
   bool TriangulateStereoLine(size_t idx, Vector6d& endpoints);
   void RemoveMapline(MaplinePtr mapline);
   void RemoveMapline(int idx);
 
-  void AddJunctions(Eigen::Matrix<float, 259, Eigen::Dynamic>& junctions);
-  Eigen::Matrix<float, 259, Eigen::Dynamic>& GetJunctions();
+  void AddJunctions(FeatureSet& junctions);
+  FeatureSet& GetJunctions();
   int JunctionNum();
 
   void RemoveMappoint(MappointPtr mappoint);
@@ -140,8 +144,6 @@ public:
 
   // debug
   std::vector<int> line_left_to_right_match;
-  std::vector<std::map<int, double>> relation_left;
-  std::vector<std::map<int, double>> relation_right;
 
 private:
   friend class boost::serialization::access;
@@ -165,7 +167,7 @@ private:
     SerializeEigenVector4dList(ar, _lines, version);
     SerializeEigenVector4dList(ar, _lines_right, version);
     ar & _lines_right_valid;
-    ar & _points_on_lines;
+    SerializePointsOnLines(ar, _points_on_lines, version);
     ar & _line_track_ids;
     ar & _maplines;
 
@@ -190,7 +192,7 @@ private:
   Eigen::Matrix4d _pose;
 
   // point features
-  Eigen::Matrix<float, 259, Eigen::Dynamic> _features;
+  FeatureSet _features;
   std::vector<cv::KeyPoint> _keypoints;
   std::vector<int> _feature_grid[FRAME_GRID_COLS][FRAME_GRID_ROWS];
   double _grid_width_inv;
@@ -204,12 +206,12 @@ private:
   std::vector<Eigen::Vector4d> _lines;
   std::vector<Eigen::Vector4d> _lines_right;
   std::vector<bool> _lines_right_valid;
-  std::vector<std::map<int, double>> _points_on_lines;
+  PointsOnLines _points_on_lines;
   std::vector<int> _line_track_ids;
   std::vector<MaplinePtr> _maplines;
 
   // junctions
-  Eigen::Matrix<float, 259, Eigen::Dynamic> _junctions;
+  FeatureSet _junctions;
   std::vector<std::set<int>> _connected_junctions;
 
   // camera
@@ -229,4 +231,8 @@ private:
 
 typedef std::shared_ptr<Frame> FramePtr;
 
+// version 1: the features can be stored with compressed descriptors
+// version 2: the points on lines are stored in the compressed sparse row form
+BOOST_CLASS_VERSION(Frame, 2)
+
 #endif  // FRAME_H_
\ No newline at end of file
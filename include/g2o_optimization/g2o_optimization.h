@@ -2,6 +2,7 @@
 #define G2O_OPTIMIZATION_H_
 
 #include <vector>
+#include <atomic>
 
 #include "read_configs.h"
 #include "camera.h"
@@ -15,11 +16,14 @@ void AddFrameVertex(FramePtr frame, MapOfPoses& poses, int id_camera, MapOfVeloc
     VectorOfIMUConstraints& imu_constraints, bool fix_this_frame, bool add_imu_constraint, bool use_updated_bias=false);
 
 // pose, velocaity and bias of same frame have same key, i.e. id.
+// force_stop_flag: if it is set to true by another thread, the optimization stops early. It is copied to the flag 
+// g2o reads before every iteration, so g2o never reads memory written by the other thread
 void LocalmapOptimization(MapOfPoses& poses, MapOfPoints3d& points, MapOfLine3d& lines, 
     MapOfVelocity& velocities, MapOfBias& biases, std::vector<CameraPtr>& camera_list, 
     VectorOfMonoPointConstraints& mono_point_constraints, VectorOfStereoPointConstraints& stereo_point_constraints, 
     VectorOfMonoLineConstraints& mono_line_constraints, VectorOfStereoLineConstraints& stereo_line_constraints,
-    VectorOfIMUConstraints& imu_constraints, const Eigen::Matrix3d& Rwg, const OptimizationConfig& cfg);
+    VectorOfIMUConstraints& imu_constraints, const Eigen::Matrix3d& Rwg, const OptimizationConfig& cfg, 
+    const std::atomic<bool>* force_stop_flag = nullptr);
 
 int FrameOptimization(MapOfPoses& poses, MapOfPoints3d& points, MapOfLine3d& lines,
     MapOfVelocity& velocities, MapOfBias& biases, std::vector<CameraPtr>& camera_list, 
@@ -0,0 +1,36 @@
+#ifndef IMAGE_POOL_H_
+#define IMAGE_POOL_H_
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+// A small pool of pre-allocated image buffers. The buffers are handed out as ordinary 
+// reference counted cv::Mat headers, a buffer can be reused once every header outside 
+// the pool has been released. New buffers are only allocated if all of them are in use.
+class ImagePool{
+public:
+  ImagePool(int rows, int cols, int type, size_t size);
+
+  // return an unused buffer of the given size and type
+  cv::Mat Acquire(int rows, int cols, int type);
+
+  size_t Size();
+
+  // number of buffers allocated after the construction of the pool
+  size_t AllocationCount();
+
+private:
+  bool IsFree(const cv::Mat& buffer);
+
+private:
+  std::mutex _mutex;
+  std::vector<cv::Mat> _buffers;
+  size_t _next;
+  size_t _allocation_count;
+};
+
+typedef std::shared_ptr<ImagePool> ImagePoolPtr;
+
+#endif  // IMAGE_POOL_H_
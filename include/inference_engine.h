@@ -0,0 +1,77 @@
+#ifndef INFERENCE_ENGINE_H_
+#define INFERENCE_ENGINE_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+
+enum InferenceBackend {
+  TensorRTBackend = 0,
+  OpenCVBackend = 1,    // OpenCV DNN on CPU
+};
+
+enum TensorRTPrecision {
+  TensorRTFP16 = 0,
+  TensorRTTF32 = 1,
+};
+
+// min, optimal and max shapes of a dynamic input, for the TensorRT optimization profile
+struct InputProfile{
+  std::string name;
+  std::vector<int> min_shape;
+  std::vector<int> opt_shape;
+  std::vector<int> max_shape;
+
+  InputProfile() {}
+  InputProfile(const std::string& name_, const std::vector<int>& min_shape_, const std::vector<int>& opt_shape_,
+      const std::vector<int>& max_shape_) : name(name_), min_shape(min_shape_), opt_shape(opt_shape_), max_shape(max_shape_) {}
+};
+
+struct InferenceEngineConfig{
+  int backend;
+  std::string onnx_file;
+
+  // TensorRT
+  std::string engine_file;
+  int precision;
+  int dla_core;
+  std::vector<InputProfile> input_profiles;
+
+  // OpenCV DNN, intra-op threads of OpenCV, 0 to keep the OpenCV default
+  int cpu_threads;
+
+  InferenceEngineConfig(): backend(TensorRTBackend), precision(TensorRTFP16), dla_core(-1), cpu_threads(0) {}
+};
+
+// A network loaded from an ONNX file. The input and output buffers are kept between runs and are only
+// reallocated when a larger tensor is needed, so the networks write their inputs directly into the engine
+// and read their outputs from it:
+//   float* input = engine->Input("input", {1, 1, h, w});  // fill input
+//   engine->Run();
+//   const float* scores = engine->Output("scores");
+// The buffers are valid until the next Input or Run call with a larger shape. An engine is not thread-safe.
+class InferenceEngine{
+public:
+  virtual ~InferenceEngine() {}
+
+  virtual bool Build() = 0;
+
+  // host buffer of the input name, nullptr if there is no such input
+  virtual float* Input(const std::string& name, const std::vector<int>& shape) = 0;
+
+  virtual bool Run() = 0;
+
+  // host buffer of the output name after Run, nullptr if there is no such output
+  virtual const float* Output(const std::string& name) = 0;
+
+  virtual std::vector<int> OutputShape(const std::string& name) = 0;
+};
+
+typedef std::shared_ptr<InferenceEngine> InferenceEnginePtr;
+
+// nullptr if the backend is not compiled in
+InferenceEnginePtr CreateInferenceEngine(const InferenceEngineConfig& config);
+
+std::string InferenceBackendName(int backend);
+
+#endif  // INFERENCE_ENGINE_H_
@@ -0,0 +1,315 @@
+#ifndef KEYPOINT_DECODER_H_
+#define KEYPOINT_DECODER_H_
+
+#include <cmath>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <Eigen/Core>
+#include <opencv2/core.hpp>
+
+#include "feature_set.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Keypoint decoding shared by SuperPoint and PLNet: keypoint selection from the dense h x w score map and
+// descriptor sampling from the coarse DescriptorDim x (h / Stride) x (w / Stride) channel-first descriptor map.
+// It only depends on Eigen and OpenCV core, so it can be tested and benchmarked on synthetic maps.
+template<int DescriptorDim = 256, int Stride = 8>
+class KeypointDecoder{
+public:
+  typedef BasicFeatureSet<DescriptorDim> Features;
+
+  KeypointDecoder() : _map_height(0), _map_width(0) {}
+
+  // Keypoints with score >= threshold and border <= x <= w - border, border <= y <= h - border. At most top_k
+  // (all if top_k < 0) with the highest scores are kept, sorted by score, otherwise they are in scan order.
+  // With nms_radius > 0, keypoints within nms_radius pixels of a keypoint with a higher score are suppressed.
+  void DetectKeypoints(const float* heat_map, int h, int w, float threshold, int border, int top_k, int nms_radius,
+      Features& features){
+    _candidates.clear();
+    _candidates.reserve(std::max(top_k, 0) * 4);
+    ThresholdScan(heat_map, h, w, threshold, border, _candidates);
+    SelectTopKeypoints(heat_map, h, w, top_k, nms_radius, _candidates, features);
+  }
+
+  // The pixels of junction_indexes (y * w + x, in any order and with duplicates) with border <= x < w - border
+  // and border <= y < h - border, in scan order. junction_indexes is sorted in place.
+  void DetectJunctions(const float* heat_map, std::vector<int>& junction_indexes, int h, int w, int border,
+      Features& junctions){
+    border = std::max(border, 0);
+    std::sort(junction_indexes.begin(), junction_indexes.end());
+    _candidates.clear();
+    int last_index = -1;
+    for(int index : junction_indexes){
+      if(index == last_index) continue;
+      last_index = index;
+      int y = index / w;
+      int x = index - y * w;
+      if(x >= border && x < w - border && y >= border && y < h - border) _candidates.push_back(index);
+    }
+    SelectTopKeypoints(heat_map, h, w, -1, 0, _candidates, junctions);
+  }
+
+  // Transpose the descriptor map of the current image to (h / Stride) x (w / Stride) x DescriptorDim, so the
+  // channels of a cell are contiguous. h and w are the size of the score map.
+  void SetDescriptorMap(const float* descriptors, int h, int w){
+    _map_height = h / Stride;
+    _map_width = w / Stride;
+    TransposeDescriptors(descriptors, _map_height, _map_width, _transposed_descriptors);
+  }
+
+  // Bilinearly sample the descriptors of the features from the map set by SetDescriptorMap and normalize them.
+  void SampleDescriptors(Features& features) const{
+    const int h = _map_height, w = _map_width, s = Stride;
+    float sx = 2.f / (w * s - s / 2 - 0.5);
+    float bx = (1 - s) / (w * s - s / 2 - 0.5) - 1;
+
+    float sy = 2.f / (h * s - s / 2 - 0.5);
+    float by = (1 - s) / (h * s - s / 2 - 0.5) - 1;
+
+    const float* transposed_descriptors = _transposed_descriptors.data();
+    features.descriptors.resize(DescriptorDim, features.Size());
+    const int keypoint_num = features.Size();
+    cv::parallel_for_(cv::Range(0, keypoint_num), [&](const cv::Range& range){
+      for(int j = range.start; j < range.end; ++j){
+        float x_norm = (features.keypoints(0, j) * sx + bx + 1) * 0.5f;
+        float y_norm = (features.keypoints(1, j) * sy + by + 1) * 0.5f;
+        float ix = x_norm * (w - 1);
+        float iy = y_norm * (h - 1);
+
+        int ix_nw = Clip(std::floor(ix), w);
+        int iy_nw = Clip(std::floor(iy), h);
+        int ix_ne = Clip(ix_nw + 1, w);
+        int iy_ne = Clip(iy_nw, h);
+        int ix_sw = Clip(ix_nw, w);
+        int iy_sw = Clip(iy_nw + 1, h);
+        int ix_se = Clip(ix_nw + 1, w);
+        int iy_se = Clip(iy_nw + 1, h);
+
+        float nw = (ix_se - ix) * (iy_se - iy);
+        float ne = (ix - ix_sw) * (iy_sw - iy);
+        float sw = (ix_ne - ix) * (iy - iy_ne);
+        float se = (ix - ix_nw) * (iy - iy_nw);
+
+        // each tap is a contiguous vector of DescriptorDim channels
+        const float* nw_val = transposed_descriptors + (size_t)(iy_nw * w + ix_nw) * DescriptorDim;
+        const float* ne_val = transposed_descriptors + (size_t)(iy_ne * w + ix_ne) * DescriptorDim;
+        const float* sw_val = transposed_descriptors + (size_t)(iy_sw * w + ix_sw) * DescriptorDim;
+        const float* se_val = transposed_descriptors + (size_t)(iy_se * w + ix_se) * DescriptorDim;
+
+        float* descriptor = features.descriptors.data() + (size_t)j * DescriptorDim;
+        float squared_norm = 0;
+        for(int i = 0; i < DescriptorDim; ++i){
+          float value = nw_val[i] * nw + ne_val[i] * ne + sw_val[i] * sw + se_val[i] * se;
+          descriptor[i] = value;
+          squared_norm += value * value;
+        }
+
+        if(squared_norm > 0){
+          float scale = 1.0f / std::sqrt(squared_norm);
+          for(int i = 0; i < DescriptorDim; ++i){
+            descriptor[i] *= scale;
+          }
+        }
+      }
+    });
+  }
+
+  // DetectKeypoints, SetDescriptorMap and SampleDescriptors
+  void Decode(const float* heat_map, const float* descriptors, int h, int w, float threshold, int border, int top_k,
+      int nms_radius, Features& features){
+    DetectKeypoints(heat_map, h, w, threshold, border, top_k, nms_radius, features);
+    SetDescriptorMap(descriptors, h, w);
+    SampleDescriptors(features);
+  }
+
+  // Append the indexes (y * w + x) of the scores >= threshold to candidates, row by row. Only the pixels with
+  // border <= x <= w - border and border <= y <= h - border are scanned. Uses AVX2/SSE2/NEON when available.
+  static void ThresholdScan(const float* heat_map, int h, int w, float threshold, int border,
+      std::vector<int>& candidates){
+    int min_x = std::max(border, 0);
+    int min_y = std::max(border, 0);
+    int max_x = std::min(w - border, w - 1);
+    int max_y = std::min(h - border, h - 1);
+
+    for(int y = min_y; y <= max_y; ++y){
+      const float* row = heat_map + y * w;
+      int x = min_x;
+      int row_start = y * w;
+
+#if defined(__AVX2__)
+      const __m256 threshold_v = _mm256_set1_ps(threshold);
+      for(; x + 8 <= max_x + 1; x += 8){
+        __m256 score_v = _mm256_loadu_ps(row + x);
+        unsigned int mask = _mm256_movemask_ps(_mm256_cmp_ps(score_v, threshold_v, _CMP_GE_OQ));
+        PushMask(mask, row_start + x, candidates);
+      }
+#elif defined(__SSE2__)
+      const __m128 threshold_v = _mm_set1_ps(threshold);
+      for(; x + 4 <= max_x + 1; x += 4){
+        __m128 score_v = _mm_loadu_ps(row + x);
+        unsigned int mask = _mm_movemask_ps(_mm_cmpge_ps(score_v, threshold_v));
+        PushMask(mask, row_start + x, candidates);
+      }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+      const float32x4_t threshold_v = vdupq_n_f32(threshold);
+      for(; x + 4 <= max_x + 1; x += 4){
+        uint32x4_t ge = vcgeq_f32(vld1q_f32(row + x), threshold_v);
+        // most scores are below the threshold, check the four lanes only if one of them passes
+        if(vmaxvq_u32(ge) == 0) continue;
+        unsigned int mask = (vgetq_lane_u32(ge, 0) & 1) | (vgetq_lane_u32(ge, 1) & 2) |
+            (vgetq_lane_u32(ge, 2) & 4) | (vgetq_lane_u32(ge, 3) & 8);
+        PushMask(mask, row_start + x, candidates);
+      }
+#endif
+
+      for(; x <= max_x; ++x){
+        if(row[x] >= threshold) candidates.push_back(row_start + x);
+      }
+    }
+  }
+
+  // Keep the top_k candidates with the highest scores (all if top_k < 0), after the non-maximum suppression if
+  // nms_radius > 0. Write their scores and coordinates to features.
+  void SelectTopKeypoints(const float* heat_map, int h, int w, int top_k, int nms_radius,
+      std::vector<int>& candidates, Features& features){
+    // equal scores are ordered by the index, so the selection does not depend on the order of the candidates
+    auto higher_score = [heat_map](int i1, int i2){
+      return heat_map[i1] > heat_map[i2] || (heat_map[i1] == heat_map[i2] && i1 < i2);
+    };
+    if(nms_radius > 0){
+      // greedy suppression in the order of the scores. With top_k, the candidates are sorted chunk by chunk
+      // and the next chunk is only selected if the previous ones did not give enough keypoints.
+      _suppressed.assign((size_t)h * w, 0);
+      size_t kept = 0, begin = 0;
+      while(begin < candidates.size() && (top_k < 0 || (int)kept < top_k)){
+        size_t end = candidates.size();
+        if(top_k >= 0) end = std::min(end, begin + std::max<size_t>(4 * (top_k - kept), 64));
+        if(end < candidates.size()){
+          std::nth_element(candidates.begin() + begin, candidates.begin() + end, candidates.end(), higher_score);
+        }
+        std::sort(candidates.begin() + begin, candidates.begin() + end, higher_score);
+
+        for(size_t i = begin; i < end && (top_k < 0 || (int)kept < top_k); ++i){
+          int index = candidates[i];
+          if(_suppressed[index]) continue;
+          candidates[kept++] = index;
+          int y = index / w;
+          int x = index - y * w;
+          int min_x = std::max(x - nms_radius, 0);
+          int max_x = std::min(x + nms_radius, w - 1);
+          for(int yy = std::max(y - nms_radius, 0); yy <= std::min(y + nms_radius, h - 1); ++yy){
+            std::memset(_suppressed.data() + (size_t)yy * w + min_x, 1, max_x - min_x + 1);
+          }
+        }
+        begin = end;
+      }
+      candidates.resize(kept);
+    }else if(top_k >= 0 && (int)candidates.size() > top_k){
+      // O(n) selection of the top k, only the selected ones are sorted
+      std::nth_element(candidates.begin(), candidates.begin() + top_k, candidates.end(), higher_score);
+      candidates.resize(top_k);
+      std::sort(candidates.begin(), candidates.end(), higher_score);
+    }
+
+    features.Resize(candidates.size());
+    for(size_t i = 0; i < candidates.size(); ++i){
+      int index = candidates[i];
+      int y = index / w;
+      features.scores(i) = heat_map[index];
+      features.keypoints(0, i) = float(index - y * w);
+      features.keypoints(1, i) = float(y);
+    }
+  }
+
+  // Transpose the DescriptorDim x h x w descriptor map to h x w x DescriptorDim.
+  static void TransposeDescriptors(const float* descriptors, int h, int w, std::vector<float>& transposed_descriptors){
+    const int cell_num = h * w;
+    // blocks of a few cells, so the writes of all channels of the block stay in the cache
+    const int block_size = 8;
+    const int block_num = (cell_num + block_size - 1) / block_size;
+    const int channel_end = DescriptorDim - DescriptorDim % 4;
+    transposed_descriptors.resize((size_t)cell_num * DescriptorDim);
+    float* output = transposed_descriptors.data();
+
+    cv::parallel_for_(cv::Range(0, block_num), [&](const cv::Range& range){
+      for(int b = range.start; b < range.end; ++b){
+        int start = b * block_size;
+        int end = std::min(start + block_size, cell_num);
+        for(int c = 0; c < channel_end; c += 4){
+          int n = start;
+          for(; n + 4 <= end; n += 4){
+            Transpose4x4(descriptors + (size_t)c * cell_num + n, cell_num,
+                output + (size_t)n * DescriptorDim + c, DescriptorDim);
+          }
+          for(; n < end; ++n){
+            for(int k = c; k < c + 4; ++k){
+              output[(size_t)n * DescriptorDim + k] = descriptors[(size_t)k * cell_num + n];
+            }
+          }
+        }
+        for(int c = channel_end; c < DescriptorDim; ++c){
+          for(int n = start; n < end; ++n){
+            output[(size_t)n * DescriptorDim + c] = descriptors[(size_t)c * cell_num + n];
+          }
+        }
+      }
+    });
+  }
+
+private:
+  static int Clip(int val, int max){
+    if(val < 0) return 0;
+    return std::min(val, max - 1);
+  }
+
+  static void PushMask(unsigned int mask, int index, std::vector<int>& candidates){
+    while(mask){
+      candidates.push_back(index + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+
+  // transpose a 4x4 block, the rows of the input and the output are input_stride and output_stride apart
+  static void Transpose4x4(const float* input, size_t input_stride, float* output, size_t output_stride){
+#if defined(__SSE2__)
+    __m128 r0 = _mm_loadu_ps(input);
+    __m128 r1 = _mm_loadu_ps(input + input_stride);
+    __m128 r2 = _mm_loadu_ps(input + 2 * input_stride);
+    __m128 r3 = _mm_loadu_ps(input + 3 * input_stride);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(output, r0);
+    _mm_storeu_ps(output + output_stride, r1);
+    _mm_storeu_ps(output + 2 * output_stride, r2);
+    _mm_storeu_ps(output + 3 * output_stride, r3);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4x2_t t01 = vtrnq_f32(vld1q_f32(input), vld1q_f32(input + input_stride));
+    float32x4x2_t t23 = vtrnq_f32(vld1q_f32(input + 2 * input_stride), vld1q_f32(input + 3 * input_stride));
+    vst1q_f32(output, vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])));
+    vst1q_f32(output + output_stride, vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])));
+    vst1q_f32(output + 2 * output_stride, vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])));
+    vst1q_f32(output + 3 * output_stride, vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])));
+#else
+    for(int i = 0; i < 4; ++i){
+      for(int j = 0; j < 4; ++j){
+        output[j * output_stride + i] = input[i * input_stride + j];
+      }
+    }
+#endif
+  }
+
+  int _map_height;
+  int _map_width;
+  std::vector<float> _transposed_descriptors;
+  std::vector<int> _candidates;
+  std::vector<unsigned char> _suppressed;
+};
+
+#endif  // KEYPOINT_DECODER_H_
@@ -0,0 +1,122 @@
+#ifndef LATENCY_STATS_H_
+#define LATENCY_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// Lightweight per-stage latency instrumentation.
+// Each thread records into its own log-linear (HDR-style) histograms, so recording is lock-free.
+// The histograms of all threads are merged when the statistics are saved.
+//
+// Usage:
+//   { LATENCY_SCOPE("detection"); ... }            // time a scope
+//   LATENCY_COUNT("keyframes", 1);                   // increase a counter
+//   LatencyStats::Instance().SaveToJson(file_path);  // p50/p90/p99/max of all stages
+
+class LatencyHistogram{
+public:
+  // values are recorded in microseconds, 32 sub-buckets per power of two (~3% precision)
+  static const int SubBucketBits = 5;
+  static const int SubBucketNum = 1 << SubBucketBits;
+  static const int MagnitudeNum = 40 - SubBucketBits;
+  static const int BucketNum = (MagnitudeNum + 1) * SubBucketNum;
+
+  LatencyHistogram();
+  void Record(uint64_t value_us);
+  void Merge(const LatencyHistogram& other);
+  uint64_t Count() const;
+  uint64_t Max() const;
+  double Mean() const;
+  // percentile in [0, 100], in microseconds
+  uint64_t Percentile(double percentile) const;
+
+  static int BucketIndex(uint64_t value);
+  static uint64_t BucketValue(int index);
+
+private:
+  // only written by the owning thread, atomics make concurrent reading safe
+  std::atomic<uint64_t> _buckets[BucketNum];
+  std::atomic<uint64_t> _count;
+  std::atomic<uint64_t> _sum;
+  std::atomic<uint64_t> _max;
+};
+
+class LatencyStats{
+public:
+  static const int MaxStageNum = 64;
+  static const int MaxCounterNum = 64;
+
+  static LatencyStats& Instance();
+
+  // register once per call site, return -1 if there are too many stages
+  int RegisterStage(const std::string& name);
+  int RegisterCounter(const std::string& name);
+
+  void Record(int stage_id, uint64_t value_us);
+  void Count(int counter_id, int64_t value);
+
+  void SaveToJson(const std::string& file_path);
+  void SaveToCsv(const std::string& file_path);
+  void Print();
+
+private:
+  struct StageSummary{
+    std::string name;
+    uint64_t count;
+    double mean;
+    uint64_t p50, p90, p99, max;
+  };
+
+  struct ThreadHistograms{
+    std::atomic<LatencyHistogram*> histograms[MaxStageNum];
+    ThreadHistograms();
+    ~ThreadHistograms();
+  };
+
+  LatencyStats();
+  ThreadHistograms* GetThreadHistograms();
+  void Summarize(std::vector<StageSummary>& stages, std::vector<std::pair<std::string, int64_t>>& counters);
+
+private:
+  std::mutex _mutex;
+  std::vector<std::string> _stage_names;
+  std::vector<std::string> _counter_names;
+  std::atomic<int64_t> _counters[MaxCounterNum];
+  std::vector<std::unique_ptr<ThreadHistograms>> _thread_histograms;
+};
+
+class ScopedLatency{
+public:
+  explicit ScopedLatency(int stage_id) : _stage_id(stage_id), _start(std::chrono::steady_clock::now()){
+  }
+
+  ~ScopedLatency(){
+    auto stop = std::chrono::steady_clock::now();
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(stop - _start).count();
+    LatencyStats::Instance().Record(_stage_id, us);
+  }
+
+private:
+  int _stage_id;
+  std::chrono::steady_clock::time_point _start;
+};
+
+#define LATENCY_CONCAT_INNER(a, b) a##b
+#define LATENCY_CONCAT(a, b) LATENCY_CONCAT_INNER(a, b)
+
+#define LATENCY_SCOPE(name) \
+  static const int LATENCY_CONCAT(_latency_stage_, __LINE__) = LatencyStats::Instance().RegisterStage(name); \
+  ScopedLatency LATENCY_CONCAT(_latency_scope_, __LINE__)(LATENCY_CONCAT(_latency_stage_, __LINE__))
+
+#define LATENCY_COUNT(name, value) \
+  do{ \
+    static const int _latency_counter = LatencyStats::Instance().RegisterCounter(name); \
+    LatencyStats::Instance().Count(_latency_counter, value); \
+  }while(0)
+
+#endif  // LATENCY_STATS_H_
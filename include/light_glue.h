@@ -7,16 +7,12 @@
 
 #include <string>
 #include <memory>
-#include <NvInfer.h>
 #include <Eigen/Core>
-#include <NvOnnxParser.h>
 #include <opencv2/opencv.hpp>
 
-
-#include "3rdparty/tensorrtbuffer/include/buffers.h"
+#include "inference_engine.h"
 #include "read_configs.h"
-
-using tensorrt_buffer::TensorRTUniquePtr;
+#include "feature_set.h"
 
 class SuperPointLightGlue {
 public:
@@ -25,40 +21,45 @@ public:
 
     bool build();
 
-    bool infer(const Eigen::Matrix<float, 258, Eigen::Dynamic> &features0,
-               const Eigen::Matrix<float, 258, Eigen::Dynamic> &features1,
+    // 1 if the engine could only be built for single pairs
+    int max_batch_size() const;
+
+    // keypoints are the normalized keypoints of features, which provide the descriptors
+    bool infer(const Eigen::Matrix2Xf &keypoints0,
+               const FeatureSet &features0,
+               const Eigen::Matrix2Xf &keypoints1,
+               const FeatureSet &features1,
                Eigen::Matrix<int, Eigen::Dynamic, 2> &matches_index,
                Eigen::Matrix<float, Eigen::Dynamic, 1> &matches_score);
 
-    void save_engine();
-
-    bool deserialize_engine();
+    // matches of features0 to every features1 in one inference with batch size features1.size(), all features1
+    // must have the same number of keypoints
+    bool infer_batch(const Eigen::Matrix2Xf &keypoints0,
+                     const FeatureSet &features0,
+                     const std::vector<Eigen::Matrix2Xf> &keypoints1,
+                     const std::vector<const FeatureSet *> &features1,
+                     std::vector<Eigen::Matrix<int, Eigen::Dynamic, 2>> &matches_index,
+                     std::vector<Eigen::Matrix<float, Eigen::Dynamic, 1>> &matches_score);
 
 private:
     PointMatcherConfig lightglue_config_;
-    std::vector<int> indices0_;
-    std::vector<int> indices1_;
-    std::vector<float> mscores0_;
-    std::vector<float> mscores1_;
-
-    nvinfer1::Dims keypoints_0_dims_{};
-    nvinfer1::Dims descriptors_0_dims_{};
-    nvinfer1::Dims keypoints_1_dims_{};
-    nvinfer1::Dims descriptors_1_dims_{};
+    // argmax of the rows and the columns of the scores, kept between calls
+    std::vector<int> row_max_index_;
+    std::vector<float> row_max_score_;
+    std::vector<int> col_max_index_;
+    std::vector<float> col_max_score_;
 
-    std::shared_ptr<nvinfer1::ICudaEngine> engine_;
-    std::shared_ptr<nvinfer1::IExecutionContext> context_;
+    int keypoints_0_num_;
+    int keypoints_1_num_;
 
-    bool construct_network(TensorRTUniquePtr<nvinfer1::IBuilder> &builder,
-                           TensorRTUniquePtr<nvinfer1::INetworkDefinition> &network,
-                           TensorRTUniquePtr<nvinfer1::IBuilderConfig> &config,
-                           TensorRTUniquePtr<nvonnxparser::IParser> &parser) const;
+    InferenceEnginePtr engine_;
 
-    bool process_input(const tensorrt_buffer::BufferManager &buffers,
-                       const Eigen::Matrix<float, 258, Eigen::Dynamic> &features0,
-                       const Eigen::Matrix<float, 258, Eigen::Dynamic> &features1);
+    bool process_input(const Eigen::Matrix2Xf &keypoints0,
+                       const FeatureSet &features0,
+                       const Eigen::Matrix2Xf &keypoints1,
+                       const FeatureSet &features1);
 
-    bool process_output(const tensorrt_buffer::BufferManager &buffers, Eigen::Matrix<int, Eigen::Dynamic, 2> &matches_index, Eigen::Matrix<float, Eigen::Dynamic, 1> &matches_score);
+    bool process_output(Eigen::Matrix<int, Eigen::Dynamic, 2> &matches_index, Eigen::Matrix<float, Eigen::Dynamic, 1> &matches_score);
 
 };
 
@@ -21,10 +21,12 @@ float PointLineDistance(Eigen::Vector4f line, Eigen::Vector2f point);
 double CVPointLineDistance3D(const std::vector<cv::Point3f> points, const cv::Vec6f& line, std::vector<float>& dist);
 void EigenPointLineDistance3D(const std::vector<Eigen::Vector3d>& points, const Vector6d& line, std::vector<double>& dist);
 float AngleDiff(float& angle1, float& angle2);
-void AssignPointsToLines(std::vector<Eigen::Vector4d>& lines, Eigen::Matrix<float, 259, Eigen::Dynamic>& points, 
-    std::vector<std::map<int, double>>& relation);
-void MatchLines(const std::vector<std::map<int, double>>& points_on_line0, 
-    const std::vector<std::map<int, double>>& points_on_line1, const std::vector<cv::DMatch>& point_matches, 
+// grid : indexes of the points bucketed as Frame::_feature_grid, grid[x * grid_rows + y] is the cell (x, y)
+void AssignPointsToLines(std::vector<Eigen::Vector4d>& lines, const Eigen::Matrix2Xf& points, 
+    const std::vector<int>* grid, int grid_cols, int grid_rows, double grid_width_inv, double grid_height_inv,
+    PointsOnLines& relation);
+void MatchLines(const PointsOnLines& points_on_line0, 
+    const PointsOnLines& points_on_line1, const std::vector<cv::DMatch>& point_matches, 
     size_t point_num0, size_t point_num1, std::vector<int>& line_matches);
 
 void SortPointsOnLine(std::vector<Eigen::Vector2d>& points, std::vector<size_t>& order, bool sort_by_x = true);
@@ -0,0 +1,267 @@
+#ifndef LOG_OPTIMAL_TRANSPORT_H_
+#define LOG_OPTIMAL_TRANSPORT_H_
+
+#include <cmath>
+#include <vector>
+#include <cfloat>
+#include <algorithm>
+#include <opencv2/core.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Log-domain Sinkhorn normalization of SuperGlue: the m x n score matrix is extended by a dustbin row and
+// column filled with alpha, and the row and column log-sum-exps are alternately normalized to the marginals.
+// Every log-sum-exp is stabilized by the max of its row, and the exponentials use a polynomial approximation
+// (relative error < 2e-7) with AVX2/SSE2/NEON when available. The column pass runs on a transposed copy of
+// the couplings, so both passes read contiguous memory, and the rows are split over the OpenCV threads.
+// The buffers are kept between calls. Not thread-safe.
+class LogOptimalTransport{
+public:
+  LogOptimalTransport() : _m(0), _n(0) {}
+
+  // scores is m x n row-major, Z is (m + 1) x (n + 1) row-major and receives the log assignment. The iterations
+  // stop early once no dual variable changes by more than tolerance (0 to always run max_iters).
+  // Returns the iterations done.
+  int Solve(const float* scores, int m, int n, float alpha, int max_iters, float tolerance, float* Z){
+    _m = m + 1;
+    _n = n + 1;
+    _couplings.resize(_m * _n);
+    _couplings_t.resize(_n * _m);
+    for(int i = 0; i < m; ++i){
+      std::copy(scores + i * n, scores + (i + 1) * n, _couplings.begin() + i * _n);
+      _couplings[i * _n + n] = alpha;
+    }
+    std::fill(_couplings.begin() + m * _n, _couplings.end(), alpha);
+    for(int i = 0; i < _m; ++i){
+      for(int j = 0; j < _n; ++j){
+        _couplings_t[j * _m + i] = _couplings[i * _n + j];
+      }
+    }
+
+    const float norm = -std::log((float)(m + n));
+    _log_mu.assign(_m, norm);
+    _log_mu[m] = std::log((float)n) + norm;
+    _log_nu.assign(_n, norm);
+    _log_nu[n] = std::log((float)m) + norm;
+    _u.assign(_m, 0.0f);
+    _v.assign(_n, 0.0f);
+    _v_last.resize(_n);
+
+    int iter = 0;
+    while(iter < max_iters){
+      _v_last = _v;
+      NormalizeRows(_couplings.data(), _m, _n, _v.data(), _log_mu.data(), _u.data());
+      NormalizeRows(_couplings_t.data(), _n, _m, _u.data(), _log_nu.data(), _v.data());
+      ++iter;
+
+      // u is a function of v, so v alone tells whether the iteration has converged
+      float max_change = 0;
+      for(int j = 0; j < _n; ++j){
+        max_change = std::max(max_change, std::abs(_v[j] - _v_last[j]));
+      }
+      if(max_change <= tolerance) break;
+    }
+
+    for(int i = 0; i < _m; ++i){
+      const float ui = _u[i] - norm;
+      const float* row = _couplings.data() + i * _n;
+      float* z = Z + i * _n;
+      for(int j = 0; j < _n; ++j){
+        z[j] = row[j] + ui + _v[j];
+      }
+    }
+    return iter;
+  }
+
+  // log(sum_j exp(row[j] + offsets[j])), stabilized by the max
+  static float LogSumExp(const float* row, const float* offsets, int n){
+    float max_value = MaxSum(row, offsets, n);
+    if(max_value == -FLT_MAX) return max_value;
+    return max_value + std::log(ExpSum(row, offsets, n, max_value));
+  }
+
+  // max_j row[j] + offsets[j]
+  static float MaxSum(const float* row, const float* offsets, int n){
+    int j = 0;
+    float max_value = -FLT_MAX;
+#if defined(__AVX2__)
+    __m256 max8 = _mm256_set1_ps(-FLT_MAX);
+    for(; j + 8 <= n; j += 8){
+      max8 = _mm256_max_ps(max8, _mm256_add_ps(_mm256_loadu_ps(row + j), _mm256_loadu_ps(offsets + j)));
+    }
+    alignas(32) float maxs[8];
+    _mm256_store_ps(maxs, max8);
+    for(int k = 0; k < 8; ++k) max_value = std::max(max_value, maxs[k]);
+#elif defined(__SSE2__)
+    __m128 max4 = _mm_set1_ps(-FLT_MAX);
+    for(; j + 4 <= n; j += 4){
+      max4 = _mm_max_ps(max4, _mm_add_ps(_mm_loadu_ps(row + j), _mm_loadu_ps(offsets + j)));
+    }
+    alignas(16) float maxs[4];
+    _mm_store_ps(maxs, max4);
+    for(int k = 0; k < 4; ++k) max_value = std::max(max_value, maxs[k]);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t max4 = vdupq_n_f32(-FLT_MAX);
+    for(; j + 4 <= n; j += 4){
+      max4 = vmaxq_f32(max4, vaddq_f32(vld1q_f32(row + j), vld1q_f32(offsets + j)));
+    }
+    max_value = vmaxvq_f32(max4);
+#endif
+    for(; j < n; ++j){
+      max_value = std::max(max_value, row[j] + offsets[j]);
+    }
+    return max_value;
+  }
+
+  // sum_j exp(row[j] + offsets[j] - shift)
+  static float ExpSum(const float* row, const float* offsets, int n, float shift){
+    int j = 0;
+    float sum = 0;
+#if defined(__AVX2__)
+    __m256 sum8 = _mm256_setzero_ps();
+    const __m256 shift8 = _mm256_set1_ps(shift);
+    for(; j + 8 <= n; j += 8){
+      __m256 x = _mm256_sub_ps(_mm256_add_ps(_mm256_loadu_ps(row + j), _mm256_loadu_ps(offsets + j)), shift8);
+      sum8 = _mm256_add_ps(sum8, Exp8(x));
+    }
+    alignas(32) float sums[8];
+    _mm256_store_ps(sums, sum8);
+    for(int k = 0; k < 8; ++k) sum += sums[k];
+#elif defined(__SSE2__)
+    __m128 sum4 = _mm_setzero_ps();
+    const __m128 shift4 = _mm_set1_ps(shift);
+    for(; j + 4 <= n; j += 4){
+      __m128 x = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(row + j), _mm_loadu_ps(offsets + j)), shift4);
+      sum4 = _mm_add_ps(sum4, Exp4(x));
+    }
+    alignas(16) float sums[4];
+    _mm_store_ps(sums, sum4);
+    for(int k = 0; k < 4; ++k) sum += sums[k];
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t sum4 = vdupq_n_f32(0);
+    const float32x4_t shift4 = vdupq_n_f32(shift);
+    for(; j + 4 <= n; j += 4){
+      float32x4_t x = vsubq_f32(vaddq_f32(vld1q_f32(row + j), vld1q_f32(offsets + j)), shift4);
+      sum4 = vaddq_f32(sum4, Exp4(x));
+    }
+    sum += vaddvq_f32(sum4);
+#endif
+    for(; j < n; ++j){
+      sum += Exp(row[j] + offsets[j] - shift);
+    }
+    return sum;
+  }
+
+  // exp(x) for x <= 0 by range reduction x = k * ln2 + r and a degree 5 polynomial of r (Cephes expf),
+  // the SIMD versions below compute the same
+  static float Exp(float x){
+    x = std::max(x, kExpMin);
+    float k = std::floor(x * kLog2e + 0.5f);
+    float r = x - k * kLn2Hi - k * kLn2Lo;
+    float p = ((((kP0 * r + kP1) * r + kP2) * r + kP3) * r + kP4) * r + kP5;
+    p = p * r * r + r + 1.0f;
+    return std::ldexp(p, (int)k);
+  }
+
+private:
+  // rows x cols matrix, result[i] = marginals[i] - log(sum_j exp(matrix[i][j] + offsets[j]))
+  static void NormalizeRows(const float* matrix, int rows, int cols, const float* offsets, const float* marginals,
+      float* result){
+    auto normalize = [&](int begin, int end){
+      for(int i = begin; i < end; ++i){
+        result[i] = marginals[i] - LogSumExp(matrix + i * cols, offsets, cols);
+      }
+    };
+    // small problems do not pay for the thread dispatch, which happens twice per iteration
+    if((size_t)rows * cols < kParallelSize){
+      normalize(0, rows);
+    }else{
+      cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range){ normalize(range.start, range.end); });
+    }
+  }
+
+#if defined(__AVX2__)
+  static __m256 Exp8(__m256 x){
+    x = _mm256_max_ps(x, _mm256_set1_ps(kExpMin));
+    __m256 k = _mm256_floor_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(kLog2e)), _mm256_set1_ps(0.5f)));
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(k, _mm256_set1_ps(kLn2Hi)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(k, _mm256_set1_ps(kLn2Lo)));
+    __m256 p = _mm256_set1_ps(kP0);
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(kP1));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(kP2));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(kP3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(kP4));
+    p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(kP5));
+    p = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, r), r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+    __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+  }
+#elif defined(__SSE2__)
+  static __m128 Exp4(__m128 x){
+    x = _mm_max_ps(x, _mm_set1_ps(kExpMin));
+    // floor by truncation, which rounds the negative values up
+    __m128 t = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(kLog2e)), _mm_set1_ps(0.5f));
+    __m128 k = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+    k = _mm_sub_ps(k, _mm_and_ps(_mm_cmpgt_ps(k, t), _mm_set1_ps(1.0f)));
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(kLn2Hi)));
+    r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(kLn2Lo)));
+    __m128 p = _mm_set1_ps(kP0);
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(kP1));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(kP2));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(kP3));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(kP4));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(kP5));
+    p = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r), _mm_add_ps(r, _mm_set1_ps(1.0f)));
+    __m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(k), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(p, _mm_castsi128_ps(e));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  static float32x4_t Exp4(float32x4_t x){
+    x = vmaxq_f32(x, vdupq_n_f32(kExpMin));
+    float32x4_t k = vrndmq_f32(vaddq_f32(vmulq_n_f32(x, kLog2e), vdupq_n_f32(0.5f)));
+    float32x4_t r = vsubq_f32(x, vmulq_n_f32(k, kLn2Hi));
+    r = vsubq_f32(r, vmulq_n_f32(k, kLn2Lo));
+    float32x4_t p = vdupq_n_f32(kP0);
+    p = vaddq_f32(vmulq_f32(p, r), vdupq_n_f32(kP1));
+    p = vaddq_f32(vmulq_f32(p, r), vdupq_n_f32(kP2));
+    p = vaddq_f32(vmulq_f32(p, r), vdupq_n_f32(kP3));
+    p = vaddq_f32(vmulq_f32(p, r), vdupq_n_f32(kP4));
+    p = vaddq_f32(vmulq_f32(p, r), vdupq_n_f32(kP5));
+    p = vaddq_f32(vmulq_f32(vmulq_f32(p, r), r), vaddq_f32(r, vdupq_n_f32(1.0f)));
+    int32x4_t e = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(k), vdupq_n_s32(127)), 23);
+    return vmulq_f32(p, vreinterpretq_f32_s32(e));
+  }
+#endif
+
+private:
+  // below it the result would be denormal, exp(-87) is negligible in the sums anyway
+  static constexpr float kExpMin = -87.0f;
+  static constexpr float kLog2e = 1.44269504088896341f;
+  static constexpr float kLn2Hi = 0.693359375f;
+  static constexpr float kLn2Lo = -2.12194440e-4f;
+  static constexpr float kP0 = 1.9875691500e-4f;
+  static constexpr float kP1 = 1.3981999507e-3f;
+  static constexpr float kP2 = 8.3334519073e-3f;
+  static constexpr float kP3 = 4.1665795894e-2f;
+  static constexpr float kP4 = 1.6666665459e-1f;
+  static constexpr float kP5 = 5.0000001201e-1f;
+  static constexpr size_t kParallelSize = 64 * 1024;
+
+  int _m;
+  int _n;
+  std::vector<float> _couplings;    // (m + 1) x (n + 1)
+  std::vector<float> _couplings_t;  // (n + 1) x (m + 1)
+  std::vector<float> _log_mu;
+  std::vector<float> _log_nu;
+  std::vector<float> _u;
+  std::vector<float> _v;
+  std::vector<float> _v_last;
+};
+
+#endif  // LOG_OPTIMAL_TRANSPORT_H_
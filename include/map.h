@@ -1,6 +1,8 @@
 #ifndef MAP_H_
 #define MAP_H_
 
+#include <mutex>
+#include <atomic>
 #include <opencv2/highgui/highgui.hpp>
 
 #include <boost/serialization/serialization.hpp>
@@ -25,7 +27,14 @@ class Map{
 public:
   Map();
   Map(OptimizationConfig& backend_optimization_config, CameraPtr camera, RosPublisherPtr ros_publisher);
+
+  // InsertKeyframe = AddKeyframe + ProcessKeyframe. AddKeyframe only registers the keyframe and creates 
+  // its mappoints and maplines, the caller must hold the map mutex. ProcessKeyframe runs the local BA 
+  // and the IMU initialization, it locks the map mutex by itself and can be called from another thread.
   void InsertKeyframe(FramePtr frame);
+  void AddKeyframe(FramePtr frame);
+  void ProcessKeyframe(FramePtr frame, const std::atomic<bool>* abort_flag = nullptr);
+  std::mutex& GetMapMutex();
   void InsertMappoint(MappointPtr mappoint);
   void InsertMapline(MaplinePtr mapline);
   bool UppdateMapline(MaplinePtr mapline);
@@ -43,7 +52,7 @@ public:
   bool TriangulateMappoint(MappointPtr mappoint);
   bool TriangulateMaplineByMappoints(MaplinePtr mapline);
   bool UpdateMappointDescriptor(MappointPtr mappoint);
-  void LocalMapOptimization(FramePtr new_frame);
+  void LocalMapOptimization(FramePtr new_frame, const std::atomic<bool>* abort_flag = nullptr);
   std::pair<FramePtr, FramePtr> MakeFramePair(FramePtr frame0, FramePtr frame1);
   void RemoveOutliers(const std::vector<std::pair<FramePtr, MappointPtr>>& outliers);
   void RemoveLineOutliers(const std::vector<std::pair<FramePtr, MaplinePtr>>& line_outliers);
@@ -126,6 +135,9 @@ private:
   std::vector<int> _keyframe_ids;
   RosPublisherPtr _ros_publisher;
 
+  // protect keyframes, mappoints and maplines shared by the tracking and local mapping threads
+  std::mutex _map_mutex;
+
   // for imu
   bool _imu_init;
   Eigen::Matrix3d _Rwg;
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <chrono>
+#include <atomic>
 #include <opencv2/opencv.hpp>
 #include <Eigen/Core>
 
@@ -13,11 +14,15 @@
 #include "camera.h"
 #include "frame.h"
 #include "point_matcher.h"
+#include "stereo_matcher.h"
 #include "line_processor.h"
 #include "feature_detector.h"
 #include "map.h"
 #include "ros_publisher.h"
 #include "g2o_optimization/types.h"
+#include "bounded_queue.h"
+#include "image_pool.h"
+#include "budget_controller.h"
 
 struct InputData{
   size_t index;
@@ -27,11 +32,13 @@ struct InputData{
   ImuDataList batch_imu_data;
 
   InputData() {}
+  // images are shared read-only between the threads, so they are not deep copied
   InputData& operator =(InputData& other){
 		index = other.index;
 		time = other.time;
-		image_left = other.image_left.clone();
-		image_right = other.image_right.clone();
+		image_left = other.image_left;
+		image_right = other.image_right;
+		batch_imu_data = other.batch_imu_data;
 		return *this;
 	}
 };
@@ -43,24 +50,56 @@ enum FrameType {
   InitializationFrame = 2,
 };
 
+// what AddInput does when the pipeline can not keep up with the input
+enum InputPolicy {
+  BlockInput = 0,       // wait, no frame is dropped
+  DropOldestInput = 1,  // drop the oldest queued normal frames when a queue is full
+  LatestInputOnly = 2,  // drop all queued normal frames, only the latest one is processed
+};
+
 struct TrackingData{
   FramePtr frame;
   FrameType frame_type;
   FramePtr ref_keyframe;
   std::vector<cv::DMatch> matches;
   InputDataPtr input_data;
+  double feature_time;  // ms spent in the feature thread
+  bool point_matcher_matches;  // false if the matches come from the projection of the keyframe mappoints
 
-  TrackingData() {}
+  TrackingData(): feature_time(0), point_matcher_matches(false) {}
   TrackingData& operator =(TrackingData& other){
 		frame = other.frame;
 		ref_keyframe = other.ref_keyframe;
 		matches = other.matches;
+		point_matcher_matches = other.point_matcher_matches;
 		input_data = other.input_data;
+		feature_time = other.feature_time;
 		return *this;
 	}
 };
 typedef std::shared_ptr<TrackingData> TrackingDataPtr;
 
+// the last tracked frame, written by the tracking thread and used by the feature thread to predict the pose of a 
+// new frame for the tracking by projection
+struct MotionPrior{
+  bool valid;
+  bool good_tracking;
+  int keyframe_id;  // the reference keyframe of the following frames
+  double timestamp;
+  Eigen::Matrix4d Twc;
+  // the previous tracked frame, for the constant velocity model
+  double last_timestamp;
+  Eigen::Matrix4d last_Twc;
+  // used once the imu is initialized
+  bool imu_init;
+  Eigen::Matrix4d Twb;
+  Eigen::Vector3d vwb;
+  Eigen::Vector3d gyr_bias;
+  Eigen::Vector3d acc_bias;
+
+  MotionPrior(): valid(false), good_tracking(false), keyframe_id(-1), timestamp(-1), last_timestamp(-1), imu_init(false) {}
+};
+
 class MapBuilder{
 public:
   MapBuilder(VisualOdometryConfigs& configs, ros::NodeHandle nh);
@@ -68,12 +107,22 @@ public:
   void AddInput(InputDataPtr data);
   void ExtractFeatureThread();
   void TrackingThread();
+  void LocalMappingThread();
 
   int TrackFrame(FramePtr ref_frame, FramePtr current_frame, std::vector<cv::DMatch>& matches, Preinteration& _preinteration);
 
   int FramePoseOptimization(FramePtr frame0, FramePtr frame, std::vector<MappointPtr>& mappoints, std::vector<int>& inliers, 
       Preinteration& preinteration);
   int AddKeyframeCheck(FramePtr ref_keyframe, FramePtr current_frame, const std::vector<cv::DMatch>&);
+  // match the mappoints of ref_keyframe to the frame around their projection with the predicted pose
+  int MatchByProjection(FramePtr ref_keyframe, FramePtr frame, std::vector<cv::DMatch>& matches);
+  // false if the tracking is lost or the tracking thread has not processed ref_keyframe_id yet
+  bool PredictPose(int ref_keyframe_id, double timestamp, Eigen::Matrix4d& Twc);
+  void UpdateMotionPrior(FramePtr frame, bool good_tracking);
+  // with _stereo_matcher if stereo_matcher is set, otherwise with the point matcher network
+  void MatchStereoFeatures(const FeatureSet& left_features, const FeatureSet& right_features, 
+      std::vector<cv::DMatch>& stereo_matches);
+  // the map mutex must be held by the caller
   void InsertKeyframe(FramePtr frame);
 
   void PublishFrame(FramePtr frame, cv::Mat& image, FrameType frame_type, std::vector<cv::DMatch>& matches);
@@ -84,22 +133,38 @@ public:
   void Stop();
   bool IsStopped();
 
+  // number of rectified image buffers allocated after the warm-up
+  size_t ImageAllocationCount();
+  // dropped frames and queue occupancy under the input policy
+  void PrintQueueStats();
+
 
 private:
   // left feature extraction and tracking thread
-  std::mutex _buffer_mutex;
-  std::queue<InputDataPtr> _data_buffer;
+  BoundedQueue<InputDataPtr> _data_buffer;
   std::thread _feature_thread;
 
   // pose estimation thread
-  std::mutex _tracking_mutex;
-  std::queue<TrackingDataPtr> _tracking_data_buffer;
+  BoundedQueue<TrackingDataPtr> _tracking_data_buffer;
   std::thread _tracking_thread;
 
+  // local mapping thread
+  BoundedQueue<FramePtr> _keyframe_buffer;
+  std::thread _local_mapping_thread;
+
   std::mutex _stop_mutex;
   bool _shutdown;
   bool _feature_thread_stop;
   bool _tracking_trhead_stop;
+  bool _local_mapping_thread_stop;
+
+  // set when a new keyframe arrives, used as the force stop flag of the local BA. It is written by the tracking 
+  // and the local mapping threads, so LocalmapOptimization copies it into the flag g2o reads
+  std::atomic<bool> _abort_local_mapping;
+
+  // frames dropped by the input policy
+  std::atomic<size_t> _dropped_input_frames;
+  std::atomic<size_t> _dropped_tracking_frames;
 
   // tmp 
   bool _init;
@@ -117,12 +182,29 @@ private:
 
   // for imu
   Preinteration _preinteration_keyframe;
+  // bias of the last keyframe optimized by the local mapping thread, protected by the map mutex. The preintegration 
+  // of the tracking thread starts from it, since the new keyframe is not optimized yet when it is inserted
+  Eigen::Vector3d _optimized_gyr_bias;
+  Eigen::Vector3d _optimized_acc_bias;
+
+  // for the tracking by projection
+  std::mutex _motion_prior_mutex;
+  MotionPrior _motion_prior;
+  ImuDataList _motion_imu_data;  // recent imu data, only used by the feature thread
+
+  // buffers of rectified images
+  ImagePoolPtr _image_pool;
+
+  // adapts the detection budget to the frame time, null if disabled
+  BudgetControllerPtr _budget_controller;
 
 private:
   // class
   VisualOdometryConfigs _configs;
   CameraPtr _camera;
   PointMatcherPtr _point_matcher;
+  // null if the stereo images are matched by _point_matcher
+  StereoMatcherPtr _stereo_matcher;
   FeatureDetectorPtr _feature_detector;
   RosPublisherPtr _ros_publisher;
   MapPtr _map;
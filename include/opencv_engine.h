@@ -0,0 +1,38 @@
+#ifndef OPENCV_ENGINE_H_
+#define OPENCV_ENGINE_H_
+
+#include <map>
+#include <opencv2/dnn.hpp>
+
+#include "inference_engine.h"
+
+// Runs the ONNX file on CPU with OpenCV DNN. The inputs are written to buffers owned by the engine, which OpenCV
+// copies to its input blobs. The outputs are headers of the output blobs of the network, which OpenCV allocates
+// again whenever an input shape changes.
+// cpu_threads is set by cv::setNumThreads, so it also applies to the other OpenCV parallel loops of the process.
+class OpenCVEngine : public InferenceEngine{
+public:
+  explicit OpenCVEngine(const InferenceEngineConfig& config);
+
+  bool Build() override;
+  float* Input(const std::string& name, const std::vector<int>& shape) override;
+  bool Run() override;
+  const float* Output(const std::string& name) override;
+  std::vector<int> OutputShape(const std::string& name) override;
+
+private:
+  int OutputIndex(const std::string& name) const;
+
+private:
+  InferenceEngineConfig _config;
+  cv::dnn::Net _net;
+
+  std::vector<std::string> _input_names;
+  std::map<std::string, std::vector<float>> _input_buffers;
+  std::map<std::string, std::vector<int>> _input_shapes;
+
+  std::vector<std::string> _output_names;
+  std::vector<cv::Mat> _outputs;
+};
+
+#endif  // OPENCV_ENGINE_H_
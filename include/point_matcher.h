@@ -8,19 +8,41 @@
 class PointMatcher{
 public:
   PointMatcher(const PointMatcherConfig& _config);
+  virtual ~PointMatcher() {}
 
-  void NormalizeKeypoints(const Eigen::Matrix<float, 259, Eigen::Dynamic> &features, 
-      Eigen::Matrix<float, 259, Eigen::Dynamic>& normalized_features, 
+  void NormalizeKeypoints(const Eigen::Matrix2Xf &keypoints, 
+      Eigen::Matrix2Xf& normalized_keypoints, 
       int width, int height, float scale);
 
-  int MatchingPoints(const Eigen::Matrix<float, 259, Eigen::Dynamic>& features0, 
-      const Eigen::Matrix<float, 259, Eigen::Dynamic>& features1, 
+  virtual int MatchingPoints(const FeatureSet& features0, 
+      const FeatureSet& features1, 
       std::vector<cv::DMatch>& matches,  bool outlier_rejection=false);
 
+  // the matches of features0 to every features1_list[i] as MatchingPoints gives them. With LightGlue and 
+  // max_batch_size > 1, the candidates with the same number of keypoints are matched in batched inferences, 
+  // the others one by one. Returns the number of all matches.
+  int MatchingPointsBatch(const FeatureSet& features0, 
+      const std::vector<const FeatureSet*>& features1_list, 
+      std::vector<std::vector<cv::DMatch>>& matches_list, bool outlier_rejection=false);
+
+protected:
+  // for derived matchers that do not run the networks, e.g. PointMatcherReplayer
+  PointMatcher();
+
+private:
+  void LightGlueMatches(const FeatureSet& features0, const FeatureSet& features1, 
+      const Eigen::Matrix<int, Eigen::Dynamic, 2>& matches_index, 
+      const Eigen::Matrix<float, Eigen::Dynamic, 1>& matches_score, std::vector<cv::DMatch>& matches);
+
+  // by the fundamental matrix with RANSAC
+  void RejectOutliers(const FeatureSet& features0, const FeatureSet& features1, std::vector<cv::DMatch>& matches);
+
 private:
   PointMatcherConfig _config;
   SuperPointLightGluePtr _lightglue;
   SuperGluePtr _superglue;
+  // cleared when the engine does not accept a batch, e.g. a model or an engine file without a dynamic batch axis
+  bool _batch_enabled;
 };
 
 
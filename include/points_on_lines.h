@@ -0,0 +1,90 @@
+#ifndef POINTS_ON_LINES_H_
+#define POINTS_ON_LINES_H_
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+// a keypoint near a line and its distance to the line in pixels
+struct PointOnLine{
+  int index;
+  float distance;
+};
+
+// The point-line relation of an image in the compressed sparse row form. The points on line i are
+// points[offsets[i], offsets[i+1]) sorted by the keypoint index, so the relation is two flat arrays instead of a
+// tree node for every point-line pair. operator[] returns a view of one line without copies.
+struct PointsOnLines{
+  // the points on one line, valid until the relation is modified
+  struct Span{
+    const PointOnLine* first;
+    const PointOnLine* last;
+
+    const PointOnLine* begin() const{
+      return first;
+    }
+
+    const PointOnLine* end() const{
+      return last;
+    }
+
+    size_t size() const{
+      return last - first;
+    }
+
+    bool empty() const{
+      return first == last;
+    }
+
+    const PointOnLine& operator[](size_t i) const{
+      return first[i];
+    }
+  };
+
+  // LineNum() + 1, or empty for no lines
+  std::vector<int> offsets;
+  std::vector<PointOnLine> points;
+
+  size_t LineNum() const{
+    return offsets.empty() ? 0 : offsets.size() - 1;
+  }
+
+  size_t PointNum() const{
+    return points.size();
+  }
+
+  Span operator[](size_t i) const{
+    const PointOnLine* data = points.data();
+    return Span{data + offsets[i], data + offsets[i + 1]};
+  }
+
+  void Clear(){
+    offsets.assign(1, 0);
+    points.clear();
+  }
+
+  // the relation is built line by line, AddPoint for the points of a line and then FinishLine
+  void AddPoint(int index, float distance){
+    points.push_back(PointOnLine{index, distance});
+  }
+
+  void FinishLine(){
+    if(offsets.empty()) offsets.push_back(0);
+    std::sort(points.begin() + offsets.back(), points.end(),
+        [](const PointOnLine& a, const PointOnLine& b){ return a.index < b.index; });
+    offsets.push_back(points.size());
+  }
+
+  // from the std::map form of the maps saved by older versions
+  void FromMaps(const std::vector<std::map<int, double>>& relation){
+    Clear();
+    for(const std::map<int, double>& points_on_line : relation){
+      for(auto& kv : points_on_line){
+        AddPoint(kv.first, kv.second);
+      }
+      FinishLine();
+    }
+  }
+};
+
+#endif  // POINTS_ON_LINES_H_
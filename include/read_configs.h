@@ -20,20 +20,45 @@ struct PLNetConfig{
   int max_keypoints;
   float keypoint_threshold;
   int remove_borders;
+  // radius of the non-maximum suppression of the keypoints, 0 to disable
+  int nms_radius;
 
   float line_threshold;
   float line_length_threshold;
 
-  PLNetConfig() {}
+  // detect the left and right images of a stereo pair at the same time with two network instances
+  int stereo_parallel;
+
+  // 0: TensorRT, 1: OpenCV DNN on CPU (InferenceBackend)
+  int backend;
+  // intra-op threads of the CPU backend, 0 for the OpenCV default. OpenCV DNN has no per-network setting, so this
+  // is cv::setNumThreads for the whole process and the engine built last decides it
+  int cpu_threads;
+
+  PLNetConfig(): nms_radius(0), stereo_parallel(0), backend(0), cpu_threads(0) {}
   void Load(const YAML::Node& plnet_node){
     use_superpoint = plnet_node["use_superpoint"].as<int>();
 
     max_keypoints = plnet_node["max_keypoints"].as<int>();
     keypoint_threshold = plnet_node["keypoint_threshold"].as<float>();
     remove_borders = plnet_node["remove_borders"].as<int>();
+    if(plnet_node["nms_radius"]){
+      nms_radius = plnet_node["nms_radius"].as<int>();
+    }
 
     line_threshold = plnet_node["line_threshold"].as<float>();
     line_length_threshold = plnet_node["line_length_threshold"].as<float>();
+
+    if(plnet_node["stereo_parallel"]){
+      stereo_parallel = plnet_node["stereo_parallel"].as<int>();
+    }
+
+    if(plnet_node["backend"]){
+      backend = plnet_node["backend"].as<int>();
+    }
+    if(plnet_node["cpu_threads"]){
+      cpu_threads = plnet_node["cpu_threads"].as<int>();
+    }
   }
 
   void SetModelPath(std::string model_dir){
@@ -52,11 +77,14 @@ struct PLNetConfig{
 
 
 struct SuperPointConfig {
-  SuperPointConfig() {}
+  SuperPointConfig(): nms_radius(0), backend(0), cpu_threads(0) {}
   void Load(const YAML::Node& superpoint_node){
     max_keypoints = superpoint_node["max_keypoints"].as<int>();
     keypoint_threshold = superpoint_node["keypoint_threshold"].as<float>();
     remove_borders = superpoint_node["remove_borders"].as<int>();
+    if(superpoint_node["nms_radius"]){
+      nms_radius = superpoint_node["nms_radius"].as<int>();
+    }
     dla_core = superpoint_node["dla_core"].as<int>();
     const YAML::Node superpoint_input_tensor_names_node = superpoint_node["input_tensor_names"];
     size_t superpoint_num_input_tensor_names = superpoint_input_tensor_names_node.size();
@@ -75,7 +103,11 @@ struct SuperPointConfig {
   int max_keypoints;
   float keypoint_threshold;
   int remove_borders;
+  // radius of the non-maximum suppression of the keypoints, 0 to disable
+  int nms_radius;
   int dla_core;
+  int backend;
+  int cpu_threads;
   std::vector<std::string> input_tensor_names;
   std::vector<std::string> output_tensor_names;
   std::string onnx_file;
@@ -83,19 +115,49 @@ struct SuperPointConfig {
 };
 
 struct PointMatcherConfig {
-  PointMatcherConfig() {}
+  PointMatcherConfig(): backend(0), cpu_threads(0), max_batch_size(1), stereo_matcher(0), stereo_min_score(0.6), 
+      stereo_ratio(0.9) {}
   void Load(const YAML::Node& point_matcher_node){
     matcher = point_matcher_node["matcher"].as<int>();
     image_width = point_matcher_node["image_width"].as<int>();
     image_height = point_matcher_node["image_height"].as<int>();
     onnx_file = point_matcher_node["onnx_file"].as<std::string>();
     engine_file = point_matcher_node["engine_file"].as<std::string>();
+    if(point_matcher_node["backend"]){
+      backend = point_matcher_node["backend"].as<int>();
+    }
+    if(point_matcher_node["cpu_threads"]){
+      cpu_threads = point_matcher_node["cpu_threads"].as<int>();
+    }
+    if(point_matcher_node["max_batch_size"]){
+      max_batch_size = point_matcher_node["max_batch_size"].as<int>();
+    }
+    if(point_matcher_node["stereo_matcher"]){
+      stereo_matcher = point_matcher_node["stereo_matcher"].as<int>();
+    }
+    if(point_matcher_node["stereo_min_score"]){
+      stereo_min_score = point_matcher_node["stereo_min_score"].as<float>();
+    }
+    if(point_matcher_node["stereo_ratio"]){
+      stereo_ratio = point_matcher_node["stereo_ratio"].as<float>();
+    }
   }
 
   int matcher;
   int image_width;
   int image_height;
   int dla_core;
+  // 0: TensorRT, 1: OpenCV DNN on CPU (InferenceBackend)
+  int backend;
+  // intra-op threads of the CPU backend, 0 for the OpenCV default
+  int cpu_threads;
+  // max pairs of one LightGlue inference in MatchingPointsBatch, > 1 needs a model with a dynamic batch axis
+  int max_batch_size;
+  // left-right matching, 0: the point matcher network, 1: StereoMatcher on the rectified images
+  int stereo_matcher;
+  // min descriptor similarity and max ratio of the best and the second best descriptor distance of StereoMatcher
+  float stereo_min_score;
+  float stereo_ratio;
   std::vector<std::string> input_tensor_names;
   std::vector<std::string> output_tensor_names;
   std::string onnx_file;
@@ -128,7 +190,7 @@ struct LineDetectorConfig{
 };
 
 struct KeyframeConfig {
-  KeyframeConfig() {}
+  KeyframeConfig(): descriptor_precision(0), projection_tracking(0), min_projection_match(60) {}
   void Load(const YAML::Node& keyframe_node){
     min_init_stereo_feature = keyframe_node["min_init_stereo_feature"].as<int>();
     lost_num_match = keyframe_node["lost_num_match"].as<int>();
@@ -136,6 +198,15 @@ struct KeyframeConfig {
     max_num_match = keyframe_node["max_num_match"].as<int>();
     tracking_point_rate = keyframe_node["tracking_point_rate"].as<float>();
     tracking_parallax_rate = keyframe_node["tracking_parallax_rate"].as<double>();
+    if(keyframe_node["descriptor_precision"]){
+      descriptor_precision = keyframe_node["descriptor_precision"].as<int>();
+    }
+    if(keyframe_node["projection_tracking"]){
+      projection_tracking = keyframe_node["projection_tracking"].as<int>();
+    }
+    if(keyframe_node["min_projection_match"]){
+      min_projection_match = keyframe_node["min_projection_match"].as<int>();
+    }
   }
 
   int min_init_stereo_feature;
@@ -144,6 +215,32 @@ struct KeyframeConfig {
   int max_num_match;
   float tracking_point_rate;
   double tracking_parallax_rate;
+  // descriptors of the keyframes that are no longer tracked, 0: float32, 1: float16, 2: int8
+  int descriptor_precision;
+  // match the frames to the reference keyframe by projecting its mappoints with the predicted pose, the point 
+  // matcher is only run when fewer than min_projection_match points are matched or a keyframe may be needed
+  int projection_tracking;
+  int min_projection_match;
+};
+
+// adapts the keypoint top-k and the minimal line length to hold the target frame time, the upper bound
+// of the keypoints and the lower bound of the line length are max_keypoints and line_length_threshold of plnet
+struct BudgetControllerConfig{
+  BudgetControllerConfig(): enable(0), target_frame_time(50), min_keypoints(150), max_line_length_threshold(100), 
+      min_track_inliers(50) {}
+  void Load(const YAML::Node& budget_node){
+    enable = budget_node["enable"].as<int>();
+    target_frame_time = budget_node["target_frame_time"].as<double>();
+    min_keypoints = budget_node["min_keypoints"].as<int>();
+    max_line_length_threshold = budget_node["max_line_length_threshold"].as<float>();
+    min_track_inliers = budget_node["min_track_inliers"].as<int>();
+  }
+
+  int enable;
+  double target_frame_time;  // ms
+  int min_keypoints;
+  float max_line_length_threshold;
+  int min_track_inliers;     // the budget is increased if fewer inliers are tracked
 };
 
 struct OptimizationConfig{
@@ -210,13 +307,23 @@ struct VisualOdometryConfigs{
   PointMatcherConfig point_matcher_config;
   LineDetectorConfig line_detector_config;
   KeyframeConfig keyframe_config;
+  BudgetControllerConfig budget_controller_config;
   OptimizationConfig tracking_optimization_config;
   OptimizationConfig backend_optimization_config;
   RosPublisherConfig ros_publisher_config;
 
-  VisualOdometryConfigs() {}
+  // 0: block when the pipeline is busy, 1: drop the oldest normal frames, 2: only process the latest frame
+  int input_policy;
+
+  // 0: run the networks, 1: run the networks and record their outputs to feature_log_path,
+  // 2: replay the outputs from feature_log_path without any network
+  int feature_log_mode;
+  std::string feature_log_path;
 
-  VisualOdometryConfigs(const std::string& config_file_, const std::string& model_dir_){
+  VisualOdometryConfigs() : input_policy(0), feature_log_mode(0) {}
+
+  VisualOdometryConfigs(const std::string& config_file_, const std::string& model_dir_) : 
+      input_policy(0), feature_log_mode(0){
     model_dir = model_dir_;
 
     std::cout << "config_file = " << config_file_ << std::endl;
@@ -234,9 +341,15 @@ struct VisualOdometryConfigs{
     point_matcher_config.engine_file = ConcatenateFolderAndFileName(model_dir, point_matcher_config.engine_file);
 
     keyframe_config.Load(file_node["keyframe"]);
+    if(file_node["budget_controller"]){
+      budget_controller_config.Load(file_node["budget_controller"]);
+    }
     tracking_optimization_config.Load(file_node["optimization"]["tracking"]);
     backend_optimization_config.Load(file_node["optimization"]["backend"]);
     ros_publisher_config.Load(file_node["ros_publisher"]);
+    if(file_node["input_policy"]){
+      input_policy = file_node["input_policy"].as<int>();
+    }
   }
 };
 
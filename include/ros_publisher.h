@@ -37,7 +37,7 @@ struct FeatureMessgae{
   std::vector<cv::KeyPoint> keypoints;
   std::vector<Eigen::Vector4d> lines;
   std::vector<int> line_track_ids;
-  std::vector<std::map<int, double>> points_on_lines;
+  PointsOnLines points_on_lines;
   std::vector<cv::DMatch> matches;
   FeatureMessgaeType fm_type;
 };
@@ -0,0 +1,41 @@
+#ifndef STEREO_MATCHER_H_
+#define STEREO_MATCHER_H_
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "camera.h"
+#include "feature_set.h"
+#include "read_configs.h"
+
+// Matches the keypoints of rectified stereo images without a network. The right keypoints are bucketed by row
+// and sorted by x in each row, so every left keypoint only compares the descriptors of the right keypoints in its
+// y-band (MaxYDiff) and disparity window (MinXDiff, MaxXDiff). A match must be the mutual best, pass the ratio
+// test and have a descriptor similarity of at least stereo_min_score.
+class StereoMatcher{
+public:
+  StereoMatcher(const PointMatcherConfig& config, CameraPtr camera);
+
+  // queryIdx is the index of the left feature and trainIdx the index of the right feature
+  int MatchingPoints(const FeatureSet& left_features, const FeatureSet& right_features, std::vector<cv::DMatch>& matches);
+
+private:
+  void BuildRowIndex(const Eigen::Matrix2Xf& keypoints);
+
+private:
+  float _min_score;
+  float _ratio;
+  CameraPtr _camera;
+
+  // right keypoints of each row: _row_indexes[_row_starts[r], _row_starts[r+1]) sorted by x
+  std::vector<int> _row_starts;
+  std::vector<int> _row_indexes;
+  std::vector<float> _row_xs;
+
+  FeatureSet::Descriptors _left_descriptors;
+  FeatureSet::Descriptors _right_descriptors;
+};
+
+typedef std::shared_ptr<StereoMatcher> StereoMatcherPtr;
+
+#endif  // STEREO_MATCHER_H_
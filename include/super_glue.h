@@ -7,15 +7,13 @@
 
 #include <string>
 #include <memory>
-#include <NvInfer.h>
 #include <Eigen/Core>
-#include <NvOnnxParser.h>
 #include <opencv2/opencv.hpp>
 
-#include "3rdparty/tensorrtbuffer/include/buffers.h"
+#include "inference_engine.h"
 #include "read_configs.h"
-
-using tensorrt_buffer::TensorRTUniquePtr;
+#include "feature_set.h"
+#include "log_optimal_transport.h"
 
 class SuperGlue {
 public:
@@ -25,46 +23,35 @@ public:
 
     bool build();
 
-    bool infer(const Eigen::Matrix<float, 259, Eigen::Dynamic> &features0,
-               const Eigen::Matrix<float, 259, Eigen::Dynamic> &features1,
+    // keypoints are the normalized keypoints of features, which provide the scores and descriptors
+    bool infer(const Eigen::Matrix2Xf &keypoints0,
+               const FeatureSet &features0,
+               const Eigen::Matrix2Xf &keypoints1,
+               const FeatureSet &features1,
                Eigen::VectorXi &indices0,
                Eigen::VectorXi &indices1,
                Eigen::VectorXd &mscores0,
                Eigen::VectorXd &mscores1);
 
-    void save_engine();
-
-    bool deserialize_engine();
-
 private:
     PointMatcherConfig superglue_config_;
     std::vector<int> indices0_;
     std::vector<int> indices1_;
     std::vector<float> mscores0_;
     std::vector<float> mscores1_;
+    int keypoints_0_num_;
+    int keypoints_1_num_;
+    LogOptimalTransport optimal_transport_;
+    std::vector<float> assignment_;
 
-    nvinfer1::Dims keypoints_0_dims_{};
-    nvinfer1::Dims scores_0_dims_{};
-    nvinfer1::Dims descriptors_0_dims_{};
-    nvinfer1::Dims keypoints_1_dims_{};
-    nvinfer1::Dims scores_1_dims_{};
-    nvinfer1::Dims descriptors_1_dims_{};
-    nvinfer1::Dims output_scores_dims_{};
-
-    std::shared_ptr<nvinfer1::ICudaEngine> engine_;
-    std::shared_ptr<nvinfer1::IExecutionContext> context_;
-
-    bool construct_network(TensorRTUniquePtr<nvinfer1::IBuilder> &builder,
-                           TensorRTUniquePtr<nvinfer1::INetworkDefinition> &network,
-                           TensorRTUniquePtr<nvinfer1::IBuilderConfig> &config,
-                           TensorRTUniquePtr<nvonnxparser::IParser> &parser) const;
+    InferenceEnginePtr engine_;
 
-    bool process_input(const tensorrt_buffer::BufferManager &buffers,
-                       const Eigen::Matrix<float, 259, Eigen::Dynamic> &features0,
-                       const Eigen::Matrix<float, 259, Eigen::Dynamic> &features1);
+    bool process_input(const Eigen::Matrix2Xf &keypoints0,
+                       const FeatureSet &features0,
+                       const Eigen::Matrix2Xf &keypoints1,
+                       const FeatureSet &features1);
 
-    bool process_output(const tensorrt_buffer::BufferManager &buffers,
-                        Eigen::VectorXi &indices0,
+    bool process_output(Eigen::VectorXi &indices0,
                         Eigen::VectorXi &indices1,
                         Eigen::VectorXd &mscores0,
                         Eigen::VectorXd &mscores1);
@@ -8,14 +8,11 @@
 #include <string>
 #include <memory>
 #include <Eigen/Core>
-#include <NvInfer.h>
-#include <NvOnnxParser.h>
 #include <opencv2/opencv.hpp>
 
-#include "3rdparty/tensorrtbuffer/include/buffers.h"
+#include "inference_engine.h"
 #include "read_configs.h"
-
-using tensorrt_buffer::TensorRTUniquePtr;
+#include "keypoint_decoder.h"
 
 class SuperPoint {
 public:
@@ -23,11 +20,10 @@ public:
 
     bool build();
 
-    bool infer(const cv::Mat &image, Eigen::Matrix<float, 259, Eigen::Dynamic> &features);
-
-    void save_engine();
+    bool infer(const cv::Mat &image, FeatureSet &features);
 
-    bool deserialize_engine();
+    // top-k of the keypoint decoder, can be changed between two infer calls
+    void set_max_keypoints(int max_keypoints);
 
 private:
     int input_width;
@@ -38,30 +34,14 @@ private:
     float h_scale; 
 
     SuperPointConfig super_point_config_;
-    nvinfer1::Dims input_dims_{};
-    nvinfer1::Dims semi_dims_{};
-    nvinfer1::Dims desc_dims_{};
-    std::shared_ptr<nvinfer1::ICudaEngine> engine_;
-    std::shared_ptr<nvinfer1::IExecutionContext> context_;
-    std::vector<std::vector<int>> keypoints_;
-    std::vector<std::vector<float>> descriptors_;
-
-    bool construct_network(TensorRTUniquePtr<nvinfer1::IBuilder> &builder,
-                           TensorRTUniquePtr<nvinfer1::INetworkDefinition> &network,
-                           TensorRTUniquePtr<nvinfer1::IBuilderConfig> &config,
-                           TensorRTUniquePtr<nvonnxparser::IParser> &parser) const;
-
-    bool process_input(const tensorrt_buffer::BufferManager &buffers, const cv::Mat &image);
-
-    bool process_output(const tensorrt_buffer::BufferManager &buffers, Eigen::Matrix<float, 259, Eigen::Dynamic> &features);
+    InferenceEnginePtr engine_;
+    KeypointDecoder<> keypoint_decoder_;
 
-    bool keypoints_decoder(const float* scores, const float* descriptors, Eigen::Matrix<float, 259, Eigen::Dynamic> &features);
+    bool process_input(const cv::Mat &image);
 
-    std::vector<size_t> sort_indexes(std::vector<float> &data);
-    int clip(int val, int max);
+    bool process_output(FeatureSet &features);
 
-    void detect_point(const float* heat_map, Eigen::Matrix<float, 259, Eigen::Dynamic>& features, int h, int w, float threshold, int border, int top_k);
-    void extract_descriptors(const float *descriptors, Eigen::Matrix<float, 259, Eigen::Dynamic> &features, int h, int w, int s);
+    bool keypoints_decoder(const float* scores, const float* descriptors, FeatureSet &features);
 };
 
 typedef std::shared_ptr<SuperPoint> SuperPointPtr;
@@ -0,0 +1,39 @@
+#ifndef TENSORRT_ENGINE_H_
+#define TENSORRT_ENGINE_H_
+
+#include <NvInfer.h>
+#include <NvOnnxParser.h>
+
+#include "3rdparty/tensorrtbuffer/include/buffers.h"
+#include "inference_engine.h"
+
+// Builds the engine from the ONNX file, or deserializes it from engine_file if the file exists and its profile
+// covers the input profiles of the config, e.g. an engine file built for a smaller batch size is rebuilt.
+// Each binding has a pair of host and device buffers that only grow.
+class TensorRTEngine : public InferenceEngine{
+public:
+  explicit TensorRTEngine(const InferenceEngineConfig& config);
+
+  bool Build() override;
+  float* Input(const std::string& name, const std::vector<int>& shape) override;
+  bool Run() override;
+  const float* Output(const std::string& name) override;
+  std::vector<int> OutputShape(const std::string& name) override;
+
+private:
+  bool Deserialize();
+  bool ProfileCoversInputs();
+  bool BuildFromOnnx();
+  void SaveEngine();
+  bool CreateContext();
+
+private:
+  InferenceEngineConfig _config;
+  std::shared_ptr<nvinfer1::ICudaEngine> _engine;
+  std::shared_ptr<nvinfer1::IExecutionContext> _context;
+
+  std::vector<std::unique_ptr<tensorrt_buffer::ManagedBuffer>> _buffers;
+  std::vector<void*> _device_bindings;
+};
+
+#endif  // TENSORRT_ENGINE_H_
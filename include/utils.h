@@ -33,6 +33,9 @@
 #include <g2o/types/slam3d/types_slam3d.h>
 #include <g2o/types/slam3d_addons/types_slam3d_addons.h>
 
+#include "feature_set.h"
+#include "points_on_lines.h"
+
 typedef std::shared_ptr<g2o::Line3D> Line3DPtr;
 typedef std::shared_ptr<const g2o::Line3D> ConstLine3DPtr;
 
@@ -56,7 +59,9 @@ using AlignedMap =
 
 
 void ConvertVectorToRt(Eigen::Matrix<double, 7, 1>& m, Eigen::Matrix3d& R, Eigen::Vector3d& t);
-float DescriptorDistance(const Eigen::Matrix<float, 256, 1>& f1, const Eigen::Matrix<float, 256, 1>& f2);
+// takes the descriptor columns of a FeatureSet without copies
+float DescriptorDistance(const Eigen::Ref<const Eigen::Matrix<float, 256, 1>>& f1, 
+    const Eigen::Ref<const Eigen::Matrix<float, 256, 1>>& f2);
 std::string DoubleTimeToString(double timestamp_seconds);
 double StringTimeToDouble(std::string time_str);
 double ImageNameToTime(const std::string& image_name);
@@ -69,7 +74,7 @@ cv::Mat DrawFeatures(const cv::Mat& image, const std::vector<cv::KeyPoint>& keyp
     const std::vector<Eigen::Vector4d>& lines, bool draw_on_one);
 cv::Mat DrawFeatures(const cv::Mat& image, const std::vector<cv::KeyPoint>& keypoints, 
     const std::vector<bool>& inliers, const std::vector<Eigen::Vector4d>& lines, 
-    const std::vector<int>& line_track_ids, const std::vector<std::map<int, double>>& points_on_lines);
+    const std::vector<int>& line_track_ids, const PointsOnLines& points_on_lines);
 cv::Mat DrawMatches(const cv::Mat& ref_image, const cv::Mat& image, const std::vector<cv::KeyPoint>& ref_kpts, 
     const std::vector<cv::KeyPoint>& kpts, const std::vector<cv::DMatch>& matches);
 
@@ -202,23 +207,89 @@ void SerializeEigenVector4dList(Archive &ar, std::vector<Eigen::Vector4d> &v, co
   }
 }
 
+// stored in the packed form, so the maps saved before the features were split can still be loaded. From version 1,
+// the descriptor precision comes first and compressed features are stored as arrays with the compact descriptors.
 template<class Archive>
-void SerializeFeatures(Archive& ar, Eigen::Matrix<float, 259, Eigen::Dynamic>& features, const unsigned int version){
+void SerializeFeatures(Archive& ar, FeatureSet& features, const unsigned int version){
+  int precision = features.compact_descriptors.precision;
+  if(version > 0){
+    ar & precision;
+  }
+
+  if(precision != Float32Descriptor){
+    CompactDescriptors<256>& compact_descriptors = features.compact_descriptors;
+    int size = features.Size();
+    ar & size;
+    if(Archive::is_loading::value){
+      features.scores.resize(1, size);
+      features.keypoints.resize(2, size);
+      features.descriptors.resize(256, 0);
+      compact_descriptors.Clear();
+      compact_descriptors.precision = precision;
+      compact_descriptors.size = size;
+      if(precision == Float16Descriptor){
+        compact_descriptors.half_values.resize((size_t)size * 256);
+      }else{
+        compact_descriptors.int8_values.resize((size_t)size * 256);
+        compact_descriptors.scales.resize(size);
+      }
+    }
+    ar & boost::serialization::make_array(features.scores.data(), features.scores.size());
+    ar & boost::serialization::make_array(features.keypoints.data(), features.keypoints.size());
+    if(precision == Float16Descriptor){
+      // half is the 2 bytes of its IEEE representation
+      ar & boost::serialization::make_array(reinterpret_cast<uint16_t*>(compact_descriptors.half_values.data()), 
+          compact_descriptors.half_values.size());
+    }else{
+      ar & boost::serialization::make_array(compact_descriptors.int8_values.data(), compact_descriptors.int8_values.size());
+      ar & boost::serialization::make_array(compact_descriptors.scales.data(), compact_descriptors.scales.size());
+    }
+    return;
+  }
+
   int cols, rows;
+  FeatureSet::PackedFeatures packed;
 
   if (Archive::is_saving::value) {
-    cols = features.cols(); 
-    rows = features.rows();
+    features.ToPacked(packed);
+    cols = packed.cols(); 
+    rows = packed.rows();
   }
 
   ar & cols;
   ar & rows;
 
   if(Archive::is_loading::value){
-    features.resize(rows, cols);
+    packed.resize(rows, cols);
+  }
+
+  ar & boost::serialization::make_array(packed.data(), packed.size());
+
+  if(Archive::is_loading::value){
+    features.FromPacked(packed);
   }
+}
 
-  ar & boost::serialization::make_array(features.data(), features.size());
+// the relation of maps saved before version 2 is a std::vector<std::map<int, double>>
+template<class Archive>
+void SerializePointsOnLines(Archive& ar, PointsOnLines& points_on_lines, const unsigned int version){
+  if(version < 2){
+    std::vector<std::map<int, double>> relation;
+    ar & relation;
+    points_on_lines.FromMaps(relation);
+    return;
+  }
+
+  int point_num = points_on_lines.PointNum();
+  ar & points_on_lines.offsets;
+  ar & point_num;
+  if(Archive::is_loading::value){
+    points_on_lines.points.resize(point_num);
+  }
+  for(PointOnLine& point : points_on_lines.points){
+    ar & point.index;
+    ar & point.distance;
+  }
 }
 
 template<class Archive>
@@ -32,33 +32,38 @@ void Database::LoadVocabulary(SuperpointVocabularyPtr voc){
 }
 
 void Database::FrameToBow(FramePtr frame, DBoW2::WordIdToFeatures& word_features, DBoW2::BowVector& bow_vector){
-  const Eigen::Matrix<float, 259, Eigen::Dynamic>& features_eigen = frame->GetAllFeatures();
+  const FeatureSet& features_eigen = frame->GetAllFeatures();
   FrameToBow(features_eigen, word_features, bow_vector);
 }
 
-void Database::FrameToBow(const Eigen::Matrix<float, 259, Eigen::Dynamic>& features_eigen, 
+void Database::FrameToBow(const FeatureSet& features_eigen, 
     DBoW2::WordIdToFeatures& word_features, DBoW2::BowVector& bow_vector){
-  int N = features_eigen.cols();
+  int N = features_eigen.Size();
+  FeatureSet::Descriptors buffer;
+  const FeatureSet::Descriptors& descriptors = features_eigen.DecodedDescriptors(buffer);
   std::vector<Eigen::Matrix<float, 256, 1>> features;
   features.reserve(N);
   for(int i = 0; i < N; i++){
-    features.emplace_back(features_eigen.block(3, i, 256, 1));
+    features.emplace_back(descriptors.col(i));
   }
   _voc->transform(features, bow_vector, word_features);
 }
 
 void Database::FrameToBow(FramePtr frame, DBoW2::WordIdToFeatures& word_features, DBoW2::BowVector& bow_vector, 
     std::vector<DBoW2::WordId>& word_of_features){
-  const Eigen::Matrix<float, 259, Eigen::Dynamic>& features_eigen = frame->GetAllFeatures();
+  const FeatureSet& features_eigen = frame->GetAllFeatures();
   FrameToBow(features_eigen, word_features, bow_vector, word_of_features);
 }
 
 
-void Database::FrameToBow(const Eigen::Matrix<float, 259, Eigen::Dynamic>& features_eigen, 
+void Database::FrameToBow(const FeatureSet& features_eigen, 
     DBoW2::WordIdToFeatures& word_features, DBoW2::BowVector& bow_vector, std::vector<DBoW2::WordId>& word_of_features){
-  int N = features_eigen.cols();
+  int N = features_eigen.Size();
   if(N == 0) return; 
 
+  FeatureSet::Descriptors buffer;
+  const FeatureSet::Descriptors& descriptors = features_eigen.DecodedDescriptors(buffer);
+
   // normalize 
   DBoW2::LNorm norm;
   bool must = _voc->m_scoring_object->mustNormalize(norm);
@@ -66,7 +71,7 @@ void Database::FrameToBow(const Eigen::Matrix<float, 259, Eigen::Dynamic>& featu
     DBoW2::WordId id;
     DBoW2::WordValue w; // w is the idf value if TF_IDF, 1 if TF
 
-    _voc->transform(features_eigen.block(3, i, 256, 1), id, w);
+    _voc->transform(descriptors.col(i), id, w);
     if(w > 0){
       bow_vector.addWeight(id, w);
       word_features[id].emplace_back(i);
@@ -0,0 +1,84 @@
+#include "budget_controller.h"
+
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// weight of the newest frame time in the smoothed frame time
+const double SmoothingRate = 0.2;
+// the budget is restored only below (1 - Hysteresis) * target_frame_time
+const double Hysteresis = 0.15;
+// frames to wait after a change, so its effect is seen before the next one
+const int CooldownFrames = 5;
+// relative change of the keypoint budget per decision
+const double KeypointStep = 0.1;
+// change of the minimal line length per decision, in pixels
+const float LineLengthStep = 5;
+
+}  // namespace
+
+BudgetController::BudgetController(const BudgetControllerConfig& config, const PLNetConfig& plnet_config,
+    const std::string& log_path) : _config(config), _smoothed_frame_time(-1), _frames_since_change(0){
+  _max_keypoints_upper = plnet_config.max_keypoints;
+  _line_length_threshold_lower = plnet_config.line_length_threshold;
+  _config.min_keypoints = std::min(_config.min_keypoints, _max_keypoints_upper);
+  _config.max_line_length_threshold = std::max(_config.max_line_length_threshold, _line_length_threshold_lower);
+
+  _max_keypoints = _max_keypoints_upper;
+  _line_length_threshold = _line_length_threshold_lower;
+
+  _log.open(log_path);
+  if(!_log.is_open()){
+    std::cout << "Can not open " << log_path << std::endl;
+  }else{
+    _log << "frame_id,feature_time_ms,tracking_time_ms,smoothed_frame_time_ms,track_inliers,max_keypoints,"
+         << "line_length_threshold,decision\n";
+  }
+}
+
+BudgetController::~BudgetController(){
+  if(_log.is_open()) _log.close();
+}
+
+void BudgetController::Update(int frame_id, double feature_time, double tracking_time, int track_inliers){
+  std::lock_guard<std::mutex> lock(_mutex);
+  double frame_time = std::max(feature_time, tracking_time);
+  _smoothed_frame_time = (_smoothed_frame_time < 0) ? frame_time :
+      (SmoothingRate * frame_time + (1 - SmoothingRate) * _smoothed_frame_time);
+  _frames_since_change++;
+
+  bool over_budget = _smoothed_frame_time > _config.target_frame_time;
+  bool under_budget = _smoothed_frame_time < (1 - Hysteresis) * _config.target_frame_time;
+  bool weak_tracking = track_inliers < _config.min_track_inliers;
+  int step = std::max(1, (int)std::round(KeypointStep * _max_keypoints_upper));
+
+  std::string decision = "keep";
+  if(_frames_since_change >= CooldownFrames){
+    if((weak_tracking || under_budget) &&
+        (_max_keypoints < _max_keypoints_upper || _line_length_threshold > _line_length_threshold_lower)){
+      // tracking quality comes first, restore the budget even if the frame time is over the target
+      _max_keypoints = std::min(_max_keypoints + step, _max_keypoints_upper);
+      _line_length_threshold = std::max(_line_length_threshold - LineLengthStep, _line_length_threshold_lower);
+      decision = weak_tracking ? "increase_weak_tracking" : "increase_under_budget";
+    }else if(over_budget && !weak_tracking &&
+        (_max_keypoints > _config.min_keypoints || _line_length_threshold < _config.max_line_length_threshold)){
+      _max_keypoints = std::max(_max_keypoints - step, _config.min_keypoints);
+      _line_length_threshold = std::min(_line_length_threshold + LineLengthStep, _config.max_line_length_threshold);
+      decision = "decrease_over_budget";
+    }
+    if(decision != "keep") _frames_since_change = 0;
+  }
+
+  if(_log.is_open()){
+    _log << frame_id << "," << feature_time << "," << tracking_time << "," << _smoothed_frame_time << ","
+         << track_inliers << "," << _max_keypoints << "," << _line_length_threshold << "," << decision << "\n";
+  }
+}
+
+void BudgetController::GetBudget(int& max_keypoints, float& line_length_threshold){
+  std::lock_guard<std::mutex> lock(_mutex);
+  max_keypoints = _max_keypoints;
+  line_length_threshold = _line_length_threshold;
+}
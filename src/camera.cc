@@ -1,4 +1,5 @@
 #include <cmath>
+#include <algorithm>
 #include <yaml-cpp/yaml.h>
 #include <Eigen/Core>
 #include <opencv2/core/eigen.hpp>
@@ -61,17 +62,17 @@ Camera::Camera(const std::string& camera_file){
                         cv::CALIB_ZERO_DISPARITY, 0, image_size);
 
       cv::initUndistortRectifyMap(K0, D0, R0, P0.rowRange(0,3).colRange(0,3), 
-          image_size, CV_32F, _mapl1, _mapl2);
+          image_size, CV_16SC2, _mapl1, _mapl2);
       cv::initUndistortRectifyMap(K1, D1, R1, P1.rowRange(0,3).colRange(0,3),
-          image_size, CV_32F, _mapr1, _mapr2);
+          image_size, CV_16SC2, _mapr1, _mapr2);
     }else{
       cv::fisheye::stereoRectify(K0, D0.rowRange(0,4), K1, D1.rowRange(0,4), image_size, R10, t10, R0, R1, P0, P1, Q,
                                  cv::CALIB_ZERO_DISPARITY, image_size, 0, 0.8);
 
       cv::fisheye::initUndistortRectifyMap(K0, D0.rowRange(0,4), R0, P0.rowRange(0,3).colRange(0,3), 
-          image_size, CV_32F, _mapl1, _mapl2);
+          image_size, CV_16SC2, _mapl1, _mapl2);
       cv::fisheye::initUndistortRectifyMap(K1, D1.rowRange(0,4), R1, P1.rowRange(0,3).colRange(0,3),
-          image_size, CV_32F, _mapr1, _mapr2);
+          image_size, CV_16SC2, _mapr1, _mapr2);
     }
 
     _bf = std::abs(P1.at<double>(0, 3));
@@ -168,16 +169,46 @@ void Camera::UndistortImage(cv::Mat& image_left, cv::Mat& image_left_rect){
 
 void Camera::UndistortImage(
     cv::Mat& image_left, cv::Mat& image_right, cv::Mat& image_left_rect, cv::Mat& image_right_rect){
-  if(!_mapl1.empty() && !_mapl2.empty()){
-    cv::remap(image_left, image_left_rect, _mapl1, _mapl2, cv::INTER_LINEAR);
-  }else{
-    image_left_rect = image_left;
-  }
+  bool remap_left = !_mapl1.empty() && !_mapl2.empty();
+  bool remap_right = !_mapr1.empty() && !_mapr2.empty();
+  if(!remap_left) image_left_rect = image_left;
+  if(!remap_right) image_right_rect = image_right;
+  if(!remap_left && !remap_right) return;
+
+  // remap both images in one parallel loop over row stripes, so the left and the right image
+  // are rectified at the same time and each stripe only touches a part of the maps
+  const int min_stripe_rows = 32;
+  int stripe_num = std::max(1, std::min(cv::getNumThreads(), _image_height / min_stripe_rows));
+  if(remap_left) image_left_rect.create(_mapl1.size(), image_left.type());
+  if(remap_right) image_right_rect.create(_mapr1.size(), image_right.type());
+
+  cv::parallel_for_(cv::Range(0, 2 * stripe_num), [&](const cv::Range& range){
+    for(int i = range.start; i < range.end; i++){
+      bool left = (i < stripe_num);
+      if((left && !remap_left) || (!left && !remap_right)) continue;
+      const cv::Mat& map1 = left ? _mapl1 : _mapr1;
+      const cv::Mat& map2 = left ? _mapl2 : _mapr2;
+      int stripe = left ? i : (i - stripe_num);
+      cv::Range rows(map1.rows * stripe / stripe_num, map1.rows * (stripe + 1) / stripe_num);
+
+      cv::Mat dst = left ? image_left_rect.rowRange(rows) : image_right_rect.rowRange(rows);
+      cv::remap(left ? image_left : image_right, dst, map1.rowRange(rows), map2.rowRange(rows), cv::INTER_LINEAR);
+    }
+  });
+}
 
-  if(!_mapr1.empty() && !_mapr2.empty()){
-    cv::remap(image_right, image_right_rect, _mapr1, _mapr2, cv::INTER_LINEAR);
-  }else{
-    image_right_rect = image_right;
+void Camera::ConvertMapsToFixedPoint(){
+  if(!_mapl1.empty() && _mapl1.type() == CV_32FC1){
+    cv::Mat map1, map2;
+    cv::convertMaps(_mapl1, _mapl2, map1, map2, CV_16SC2);
+    _mapl1 = map1;
+    _mapl2 = map2;
+  }
+  if(!_mapr1.empty() && _mapr1.type() == CV_32FC1){
+    cv::Mat map1, map2;
+    cv::convertMaps(_mapr1, _mapr2, map1, map2, CV_16SC2);
+    _mapr1 = map1;
+    _mapr2 = map2;
   }
 }
 
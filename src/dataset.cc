@@ -6,7 +6,8 @@
 #include "utils.h"
 #include "imu.h"
 
-Dataset::Dataset(const std::string& dataroot, const bool use_imu): _use_imu(use_imu){
+Dataset::Dataset(const std::string& dataroot, const bool use_imu): _use_imu(use_imu), 
+    _next_load_idx(0), _next_read_idx(0), _stop_prefetch(false){
   if(!PathExists(dataroot)){
     std::cout << "dataroot : " << dataroot << " doesn't exist" << std::endl;
     exit(0);
@@ -62,6 +63,10 @@ Dataset::Dataset(const std::string& dataroot, const bool use_imu): _use_imu(use_
   }
 }
 
+Dataset::~Dataset(){
+  StopPrefetch();
+}
+
 void Dataset::ReadImuData(const std::string& imu_file_path, ImuDataList& all_imu_data){
   if(!FileExists(imu_file_path)){
     std::cout << "imu file : " << imu_file_path << " doesn't exist" << std::endl;
@@ -93,4 +98,96 @@ bool Dataset::GetData(size_t idx, cv::Mat& left_image, cv::Mat& right_image, Imu
     std::copy(_imu_data[idx].begin(), _imu_data[idx].end(), std::back_inserter(batch_imu_data));
   }
   return true;
-}
\ No newline at end of file
+}
+
+void Dataset::StartPrefetch(int thread_num, size_t buffer_size){
+  StopPrefetch();
+  if(thread_num < 1 || buffer_size < 1) return;
+
+  _prefetch_slots.clear();
+  _prefetch_slots.resize(buffer_size);
+  for(PrefetchSlot& slot : _prefetch_slots){
+    slot.ready = false;
+  }
+  _next_load_idx = _next_read_idx;
+  _stop_prefetch = false;
+  for(int i = 0; i < thread_num; i++){
+    _prefetch_threads.emplace_back(&Dataset::PrefetchThread, this);
+  }
+}
+
+void Dataset::StopPrefetch(){
+  {
+    std::unique_lock<std::mutex> locker(_prefetch_mutex);
+    _stop_prefetch = true;
+  }
+  _slot_free.notify_all();
+  _slot_ready.notify_all();
+  for(std::thread& thread : _prefetch_threads){
+    thread.join();
+  }
+  _prefetch_threads.clear();
+  _prefetch_slots.clear();
+}
+
+void Dataset::PrefetchThread(){
+  size_t dataset_length = GetDatasetLength();
+  size_t buffer_size = _prefetch_slots.size();
+  while(true){
+    size_t idx;
+    {
+      std::unique_lock<std::mutex> locker(_prefetch_mutex);
+      _slot_free.wait(locker, [&]{ 
+        return _stop_prefetch || _next_load_idx >= dataset_length || _next_load_idx < _next_read_idx + buffer_size; });
+      if(_stop_prefetch || _next_load_idx >= dataset_length) return;
+      idx = _next_load_idx++;
+    }
+
+    // decode without holding the lock
+    PrefetchSlot loaded;
+    loaded.idx = idx;
+    loaded.good = GetData(idx, loaded.left_image, loaded.right_image, loaded.batch_imu_data, loaded.timestamp);
+
+    {
+      std::unique_lock<std::mutex> locker(_prefetch_mutex);
+      PrefetchSlot& slot = _prefetch_slots[idx % buffer_size];
+      slot = std::move(loaded);
+      slot.ready = true;
+    }
+    _slot_ready.notify_all();
+  }
+}
+
+bool Dataset::GetNextData(size_t& idx, cv::Mat& left_image, cv::Mat& right_image, ImuDataList& batch_imu_data, double& timestamp){
+  size_t dataset_length = GetDatasetLength();
+  if(_prefetch_threads.empty()){
+    while(_next_read_idx < dataset_length){
+      idx = _next_read_idx++;
+      if(GetData(idx, left_image, right_image, batch_imu_data, timestamp)) return true;
+    }
+    return false;
+  }
+
+  size_t buffer_size = _prefetch_slots.size();
+  std::unique_lock<std::mutex> locker(_prefetch_mutex);
+  while(_next_read_idx < dataset_length){
+    PrefetchSlot& slot = _prefetch_slots[_next_read_idx % buffer_size];
+    _slot_ready.wait(locker, [&]{ return _stop_prefetch || (slot.ready && slot.idx == _next_read_idx); });
+    if(_stop_prefetch) return false;
+
+    idx = _next_read_idx++;
+    bool good = slot.good;
+    if(good){
+      left_image = slot.left_image;
+      right_image = slot.right_image;
+      batch_imu_data.swap(slot.batch_imu_data);
+      timestamp = slot.timestamp;
+    }
+    slot.ready = false;
+    slot.left_image.release();
+    slot.right_image.release();
+    _slot_free.notify_all();
+    if(good) return true;
+  }
+  return false;
+}
@@ -14,12 +14,12 @@
 #include "bow/database.h"
 
 void SaveDetectorResult(
-    cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dynamic>& features, std::string save_root, std::string idx){
+    cv::Mat& image, FeatureSet& features, std::string save_root, std::string idx){
   cv::Mat img_color;
   cv::cvtColor(image, img_color, cv::COLOR_GRAY2RGB);
-  for(size_t j = 0; j < features.cols(); j++){
-    double x = features(1, j);
-    double y = features(2, j);
+  for(size_t j = 0; j < features.Size(); j++){
+    double x = features.keypoints(0, j);
+    double y = features.keypoints(1, j);
     cv::circle(img_color, cv::Point(x, y), 2, cv::Scalar(0, 255, 0), 2, cv::LINE_AA);
   }
 
@@ -40,19 +40,19 @@ void SaveMatchingResult(
   cv::imwrite(save_path, save_image);
 }
 
-void SaveStereoMatchResult(cv::Mat& image_left, cv::Mat& image_right, Eigen::Matrix<float, 259, Eigen::Dynamic>& features_left, 
-    Eigen::Matrix<float, 259, Eigen::Dynamic>&features_right, std::vector<cv::DMatch>& stereo_matches, std::string stereo_save_root, int frame_id){
+void SaveStereoMatchResult(cv::Mat& image_left, cv::Mat& image_right, FeatureSet& features_left, 
+    FeatureSet&features_right, std::vector<cv::DMatch>& stereo_matches, std::string stereo_save_root, int frame_id){
    std::vector<cv::KeyPoint> left_keypoints, right_keypoints;
-  for(size_t i = 0; i < features_left.cols(); ++i){
-    double score = features_left(0, i);
-    double x = features_left(1, i);
-    double y = features_left(2, i);
+  for(size_t i = 0; i < features_left.Size(); ++i){
+    double score = features_left.scores(i);
+    double x = features_left.keypoints(0, i);
+    double y = features_left.keypoints(1, i);
     left_keypoints.emplace_back(x, y, 8, -1, score);
   }
-  for(size_t i = 0; i < features_right.cols(); ++i){
-    double score = features_right(0, i);
-    double x = features_right(1, i);
-    double y = features_right(2, i);
+  for(size_t i = 0; i < features_right.Size(); ++i){
+    double score = features_right.scores(i);
+    double x = features_right.keypoints(0, i);
+    double y = features_right.keypoints(1, i);
     right_keypoints.emplace_back(x, y, 8, -1, score);
   }
   std::string stereo_debug_save_dir = ConcatenateFolderAndFileName(stereo_save_root, "stereo_debug");
@@ -115,7 +115,7 @@ void SaveLineDetectionResult(cv::Mat& image, std::vector<Eigen::Vector4d>& lines
 }
 
 void SavePointLineRelation(cv::Mat& image, std::vector<Eigen::Vector4d>& lines, Eigen::Matrix2Xd& points, 
-    std::vector<std::map<int, double>>& relation,  std::string save_root, std::string idx){
+    PointsOnLines& relation,  std::string save_root, std::string idx){
   cv::Mat img_color;
   cv::cvtColor(image, img_color, cv::COLOR_GRAY2RGB);
   std::string line_save_dir = ConcatenateFolderAndFileName(save_root, "point_line_relation");
@@ -134,9 +134,9 @@ void SavePointLineRelation(cv::Mat& image, std::vector<Eigen::Vector4d>& lines,
     cv::line(img_color, cv::Point2i((int)(line(0)+0.5), (int)(line(1)+0.5)), 
         cv::Point2i((int)(line(2)+0.5), (int)(line(3)+0.5)), color, 1);
 
-    for(auto& kv : relation[i]){
-      colors[kv.first] = color;
-      radii[kv.first] *= 2;
+    for(const PointOnLine& point : relation[i]){
+      colors[point.index] = color;
+      radii[point.index] *= 2;
     }
   }
 
@@ -150,12 +150,12 @@ void SavePointLineRelation(cv::Mat& image, std::vector<Eigen::Vector4d>& lines,
   cv::imwrite(save_image_path, img_color);
 }
 
-cv::Mat DrawLinePointRelation(cv::Mat& image, const Eigen::Matrix<float, 259, Eigen::Dynamic>& features,
-    const std::vector<Eigen::Vector4d>& lines, const std::vector<std::map<int, double>>& points_on_line, std::vector<int>& line_ids){
+cv::Mat DrawLinePointRelation(cv::Mat& image, const FeatureSet& features,
+    const std::vector<Eigen::Vector4d>& lines, const PointsOnLines& points_on_line, std::vector<int>& line_ids){
   cv::Mat img_color;
   cv::cvtColor(image, img_color, cv::COLOR_GRAY2RGB);
 
-  Eigen::Matrix2Xf points = features.middleRows(1, 2);
+  const Eigen::Matrix2Xf& points = features.keypoints;
   size_t point_num = points.cols();
   std::vector<cv::Scalar> colors(point_num, cv::Scalar(0, 255, 0));
   std::vector<int> radii(point_num, 2);
@@ -167,9 +167,9 @@ cv::Mat DrawLinePointRelation(cv::Mat& image, const Eigen::Matrix<float, 259, Ei
     cv::line(img_color, cv::Point2i((int)(line(0)+0.5), (int)(line(1)+0.5)), 
         cv::Point2i((int)(line(2)+0.5), (int)(line(3)+0.5)), color, 2);
 
-    for(auto& kv : points_on_line[i]){
-      colors[kv.first] = color;
-      radii[kv.first] *= 2;
+    for(const PointOnLine& point : points_on_line[i]){
+      colors[point.index] = color;
+      radii[point.index] *= 2;
     }
 
   }
@@ -185,11 +185,11 @@ cv::Mat DrawLinePointRelation(cv::Mat& image, const Eigen::Matrix<float, 259, Ei
 }
 
 void SaveStereoLineMatch(cv::Mat& image_left, cv::Mat& image_right, 
-    Eigen::Matrix<float, 259, Eigen::Dynamic>& feature_left,
-    Eigen::Matrix<float, 259, Eigen::Dynamic>& feature_right,
+    FeatureSet& feature_left,
+    FeatureSet& feature_right,
     std::vector<Eigen::Vector4d>& lines_left, std::vector<Eigen::Vector4d>& lines_right,
-    std::vector<std::map<int, double>>& points_on_line_left, 
-    std::vector<std::map<int, double>>& points_on_line_right,
+    PointsOnLines& points_on_line_left, 
+    PointsOnLines& points_on_line_right,
     std::vector<int>& right_to_left_line_matches, std::string save_root, std::string idx){
   
   std::vector<int> line_ids_left(lines_left.size());
@@ -318,9 +318,9 @@ void DrawDbowMatchingResults(FramePtr query_frame, cv::Mat& query_image, std::ve
     return image_rect;
   };
 
-  const Eigen::Matrix<float, 259, Eigen::Dynamic>& query_features = query_frame->GetAllFeatures();
+  const FeatureSet& query_features = query_frame->GetAllFeatures();
   std::vector<Eigen::Vector4d> query_lines = query_frame->GatAllLines();
-  std::vector<std::map<int, double>> query_points_on_line = query_frame->GetPointsOnLines();
+  const PointsOnLines& query_points_on_line = query_frame->GetPointsOnLines();
   std::vector<int> query_line_ids(query_lines.size());
   std::iota(query_line_ids.begin(), query_line_ids.end(), 1);
   cv::Mat query_drawed_image = DrawLinePointRelation(query_image, query_features, query_lines, query_points_on_line, query_line_ids);
@@ -333,7 +333,7 @@ void DrawDbowMatchingResults(FramePtr query_frame, cv::Mat& query_image, std::ve
   database->FrameToBow(query_frame, query_word_features, query_bow_vector, query_word_of_features);
 
   for(FramePtr database_frame : database_frames){
-    const Eigen::Matrix<float, 259, Eigen::Dynamic>& base_features = database_frame->GetAllFeatures();
+    const FeatureSet& base_features = database_frame->GetAllFeatures();
     DBoW2::WordIdToFeatures base_word_features; 
     DBoW2::BowVector base_bow_vector;
     std::vector<DBoW2::WordId> base_word_of_features;
@@ -375,7 +375,7 @@ void DrawDbowMatchingResults(FramePtr query_frame, cv::Mat& query_image, std::ve
 
     cv::Mat base_image = read_image(database_frame);
     std::vector<Eigen::Vector4d> base_lines = database_frame->GatAllLines();
-    std::vector<std::map<int, double>> base_points_on_line = database_frame->GetPointsOnLines();
+    const PointsOnLines& base_points_on_line = database_frame->GetPointsOnLines();
     std::vector<int> base_line_ids(base_lines.size());
     std::iota(base_line_ids.begin(), base_line_ids.end(), 1);
     cv::Mat base_drawed_image = DrawLinePointRelation(base_image, base_features, base_lines, base_points_on_line, base_line_ids);
@@ -440,22 +440,22 @@ void DrawDbowJunctionMatchingResults(FramePtr query_frame, cv::Mat& query_image,
     return img_color;
   };
 
-  const Eigen::Matrix<float, 259, Eigen::Dynamic>& query_features = query_frame->GetJunctions();
+  const FeatureSet& query_features = query_frame->GetJunctions();
   std::vector<cv::KeyPoint> query_points;
-  for(int i = 0; i < query_features.cols(); i++){
-    float x = query_features(1, i);
-    float y = query_features(2, i);
+  for(int i = 0; i < query_features.Size(); i++){
+    float x = query_features.keypoints(0, i);
+    float y = query_features.keypoints(1, i);
     query_points.emplace_back(x, y, 8, -1, 1);
   }
   std::vector<Eigen::Vector4d> query_lines = query_frame->GatAllLines();
   cv::Mat query_drawed_image = draw_lines(query_image, query_lines); 
 
 
-  const Eigen::Matrix<float, 259, Eigen::Dynamic>& base_features = database_frame->GetJunctions();
+  const FeatureSet& base_features = database_frame->GetJunctions();
   std::vector<cv::KeyPoint> base_points;
-  for(int i = 0; i < base_features.cols(); i++){
-    float x = base_features(1, i);
-    float y = base_features(2, i);
+  for(int i = 0; i < base_features.Size(); i++){
+    float x = base_features.keypoints(0, i);
+    float y = base_features.keypoints(1, i);
     base_points.emplace_back(x, y, 8, -1, 1);
   }
   std::vector<Eigen::Vector4d> base_lines = database_frame->GatAllLines();
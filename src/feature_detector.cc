@@ -1,45 +1,67 @@
+#include <thread>
 #include <opencv2/opencv.hpp>
 
 #include "plnet.h"
 #include "feature_detector.h"
 #include "utils.h"
 
+FeatureDetector::FeatureDetector(){
+}
+
 FeatureDetector::FeatureDetector(const PLNetConfig& plnet_config) : _plnet_config(plnet_config){
+  BuildNetworks(_superpoint, _plnet);
+
+  // the inference engines can not be shared by two threads, so the right image gets its own networks
+  if(_plnet_config.stereo_parallel){
+    BuildNetworks(_superpoint_right, _plnet_right);
+  }
+}
+
+void FeatureDetector::BuildNetworks(SuperPointPtr& superpoint, PLNetPtr& plnet){
   if(_plnet_config.use_superpoint){
     SuperPointConfig superpoint_config;
-    superpoint_config.max_keypoints = plnet_config.max_keypoints;
-    superpoint_config.keypoint_threshold = plnet_config.keypoint_threshold;
-    superpoint_config.remove_borders = plnet_config.remove_borders;
+    superpoint_config.max_keypoints = _plnet_config.max_keypoints;
+    superpoint_config.keypoint_threshold = _plnet_config.keypoint_threshold;
+    superpoint_config.remove_borders = _plnet_config.remove_borders;
     superpoint_config.dla_core = -1;
+    superpoint_config.backend = _plnet_config.backend;
+    superpoint_config.cpu_threads = _plnet_config.cpu_threads;
 
     superpoint_config.input_tensor_names.push_back("input");
     superpoint_config.output_tensor_names.push_back("scores");
     superpoint_config.output_tensor_names.push_back("descriptors");
 
-    superpoint_config.onnx_file = plnet_config.superpoint_onnx;
-    superpoint_config.engine_file = plnet_config.superpoint_engine;
+    superpoint_config.onnx_file = _plnet_config.superpoint_onnx;
+    superpoint_config.engine_file = _plnet_config.superpoint_engine;
 
-    _superpoint = std::shared_ptr<SuperPoint>(new SuperPoint(superpoint_config));
-    if (!_superpoint->build()){
+    superpoint = std::shared_ptr<SuperPoint>(new SuperPoint(superpoint_config));
+    if (!superpoint->build()){
       std::cout << "Error in SuperPoint building" << std::endl;
       exit(0);
     }
   }
 
-  _plnet = std::shared_ptr<PLNet>(new PLNet(_plnet_config));
-  if (!_plnet->build()){
+  plnet = std::shared_ptr<PLNet>(new PLNet(_plnet_config));
+  if (!plnet->build()){
     std::cout << "Error in FeatureDetector building" << std::endl;
     // exit(0);
   }
 }
 
-bool FeatureDetector::Detect(cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dynamic> &features){
+void FeatureDetector::SetDetectionBudget(int max_keypoints, float line_length_threshold){
+  if(_superpoint) _superpoint->set_max_keypoints(max_keypoints);
+  if(_superpoint_right) _superpoint_right->set_max_keypoints(max_keypoints);
+  if(_plnet) _plnet->set_detection_budget(max_keypoints, line_length_threshold);
+  if(_plnet_right) _plnet_right->set_detection_budget(max_keypoints, line_length_threshold);
+}
+
+bool FeatureDetector::Detect(cv::Mat& image, FeatureSet &features){
   bool good_infer = false;
   if(_plnet_config.use_superpoint){
     good_infer = _superpoint->infer(image, features);
   }else{
     std::vector<Eigen::Vector4d> lines;
-    good_infer = Detect(image, features, lines);
+    good_infer = FeatureDetector::Detect(image, features, lines);
   }
 
 
@@ -49,9 +71,9 @@ bool FeatureDetector::Detect(cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dy
   return good_infer; 
 }
 
-bool FeatureDetector::Detect(cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dynamic> &features, 
+bool FeatureDetector::Detect(cv::Mat& image, FeatureSet &features, 
     std::vector<Eigen::Vector4d>& lines){
-  Eigen::Matrix<float, 259, Eigen::Dynamic> junctions;
+  FeatureSet junctions;
   bool good_infer = _plnet->infer(image, features, lines, junctions);
   if(!good_infer){
     std::cout << "Failed when extracting point features !" << std::endl;
@@ -59,8 +81,8 @@ bool FeatureDetector::Detect(cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dy
   return good_infer; 
 }
 
-bool FeatureDetector::Detect(cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dynamic> &features, 
-    std::vector<Eigen::Vector4d>& lines, Eigen::Matrix<float, 259, Eigen::Dynamic>& junctions){
+bool FeatureDetector::Detect(cv::Mat& image, FeatureSet &features, 
+    std::vector<Eigen::Vector4d>& lines, FeatureSet& junctions){
   bool good_infer = _plnet->infer(image, features, lines, junctions, true);
   if(!good_infer){
     std::cout << "Failed when extracting point features !" << std::endl;
@@ -68,11 +90,44 @@ bool FeatureDetector::Detect(cv::Mat& image, Eigen::Matrix<float, 259, Eigen::Dy
   return good_infer; 
 }
 
+bool FeatureDetector::DetectRight(cv::Mat& image, FeatureSet &features){
+  if(!_plnet_right){
+    return FeatureDetector::Detect(image, features);
+  }
+
+  bool good_infer = false;
+  if(_plnet_config.use_superpoint){
+    good_infer = _superpoint_right->infer(image, features);
+  }else{
+    std::vector<Eigen::Vector4d> lines;
+    good_infer = FeatureDetector::DetectRight(image, features, lines);
+  }
+  return good_infer; 
+}
+
+bool FeatureDetector::DetectRight(cv::Mat& image, FeatureSet &features, 
+    std::vector<Eigen::Vector4d>& lines){
+  if(!_plnet_right){
+    return FeatureDetector::Detect(image, features, lines);
+  }
+
+  FeatureSet junctions;
+  return _plnet_right->infer(image, features, lines, junctions);
+}
+
 bool FeatureDetector::Detect(cv::Mat& image_left, cv::Mat& image_right, 
-    Eigen::Matrix<float, 259, Eigen::Dynamic> & left_features, 
-    Eigen::Matrix<float, 259, Eigen::Dynamic> & right_features){
-  bool good_infer_left = Detect(image_left, left_features);
-  bool good_infer_right = Detect(image_right, right_features);
+    FeatureSet & left_features, 
+    FeatureSet & right_features){
+  bool good_infer_left = false, good_infer_right = false;
+  if(_plnet_right){
+    std::thread right_thread([&](){ good_infer_right = FeatureDetector::DetectRight(image_right, right_features); });
+    good_infer_left = FeatureDetector::Detect(image_left, left_features);
+    right_thread.join();
+  }else{
+    good_infer_left = FeatureDetector::Detect(image_left, left_features);
+    good_infer_right = FeatureDetector::Detect(image_right, right_features);
+  }
+
   bool good_infer = good_infer_left & good_infer_right;
   if(!good_infer){
     std::cout << "Failed when extracting point features !" << std::endl;
@@ -81,12 +136,20 @@ bool FeatureDetector::Detect(cv::Mat& image_left, cv::Mat& image_right,
 }
 
 bool FeatureDetector::Detect(cv::Mat& image_left, cv::Mat& image_right, 
-    Eigen::Matrix<float, 259, Eigen::Dynamic> & left_features, 
-    Eigen::Matrix<float, 259, Eigen::Dynamic> & right_features, 
+    FeatureSet & left_features, 
+    FeatureSet & right_features, 
     std::vector<Eigen::Vector4d>& left_lines, 
     std::vector<Eigen::Vector4d>& right_lines){
-  bool good_infer_left = Detect(image_left, left_features, left_lines);
-  bool good_infer_right = Detect(image_right, right_features, right_lines);
+  bool good_infer_left = false, good_infer_right = false;
+  if(_plnet_right){
+    std::thread right_thread([&](){ good_infer_right = FeatureDetector::DetectRight(image_right, right_features, right_lines); });
+    good_infer_left = FeatureDetector::Detect(image_left, left_features, left_lines);
+    right_thread.join();
+  }else{
+    good_infer_left = FeatureDetector::Detect(image_left, left_features, left_lines);
+    good_infer_right = FeatureDetector::Detect(image_right, right_features, right_lines);
+  }
+
   bool good_infer = good_infer_left & good_infer_right;
   if(!good_infer){
     std::cout << "Failed when extracting point features !" << std::endl;
@@ -94,15 +157,22 @@ bool FeatureDetector::Detect(cv::Mat& image_left, cv::Mat& image_right,
   return good_infer; 
 }
 
-bool FeatureDetector::Detect(cv::Mat& image_left, cv::Mat& image_right, Eigen::Matrix<float, 259, Eigen::Dynamic> & left_features, 
-    Eigen::Matrix<float, 259, Eigen::Dynamic> & right_features, std::vector<Eigen::Vector4d>& left_lines, 
-    std::vector<Eigen::Vector4d>& right_lines, Eigen::Matrix<float, 259, Eigen::Dynamic>& junctions){
-  bool good_infer_left = Detect(image_left, left_features, left_lines, junctions);
-  bool good_infer_right = Detect(image_right, right_features, right_lines);
+bool FeatureDetector::Detect(cv::Mat& image_left, cv::Mat& image_right, FeatureSet & left_features, 
+    FeatureSet & right_features, std::vector<Eigen::Vector4d>& left_lines, 
+    std::vector<Eigen::Vector4d>& right_lines, FeatureSet& junctions){
+  bool good_infer_left = false, good_infer_right = false;
+  if(_plnet_right){
+    std::thread right_thread([&](){ good_infer_right = FeatureDetector::DetectRight(image_right, right_features, right_lines); });
+    good_infer_left = FeatureDetector::Detect(image_left, left_features, left_lines, junctions);
+    right_thread.join();
+  }else{
+    good_infer_left = FeatureDetector::Detect(image_left, left_features, left_lines, junctions);
+    good_infer_right = FeatureDetector::Detect(image_right, right_features, right_lines);
+  }
 
   bool good_infer = good_infer_left & good_infer_right;
   if(!good_infer){
     std::cout << "Failed when extracting point features !" << std::endl;
   }
   return good_infer; 
-}
\ No newline at end of file
+}
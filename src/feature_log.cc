@@ -0,0 +1,342 @@
+#include "feature_log.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+const char FeatureLogMagic[8] = {'A', 'I', 'R', 'F', 'L', 'O', 'G', '2'};
+
+template <typename T>
+void WriteValue(std::ofstream& ofs, const T& value){
+  ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool ReadValue(std::ifstream& ifs, T& value){
+  ifs.read(reinterpret_cast<char*>(&value), sizeof(T));
+  return ifs.good();
+}
+
+}  // namespace
+
+FeatureLog::FeatureLog(const std::string& file_path, Mode mode) : _mode(mode), _record_num(0){
+  if(_mode == Mode::Record){
+    _ofs.open(file_path, std::ios::binary | std::ios::trunc);
+    if(!_ofs.is_open()){
+      std::cout << "Can not open " << file_path << std::endl;
+      return;
+    }
+    _ofs.write(FeatureLogMagic, sizeof(FeatureLogMagic));
+  }else{
+    _ifs.open(file_path, std::ios::binary);
+    if(!_ifs.is_open()){
+      std::cout << "Can not open " << file_path << std::endl;
+      return;
+    }
+    char magic[sizeof(FeatureLogMagic)];
+    _ifs.read(magic, sizeof(magic));
+    if(!_ifs.good() || !std::equal(magic, magic + sizeof(magic), FeatureLogMagic)){
+      std::cout << file_path << " is not a feature log" << std::endl;
+      _ifs.close();
+    }
+  }
+}
+
+FeatureLog::~FeatureLog(){
+  if(_ofs.is_open()) _ofs.close();
+  if(_ifs.is_open()) _ifs.close();
+}
+
+bool FeatureLog::IsOpen(){
+  return (_mode == Mode::Record) ? _ofs.is_open() : _ifs.is_open();
+}
+
+FeatureLog::Mode FeatureLog::GetMode(){
+  return _mode;
+}
+
+void FeatureLog::Write(const FeatureLogRecord& record){
+  std::lock_guard<std::mutex> lock(_mutex);
+  if(!_ofs.is_open()) return;
+
+  WriteValue(_ofs, (int32_t)record.type);
+  WriteValue(_ofs, (uint8_t)record.good);
+
+  WriteValue(_ofs, (uint32_t)record.features.size());
+  for(const FeatureSet& features : record.features){
+    WriteValue(_ofs, (uint32_t)features.Size());
+    _ofs.write(reinterpret_cast<const char*>(features.scores.data()), sizeof(float) * features.scores.size());
+    _ofs.write(reinterpret_cast<const char*>(features.keypoints.data()), sizeof(float) * features.keypoints.size());
+    _ofs.write(reinterpret_cast<const char*>(features.descriptors.data()), sizeof(float) * features.descriptors.size());
+  }
+
+  WriteValue(_ofs, (uint32_t)record.lines.size());
+  for(const std::vector<Eigen::Vector4d>& lines : record.lines){
+    WriteValue(_ofs, (uint32_t)lines.size());
+    for(const Eigen::Vector4d& line : lines){
+      _ofs.write(reinterpret_cast<const char*>(line.data()), sizeof(double) * 4);
+    }
+  }
+
+  WriteValue(_ofs, (uint32_t)record.matches.size());
+  for(const cv::DMatch& match : record.matches){
+    WriteValue(_ofs, (int32_t)match.queryIdx);
+    WriteValue(_ofs, (int32_t)match.trainIdx);
+    WriteValue(_ofs, match.distance);
+  }
+  _record_num++;
+}
+
+bool FeatureLog::Read(int expected_type, FeatureLogRecord& record){
+  std::lock_guard<std::mutex> lock(_mutex);
+  if(!_ifs.is_open()) return false;
+
+  int32_t type;
+  uint8_t good;
+  if(!ReadValue(_ifs, type)){
+    std::cout << "Feature log ends after " << _record_num << " records" << std::endl;
+    _ifs.close();
+    return false;
+  }
+  if(type != expected_type){
+    std::cout << "Feature log record " << _record_num << " has type " << type << ", but " << expected_type
+              << " is expected, the calls differ from the recording" << std::endl;
+    _ifs.close();
+    return false;
+  }
+  record.type = type;
+  if(!ReadValue(_ifs, good)) return false;
+  record.good = good;
+
+  uint32_t num;
+  if(!ReadValue(_ifs, num)) return false;
+  record.features.resize(num);
+  for(FeatureSet& features : record.features){
+    uint32_t cols;
+    if(!ReadValue(_ifs, cols)) return false;
+    features.Resize(cols);
+    _ifs.read(reinterpret_cast<char*>(features.scores.data()), sizeof(float) * features.scores.size());
+    _ifs.read(reinterpret_cast<char*>(features.keypoints.data()), sizeof(float) * features.keypoints.size());
+    _ifs.read(reinterpret_cast<char*>(features.descriptors.data()), sizeof(float) * features.descriptors.size());
+  }
+
+  if(!ReadValue(_ifs, num)) return false;
+  record.lines.resize(num);
+  for(std::vector<Eigen::Vector4d>& lines : record.lines){
+    uint32_t line_num;
+    if(!ReadValue(_ifs, line_num)) return false;
+    lines.resize(line_num);
+    for(Eigen::Vector4d& line : lines){
+      _ifs.read(reinterpret_cast<char*>(line.data()), sizeof(double) * 4);
+    }
+  }
+
+  if(!ReadValue(_ifs, num)) return false;
+  record.matches.resize(num);
+  for(cv::DMatch& match : record.matches){
+    int32_t query_idx, train_idx;
+    float distance;
+    ReadValue(_ifs, query_idx);
+    ReadValue(_ifs, train_idx);
+    ReadValue(_ifs, distance);
+    match = cv::DMatch(query_idx, train_idx, distance);
+  }
+
+  if(!_ifs.good()){
+    std::cout << "Feature log record " << _record_num << " is truncated" << std::endl;
+    _ifs.close();
+    return false;
+  }
+  _record_num++;
+  return true;
+}
+
+FeatureDetectorRecorder::FeatureDetectorRecorder(const PLNetConfig& plnet_config, FeatureLogPtr feature_log) :
+    FeatureDetector(plnet_config), _feature_log(feature_log){
+}
+
+bool FeatureDetectorRecorder::Detect(cv::Mat& image, FeatureSet &features){
+  FeatureLogRecord record;
+  record.type = FeatureLogRecordType::PointFeatures;
+  record.good = FeatureDetector::Detect(image, features);
+  record.features.push_back(features);
+  _feature_log->Write(record);
+  return record.good;
+}
+
+bool FeatureDetectorRecorder::Detect(cv::Mat& image, FeatureSet &features,
+    std::vector<Eigen::Vector4d>& lines){
+  FeatureLogRecord record;
+  record.type = FeatureLogRecordType::LineFeatures;
+  record.good = FeatureDetector::Detect(image, features, lines);
+  record.features.push_back(features);
+  record.lines.push_back(lines);
+  _feature_log->Write(record);
+  return record.good;
+}
+
+bool FeatureDetectorRecorder::Detect(cv::Mat& image, FeatureSet &features,
+    std::vector<Eigen::Vector4d>& lines, FeatureSet& junctions){
+  FeatureLogRecord record;
+  record.type = FeatureLogRecordType::JunctionFeatures;
+  record.good = FeatureDetector::Detect(image, features, lines, junctions);
+  record.features.push_back(features);
+  record.features.push_back(junctions);
+  record.lines.push_back(lines);
+  _feature_log->Write(record);
+  return record.good;
+}
+
+bool FeatureDetectorRecorder::Detect(cv::Mat& image_left, cv::Mat& image_right,
+    FeatureSet & left_features, FeatureSet & right_features){
+  FeatureLogRecord record;
+  record.type = FeatureLogRecordType::StereoPointFeatures;
+  record.good = FeatureDetector::Detect(image_left, image_right, left_features, right_features);
+  record.features.push_back(left_features);
+  record.features.push_back(right_features);
+  _feature_log->Write(record);
+  return record.good;
+}
+
+bool FeatureDetectorRecorder::Detect(cv::Mat& image_left, cv::Mat& image_right,
+    FeatureSet & left_features, FeatureSet & right_features,
+    std::vector<Eigen::Vector4d>& left_lines, std::vector<Eigen::Vector4d>& right_lines){
+  FeatureLogRecord record;
+  record.type = FeatureLogRecordType::StereoLineFeatures;
+  record.good = FeatureDetector::Detect(image_left, image_right, left_features, right_features, left_lines, right_lines);
+  record.features.push_back(left_features);
+  record.features.push_back(right_features);
+  record.lines.push_back(left_lines);
+  record.lines.push_back(right_lines);
+  _feature_log->Write(record);
+  return record.good;
+}
+
+bool FeatureDetectorRecorder::Detect(cv::Mat& image_left, cv::Mat& image_right,
+    FeatureSet & left_features, FeatureSet & right_features,
+    std::vector<Eigen::Vector4d>& left_lines, std::vector<Eigen::Vector4d>& right_lines,
+    FeatureSet& junctions){
+  FeatureLogRecord record;
+  record.type = FeatureLogRecordType::StereoJunctionFeatures;
+  record.good = FeatureDetector::Detect(image_left, image_right, left_features, right_features, left_lines, right_lines, junctions);
+  record.features.push_back(left_features);
+  record.features.push_back(right_features);
+  record.features.push_back(junctions);
+  record.lines.push_back(left_lines);
+  record.lines.push_back(right_lines);
+  _feature_log->Write(record);
+  return record.good;
+}
+
+bool FeatureDetectorRecorder::DetectRight(cv::Mat& image, FeatureSet &features){
+  FeatureLogRecord record;
+  record.type = FeatureLogRecordType::RightPointFeatures;
+  record.good = FeatureDetector::DetectRight(image, features);
+  record.features.push_back(features);
+  _feature_log->Write(record);
+  return record.good;
+}
+
+bool FeatureDetectorRecorder::DetectRight(cv::Mat& image, FeatureSet &features,
+    std::vector<Eigen::Vector4d>& lines){
+  FeatureLogRecord record;
+  record.type = FeatureLogRecordType::RightLineFeatures;
+  record.good = FeatureDetector::DetectRight(image, features, lines);
+  record.features.push_back(features);
+  record.lines.push_back(lines);
+  _feature_log->Write(record);
+  return record.good;
+}
+
+FeatureDetectorReplayer::FeatureDetectorReplayer(FeatureLogPtr feature_log) : FeatureDetector(), _feature_log(feature_log){
+}
+
+bool FeatureDetectorReplayer::ReadFeatures(int type, std::vector<FeatureSet*> features,
+    std::vector<std::vector<Eigen::Vector4d>*> lines){
+  FeatureLogRecord record;
+  if(!_feature_log->Read(type, record) || record.features.size() != features.size() || record.lines.size() != lines.size()){
+    for(FeatureSet* f : features) f->Resize(0);
+    for(std::vector<Eigen::Vector4d>* l : lines) l->clear();
+    return false;
+  }
+
+  for(size_t i = 0; i < features.size(); i++){
+    *features[i] = std::move(record.features[i]);
+  }
+  for(size_t i = 0; i < lines.size(); i++){
+    *lines[i] = std::move(record.lines[i]);
+  }
+  return record.good;
+}
+
+bool FeatureDetectorReplayer::Detect(cv::Mat& image, FeatureSet &features){
+  return ReadFeatures(FeatureLogRecordType::PointFeatures, {&features}, {});
+}
+
+bool FeatureDetectorReplayer::Detect(cv::Mat& image, FeatureSet &features,
+    std::vector<Eigen::Vector4d>& lines){
+  return ReadFeatures(FeatureLogRecordType::LineFeatures, {&features}, {&lines});
+}
+
+bool FeatureDetectorReplayer::Detect(cv::Mat& image, FeatureSet &features,
+    std::vector<Eigen::Vector4d>& lines, FeatureSet& junctions){
+  return ReadFeatures(FeatureLogRecordType::JunctionFeatures, {&features, &junctions}, {&lines});
+}
+
+bool FeatureDetectorReplayer::Detect(cv::Mat& image_left, cv::Mat& image_right,
+    FeatureSet & left_features, FeatureSet & right_features){
+  return ReadFeatures(FeatureLogRecordType::StereoPointFeatures, {&left_features, &right_features}, {});
+}
+
+bool FeatureDetectorReplayer::Detect(cv::Mat& image_left, cv::Mat& image_right,
+    FeatureSet & left_features, FeatureSet & right_features,
+    std::vector<Eigen::Vector4d>& left_lines, std::vector<Eigen::Vector4d>& right_lines){
+  return ReadFeatures(FeatureLogRecordType::StereoLineFeatures, {&left_features, &right_features}, {&left_lines, &right_lines});
+}
+
+bool FeatureDetectorReplayer::Detect(cv::Mat& image_left, cv::Mat& image_right,
+    FeatureSet & left_features, FeatureSet & right_features,
+    std::vector<Eigen::Vector4d>& left_lines, std::vector<Eigen::Vector4d>& right_lines,
+    FeatureSet& junctions){
+  return ReadFeatures(FeatureLogRecordType::StereoJunctionFeatures,
+      {&left_features, &right_features, &junctions}, {&left_lines, &right_lines});
+}
+
+bool FeatureDetectorReplayer::DetectRight(cv::Mat& image, FeatureSet &features){
+  return ReadFeatures(FeatureLogRecordType::RightPointFeatures, {&features}, {});
+}
+
+bool FeatureDetectorReplayer::DetectRight(cv::Mat& image, FeatureSet &features,
+    std::vector<Eigen::Vector4d>& lines){
+  return ReadFeatures(FeatureLogRecordType::RightLineFeatures, {&features}, {&lines});
+}
+
+PointMatcherRecorder::PointMatcherRecorder(const PointMatcherConfig& config, FeatureLogPtr feature_log) :
+    PointMatcher(config), _feature_log(feature_log){
+}
+
+int PointMatcherRecorder::MatchingPoints(const FeatureSet& features0,
+    const FeatureSet& features1, std::vector<cv::DMatch>& matches, bool outlier_rejection){
+  int num = PointMatcher::MatchingPoints(features0, features1, matches, outlier_rejection);
+  FeatureLogRecord record;
+  record.type = FeatureLogRecordType::PointMatches;
+  record.good = true;
+  record.matches = matches;
+  _feature_log->Write(record);
+  return num;
+}
+
+PointMatcherReplayer::PointMatcherReplayer(FeatureLogPtr feature_log) : PointMatcher(), _feature_log(feature_log){
+}
+
+int PointMatcherReplayer::MatchingPoints(const FeatureSet& features0,
+    const FeatureSet& features1, std::vector<cv::DMatch>& matches, bool outlier_rejection){
+  FeatureLogRecord record;
+  if(!_feature_log->Read(FeatureLogRecordType::PointMatches, record)){
+    matches.clear();
+    return 0;
+  }
+  matches = std::move(record.matches);
+  return matches.size();
+}
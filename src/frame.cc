@@ -1,5 +1,6 @@
 #include "frame.h"
 #include <assert.h>
+#include <algorithm>
 
 #include "line_processor.h"
 
@@ -83,23 +84,23 @@ bool Frame::FindGrid(float& x, float& y, int& grid_x, int& grid_y){
   return !(grid_x < 0 || grid_x >= FRAME_GRID_COLS || grid_y < 0 || grid_y >= FRAME_GRID_ROWS);
 }
 
-void Frame::AddFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_left, 
-    Eigen::Matrix<float, 259, Eigen::Dynamic>& features_right, std::vector<Eigen::Vector4d>& lines_left, 
+void Frame::AddFeatures(FeatureSet& features_left, 
+    FeatureSet& features_right, std::vector<Eigen::Vector4d>& lines_left, 
     std::vector<Eigen::Vector4d>& lines_right, std::vector<cv::DMatch>& stereo_matches){
   AddLeftFeatures(features_left, lines_left);
   AddRightFeatures(features_right, lines_right, stereo_matches);
 }
 
-void Frame::AddLeftFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_left, 
+void Frame::AddLeftFeatures(FeatureSet& features_left, 
     std::vector<Eigen::Vector4d>& lines_left){
   _features = features_left;
 
   // fill in keypoints and assign features to grids
-  size_t features_left_size = _features.cols();
+  size_t features_left_size = _features.Size();
   for(size_t i = 0; i < features_left_size; ++i){
-    float score = _features(0, i);
-    float x = _features(1, i);
-    float y = _features(2, i);
+    float score = _features.scores(i);
+    float x = _features.keypoints(0, i);
+    float y = _features.keypoints(1, i);
     _keypoints.emplace_back(x, y, 8, -1, score);
 
     int grid_x, grid_y;
@@ -120,10 +121,8 @@ void Frame::AddLeftFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_
 
   // assign points to lines
   _lines = lines_left;
-  std::vector<std::map<int, double>> points_on_line_left;
-  std::vector<int> line_matches;
-  AssignPointsToLines(lines_left, features_left, points_on_line_left);
-  _points_on_lines = points_on_line_left;
+  AssignPointsToLines(lines_left, features_left.keypoints, &_feature_grid[0][0], FRAME_GRID_COLS, FRAME_GRID_ROWS,
+      _grid_width_inv, _grid_height_inv, _points_on_lines);
 
   // initialize line track ids and maplines
   size_t line_num = lines_left.size();
@@ -131,12 +130,9 @@ void Frame::AddLeftFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_
   _line_track_ids = line_track_ids;
   std::vector<MaplinePtr> maplines(line_num, nullptr);
   _maplines = maplines;
-
-  // for debug
-  relation_left = points_on_line_left;
 }
 
-int Frame::AddRightFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_right, 
+int Frame::AddRightFeatures(FeatureSet& features_right, 
     std::vector<Eigen::Vector4d>& lines_right, std::vector<cv::DMatch>& stereo_matches){
 
   // filter matches from superglue
@@ -148,8 +144,8 @@ int Frame::AddRightFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_
     int idx_left = match.queryIdx;
     int idx_right = match.trainIdx;
 
-    double dx = std::abs(_features(1, idx_left) - features_right(1, idx_right));
-    double dy = std::abs(_features(2, idx_left) - features_right(2, idx_right));
+    double dx = std::abs(_features.keypoints(0, idx_left) - features_right.keypoints(0, idx_right));
+    double dy = std::abs(_features.keypoints(1, idx_left) - features_right.keypoints(1, idx_right));
 
     if(dx > min_x_diff && dx < max_x_diff && dy <= max_y_diff){
       matches.emplace_back(match);
@@ -163,25 +159,34 @@ int Frame::AddRightFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_
     int idx_right = match.trainIdx;
 
     assert(idx_left < _u_right.size());
-    double parallax = _features(1, idx_left) - features_right(1, idx_right);
+    double parallax = _features.keypoints(0, idx_left) - features_right.keypoints(0, idx_right);
 
     if(parallax < _camera->MaxXDiff() && parallax > _camera->MinXDiff()){
-      _u_right[idx_left] = features_right(1, idx_right);
+      _u_right[idx_left] = features_right.keypoints(0, idx_right);
       _depth[idx_left] = _camera->BF() / parallax;
       good_stereo_point++;
     }
   }
 
   // assign points to lines
-  std::vector<std::map<int, double>> points_on_line_right;
-  AssignPointsToLines(lines_right, features_right, points_on_line_right);
+  std::vector<std::vector<int>> grid_right(FRAME_GRID_COLS * FRAME_GRID_ROWS);
+  for(size_t i = 0; i < features_right.Size(); ++i){
+    float x = features_right.keypoints(0, i);
+    float y = features_right.keypoints(1, i);
+    int grid_x, grid_y;
+    FindGrid(x, y, grid_x, grid_y);
+    grid_right[grid_x * FRAME_GRID_ROWS + grid_y].push_back(i);
+  }
+  PointsOnLines points_on_line_right;
+  AssignPointsToLines(lines_right, features_right.keypoints, grid_right.data(), FRAME_GRID_COLS, FRAME_GRID_ROWS,
+      _grid_width_inv, _grid_height_inv, points_on_line_right);
 
   // match stereo lines
   std::vector<int> line_matches;
   size_t line_num = _lines.size();
   _lines_right.resize(line_num);
   _lines_right_valid.resize(line_num);
-  MatchLines(_points_on_lines, points_on_line_right, matches, _features.cols(), features_right.cols(), line_matches);
+  MatchLines(_points_on_lines, points_on_line_right, matches, _features.Size(), features_right.Size(), line_matches);
   for(size_t i = 0; i < line_num; i++){
     if(line_matches[i] > 0){
       _lines_right[i] = lines_right[line_matches[i]];
@@ -193,22 +198,21 @@ int Frame::AddRightFeatures(Eigen::Matrix<float, 259, Eigen::Dynamic>& features_
 
   // for debug
   line_left_to_right_match = line_matches;
-  relation_right = points_on_line_right;
 
   return good_stereo_point;
 }
 
-Eigen::Matrix<float, 259, Eigen::Dynamic>& Frame::GetAllFeatures(){
+FeatureSet& Frame::GetAllFeatures(){
   return _features;
 }
 
 size_t Frame::FeatureNum(){
-  return _features.cols();
+  return _features.Size();
 }
 
 bool Frame::GetKeypointPosition(size_t idx, Eigen::Vector3d& keypoint_pos){
-  if(idx > _features.cols()) return false;
-  keypoint_pos.head(2) = _features.block<2, 1>(1, idx).cast<double>();
+  if(idx > _features.Size()) return false;
+  keypoint_pos.head(2) = _features.keypoints.col(idx).cast<double>();
   keypoint_pos(2) = _u_right[idx];
   return true;
 }
@@ -246,11 +250,16 @@ std::vector<double>& Frame::GetAllRightPosition(){
 } 
 
 bool Frame::GetDescriptor(size_t idx, Eigen::Matrix<float, 256, 1>& descriptor) const{
-  if(idx > _features.cols()) return false;
-  descriptor = _features.block<256, 1>(3, idx);
+  if(idx >= _features.Size()) return false;
+  _features.DecodeDescriptor(idx, descriptor.data());
   return true;
 }
 
+void Frame::CompressDescriptors(int precision){
+  _features.CompressDescriptors(precision);
+  _junctions.CompressDescriptors(precision);
+}
+
 double Frame::GetDepth(size_t idx){
   assert(idx < _depth.size());
   return _depth[idx];
@@ -326,7 +335,7 @@ void Frame::FindNeighborKeypoints(Eigen::Vector3d& p2D, std::vector<int>& indice
 
         const double dx = _keypoints[idx].pt.x - x;
         const double dy = _keypoints[idx].pt.y - y;
-        const double dxr = (xr > 0) ? (_u_right[idx] - xr) : 0;
+        const double dxr = (xr > 0 && _u_right[idx] > 0) ? (_u_right[idx] - xr) : 0;
         if(std::abs(dx) < r && std::abs(dy) < r && std::abs(dxr) < r){
           indices.push_back(idx);
         }
@@ -404,15 +413,14 @@ const std::vector<MaplinePtr>& Frame::GetConstAllMaplines(){
   return _maplines;
 }
 
-std::map<int, double> Frame::GetPointsOnLine(size_t idx){
-  if(idx >= _points_on_lines.size()){
-    std::map<int, double> null_map;
-    return null_map;
+PointsOnLines::Span Frame::GetPointsOnLine(size_t idx){
+  if(idx >= _points_on_lines.LineNum()){
+    return PointsOnLines::Span{nullptr, nullptr};
   }
   return _points_on_lines[idx];
 }
 
-const std::vector<std::map<int, double>>& Frame::GetPointsOnLines(){
+const PointsOnLines& Frame::GetPointsOnLines(){
   return _points_on_lines;
 }
 
@@ -431,16 +439,16 @@ void Frame::RemoveMapline(int idx){
   }
 }
 
-void Frame::AddJunctions(Eigen::Matrix<float, 259, Eigen::Dynamic>& junctions){
+void Frame::AddJunctions(FeatureSet& junctions){
   _junctions = junctions;
 }
 
-Eigen::Matrix<float, 259, Eigen::Dynamic>& Frame::GetJunctions(){
+FeatureSet& Frame::GetJunctions(){
   return _junctions;
 }
 
 int Frame::JunctionNum(){
-  return _junctions.cols();
+  return _junctions.Size();
 }
 
 void Frame::RemoveMappoint(MappointPtr mappoint){
@@ -510,14 +518,14 @@ void Frame::Repropagate(){
 }
 
 void Frame::DetectSentences(std::vector<DBoW2::WordId>& word_of_features){
-  assert((int)word_of_features.size() == _features.cols());
+  assert((int)word_of_features.size() == _features.Size());
   _sentences.clear();
-  _sentences.resize(_points_on_lines.size());
-  for(int i = 0; i < _points_on_lines.size(); i++){
+  _sentences.resize(_points_on_lines.LineNum());
+  for(int i = 0; i < _points_on_lines.LineNum(); i++){
     if(_points_on_lines[i].size() < 2) continue;
 
-    for(auto& kv : _points_on_lines[i]){
-      int kpt_idx = kv.first;
+    for(const PointOnLine& point : _points_on_lines[i]){
+      int kpt_idx = point.index;
       DBoW2::WordId word_id = word_of_features[kpt_idx];
       if(word_id < UINT_MAX){
         _sentence_ids_of_word[word_id].push_back(i);
@@ -579,35 +587,51 @@ const std::vector<std::vector<DBoW2::WordId>>& Frame::GetSentenses(){
 }
 
 void Frame::FindJunctionConnections(){
-  _connected_junctions.resize(_junctions.cols());
+  _connected_junctions.resize(_junctions.Size());
 
   const int W = _camera->ImageWidth();
   const int H = _camera->ImageHeight();
-  std::vector<std::vector<int>> junction_map(H, std::vector<int>(W, -1));
-  for(int i = 0; i < _junctions.cols(); ++i){
-    int x = (int)(_junctions(1, i)+0.5);
-    int y = (int)(_junctions(2, i)+0.5);
-    junction_map[y][x] = i;
+
+  // (y * W + x, junction id) sorted by the pixel index, only the last junction of a pixel is kept, so the 
+  // junctions of a window row are a contiguous range
+  std::vector<std::pair<int, int>> junction_pixels;
+  junction_pixels.reserve(_junctions.Size());
+  for(int i = 0; i < _junctions.Size(); ++i){
+    int x = (int)(_junctions.keypoints(0, i)+0.5);
+    int y = (int)(_junctions.keypoints(1, i)+0.5);
+    junction_pixels.emplace_back(y * W + x, i);
+  }
+  std::sort(junction_pixels.begin(), junction_pixels.end());
+  size_t pixel_num = 0;
+  for(size_t k = 0; k < junction_pixels.size(); ++k){
+    if(pixel_num > 0 && junction_pixels[pixel_num - 1].first == junction_pixels[k].first){
+      junction_pixels[pixel_num - 1] = junction_pixels[k];
+    }else{
+      junction_pixels[pixel_num++] = junction_pixels[k];
+    }
   }
+  junction_pixels.resize(pixel_num);
 
   const int WS = 2; // window size
-  std::function<int(double, double)> match_junction = [&](double x, double y){
+  auto match_junction = [&](double x, double y){
     int junction_id = -1;
     int d_min = 2 * WS + 1;
 
     int xi = int(x+0.5);
     int yi = int(y+0.5);
+    int min_j = std::max(xi - WS, 0);
+    int max_j = std::min(xi + WS, W-1);
     for(int i = std::max(yi - WS, 0); i <= std::min(yi + WS, H-1); i++){
-      for(int j = std::max(xi - WS, 0); j <= std::min(xi + WS, W-1); j++){
-        if(junction_map[i][j] >= 0){
-          int d = std::abs(yi - i) + std::abs(xi - j);
-          if(d < d_min){
-            junction_id = junction_map[i][j];
-            d_min = d;
-
-            if(d_min == 0){
-              return junction_id;
-            }
+      auto it = std::lower_bound(junction_pixels.begin(), junction_pixels.end(), std::make_pair(i * W + min_j, -1));
+      for(; it != junction_pixels.end() && it->first <= i * W + max_j; ++it){
+        int j = it->first - i * W;
+        int d = std::abs(yi - i) + std::abs(xi - j);
+        if(d < d_min){
+          junction_id = it->second;
+          d_min = d;
+
+          if(d_min == 0){
+            return junction_id;
           }
         }
       }
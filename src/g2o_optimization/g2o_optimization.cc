@@ -8,6 +8,7 @@
 #include <eigen3/Eigen/Dense>
 
 #include <g2o/core/block_solver.h>
+#include <g2o/core/hyper_graph_action.h>
 #include <g2o/core/optimization_algorithm_levenberg.h>
 #include <g2o/solvers/eigen/linear_solver_eigen.h>
 #include <g2o/types/sba/types_six_dof_expmap.h>
@@ -24,6 +25,22 @@
 #include "g2o_optimization/edge_project_line.h"
 #include "g2o_optimization/edge_relative_pose.h"
 
+// copies the force stop flag of another thread to the flag of the optimizer before every iteration
+class ForceStopAction : public g2o::HyperGraphAction{
+public:
+  ForceStopAction(const std::atomic<bool>* source, bool* target) : _source(source), _target(target){}
+
+  virtual g2o::HyperGraphAction* operator()(const g2o::HyperGraph* graph, 
+      g2o::HyperGraphAction::Parameters* parameters = 0){
+    *_target = _source->load();
+    return this;
+  }
+
+private:
+  const std::atomic<bool>* _source;
+  bool* _target;
+};
+
 void AddFrameVertex(FramePtr frame, MapOfPoses& poses, int id_camera, bool fix_this_frame){
   int frame_id = frame->GetFrameId();
   Eigen::Matrix4d& frame_pose = frame->GetPose();
@@ -80,7 +97,8 @@ void LocalmapOptimization(MapOfPoses& poses, MapOfPoints3d& points, MapOfLine3d&
     MapOfVelocity& velocities, MapOfBias& biases, std::vector<CameraPtr>& camera_list, 
     VectorOfMonoPointConstraints& mono_point_constraints, VectorOfStereoPointConstraints& stereo_point_constraints, 
     VectorOfMonoLineConstraints& mono_line_constraints, VectorOfStereoLineConstraints& stereo_line_constraints,
-    VectorOfIMUConstraints& imu_constraints, const Eigen::Matrix3d& Rwg, const OptimizationConfig& cfg){
+    VectorOfIMUConstraints& imu_constraints, const Eigen::Matrix3d& Rwg, const OptimizationConfig& cfg, 
+    const std::atomic<bool>* force_stop_flag){
 
   // std::cout << "---------LocalmapOptimization----------" << std::endl;
   // std::cout << "poses.size = " << poses.size() << std::endl;
@@ -95,7 +113,9 @@ void LocalmapOptimization(MapOfPoses& poses, MapOfPoints3d& points, MapOfLine3d&
   // std::cout << "imu_constraints.size = " << imu_constraints.size() << std::endl;
   // std::cout << "------------------------------------" << std::endl;
 
-  // 1. optimizer
+  // 1. optimizer, the action outlives the optimizer which does not own it
+  bool force_stop = false;
+  ForceStopAction force_stop_action(force_stop_flag, &force_stop);
   g2o::SparseOptimizer optimizer;
   auto linear_solver = g2o::make_unique<g2o::LinearSolverEigen<g2o::BlockSolverX::PoseMatrixType>>();
   g2o::OptimizationAlgorithmLevenberg *solver = new g2o::OptimizationAlgorithmLevenberg(
@@ -103,6 +123,11 @@ void LocalmapOptimization(MapOfPoses& poses, MapOfPoints3d& points, MapOfLine3d&
 
   optimizer.setVerbose(false);
   optimizer.setAlgorithm(solver);
+  if(force_stop_flag){
+    force_stop = force_stop_flag->load();
+    optimizer.setForceStopFlag(&force_stop);
+    optimizer.addPreIterationAction(&force_stop_action);
+  }
 
   // 2. frame vertex
   int max_frame_id = 0;
@@ -380,9 +405,11 @@ void LocalmapOptimization(MapOfPoses& poses, MapOfPoints3d& points, MapOfLine3d&
     e->setRobustKernel(0);
   }
 
-  // optimize again without the outliers
-  optimizer.initializeOptimization(0);
-  optimizer.optimize(15);
+  // optimize again without the outliers, skipped if a newer keyframe is waiting
+  if(!force_stop_flag || !force_stop_flag->load()){
+    optimizer.initializeOptimization(0);
+    optimizer.optimize(15);
+  }
 
 
   // check inlier observations     
@@ -0,0 +1,46 @@
+#include "image_pool.h"
+
+ImagePool::ImagePool(int rows, int cols, int type, size_t size): _next(0), _allocation_count(0){
+  _buffers.resize(size);
+  for(cv::Mat& buffer : _buffers){
+    buffer.create(rows, cols, type);
+  }
+}
+
+cv::Mat ImagePool::Acquire(int rows, int cols, int type){
+  std::lock_guard<std::mutex> lock(_mutex);
+  size_t buffer_num = _buffers.size();
+  for(size_t i = 0; i < buffer_num; i++){
+    size_t idx = (_next + i) % buffer_num;
+    cv::Mat& buffer = _buffers[idx];
+    if(!IsFree(buffer)) continue;
+
+    if(buffer.rows != rows || buffer.cols != cols || buffer.type() != type){
+      buffer.create(rows, cols, type);
+      _allocation_count++;
+    }
+    _next = (idx + 1) % buffer_num;
+    return buffer;
+  }
+
+  // all buffers are in use
+  _buffers.emplace_back(rows, cols, type);
+  _allocation_count++;
+  _next = 0;
+  return _buffers.back();
+}
+
+size_t ImagePool::Size(){
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _buffers.size();
+}
+
+size_t ImagePool::AllocationCount(){
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _allocation_count;
+}
+
+bool ImagePool::IsFree(const cv::Mat& buffer){
+  // only the header in the pool references the data
+  return buffer.u && CV_XADD(&(buffer.u->refcount), 0) == 1;
+}
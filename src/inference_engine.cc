@@ -0,0 +1,29 @@
+#include "inference_engine.h"
+
+#include <iostream>
+
+#include "opencv_engine.h"
+#ifdef WITH_TENSORRT
+#include "tensorrt_engine.h"
+#endif
+
+InferenceEnginePtr CreateInferenceEngine(const InferenceEngineConfig& config){
+  if(config.backend == OpenCVBackend){
+    return std::shared_ptr<InferenceEngine>(new OpenCVEngine(config));
+  }else if(config.backend == TensorRTBackend){
+#ifdef WITH_TENSORRT
+    return std::shared_ptr<InferenceEngine>(new TensorRTEngine(config));
+#else
+    std::cout << "TensorRT backend is not compiled, please build with WITH_TENSORRT=ON or use backend 1" << std::endl;
+#endif
+  }else{
+    std::cout << "Unknown inference backend " << config.backend << " (0 for TensorRT and 1 for OpenCV DNN)" << std::endl;
+  }
+  return nullptr;
+}
+
+std::string InferenceBackendName(int backend){
+  if(backend == TensorRTBackend) return "TensorRT";
+  if(backend == OpenCVBackend) return "OpenCV DNN";
+  return "unknown";
+}
@@ -0,0 +1,252 @@
+#include "latency_stats.h"
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+LatencyHistogram::LatencyHistogram(){
+  for(int i = 0; i < BucketNum; i++){
+    _buckets[i].store(0, std::memory_order_relaxed);
+  }
+  _count.store(0, std::memory_order_relaxed);
+  _sum.store(0, std::memory_order_relaxed);
+  _max.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Record(uint64_t value_us){
+  _buckets[BucketIndex(value_us)].fetch_add(1, std::memory_order_relaxed);
+  _count.fetch_add(1, std::memory_order_relaxed);
+  _sum.fetch_add(value_us, std::memory_order_relaxed);
+  if(value_us > _max.load(std::memory_order_relaxed)){
+    _max.store(value_us, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other){
+  for(int i = 0; i < BucketNum; i++){
+    _buckets[i].fetch_add(other._buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+  _count.fetch_add(other._count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  _sum.fetch_add(other._sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  uint64_t other_max = other._max.load(std::memory_order_relaxed);
+  if(other_max > _max.load(std::memory_order_relaxed)){
+    _max.store(other_max, std::memory_order_relaxed);
+  }
+}
+
+uint64_t LatencyHistogram::Count() const{
+  return _count.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::Max() const{
+  return _max.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::Mean() const{
+  uint64_t count = Count();
+  if(count == 0) return 0;
+  return (double)_sum.load(std::memory_order_relaxed) / count;
+}
+
+uint64_t LatencyHistogram::Percentile(double percentile) const{
+  uint64_t count = Count();
+  if(count == 0) return 0;
+
+  uint64_t target = (uint64_t)std::ceil(percentile / 100.0 * count);
+  target = std::max(target, (uint64_t)1);
+  uint64_t accumulated = 0;
+  for(int i = 0; i < BucketNum; i++){
+    accumulated += _buckets[i].load(std::memory_order_relaxed);
+    if(accumulated >= target){
+      return std::min(BucketValue(i), Max());
+    }
+  }
+  return Max();
+}
+
+int LatencyHistogram::BucketIndex(uint64_t value){
+  if(value < (uint64_t)SubBucketNum) return (int)value;
+
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - SubBucketBits;
+  if(shift >= MagnitudeNum) return BucketNum - 1;
+
+  int sub = (int)(value >> shift) - SubBucketNum;
+  return (shift + 1) * SubBucketNum + sub;
+}
+
+uint64_t LatencyHistogram::BucketValue(int index){
+  if(index < SubBucketNum) return index;
+
+  int shift = index / SubBucketNum - 1;
+  int sub = index % SubBucketNum;
+  uint64_t lower = (uint64_t)(sub + SubBucketNum) << shift;
+  return lower + (((uint64_t)1 << shift) >> 1);
+}
+
+LatencyStats::ThreadHistograms::ThreadHistograms(){
+  for(int i = 0; i < MaxStageNum; i++){
+    histograms[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+LatencyStats::ThreadHistograms::~ThreadHistograms(){
+  for(int i = 0; i < MaxStageNum; i++){
+    delete histograms[i].load(std::memory_order_relaxed);
+  }
+}
+
+LatencyStats::LatencyStats(){
+  for(int i = 0; i < MaxCounterNum; i++){
+    _counters[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+LatencyStats& LatencyStats::Instance(){
+  static LatencyStats instance;
+  return instance;
+}
+
+int LatencyStats::RegisterStage(const std::string& name){
+  std::lock_guard<std::mutex> lock(_mutex);
+  for(size_t i = 0; i < _stage_names.size(); i++){
+    if(_stage_names[i] == name) return i;
+  }
+  if(_stage_names.size() >= MaxStageNum) return -1;
+  _stage_names.push_back(name);
+  return _stage_names.size() - 1;
+}
+
+int LatencyStats::RegisterCounter(const std::string& name){
+  std::lock_guard<std::mutex> lock(_mutex);
+  for(size_t i = 0; i < _counter_names.size(); i++){
+    if(_counter_names[i] == name) return i;
+  }
+  if(_counter_names.size() >= MaxCounterNum) return -1;
+  _counter_names.push_back(name);
+  return _counter_names.size() - 1;
+}
+
+LatencyStats::ThreadHistograms* LatencyStats::GetThreadHistograms(){
+  // owned by LatencyStats, so the records are kept after the thread exits
+  thread_local ThreadHistograms* thread_histograms = nullptr;
+  if(!thread_histograms){
+    std::lock_guard<std::mutex> lock(_mutex);
+    _thread_histograms.emplace_back(new ThreadHistograms());
+    thread_histograms = _thread_histograms.back().get();
+  }
+  return thread_histograms;
+}
+
+void LatencyStats::Record(int stage_id, uint64_t value_us){
+  if(stage_id < 0 || stage_id >= MaxStageNum) return;
+  ThreadHistograms* thread_histograms = GetThreadHistograms();
+  LatencyHistogram* histogram = thread_histograms->histograms[stage_id].load(std::memory_order_acquire);
+  if(!histogram){
+    histogram = new LatencyHistogram();
+    thread_histograms->histograms[stage_id].store(histogram, std::memory_order_release);
+  }
+  histogram->Record(value_us);
+}
+
+void LatencyStats::Count(int counter_id, int64_t value){
+  if(counter_id < 0 || counter_id >= MaxCounterNum) return;
+  _counters[counter_id].fetch_add(value, std::memory_order_relaxed);
+}
+
+void LatencyStats::Summarize(std::vector<StageSummary>& stages, std::vector<std::pair<std::string, int64_t>>& counters){
+  std::lock_guard<std::mutex> lock(_mutex);
+  for(size_t i = 0; i < _stage_names.size(); i++){
+    LatencyHistogram merged;
+    for(auto& thread_histograms : _thread_histograms){
+      LatencyHistogram* histogram = thread_histograms->histograms[i].load(std::memory_order_acquire);
+      if(histogram) merged.Merge(*histogram);
+    }
+    if(merged.Count() == 0) continue;
+
+    StageSummary summary;
+    summary.name = _stage_names[i];
+    summary.count = merged.Count();
+    summary.mean = merged.Mean();
+    summary.p50 = merged.Percentile(50);
+    summary.p90 = merged.Percentile(90);
+    summary.p99 = merged.Percentile(99);
+    summary.max = merged.Max();
+    stages.push_back(summary);
+  }
+
+  for(size_t i = 0; i < _counter_names.size(); i++){
+    counters.emplace_back(_counter_names[i], _counters[i].load(std::memory_order_relaxed));
+  }
+}
+
+void LatencyStats::SaveToJson(const std::string& file_path){
+  std::vector<StageSummary> stages;
+  std::vector<std::pair<std::string, int64_t>> counters;
+  Summarize(stages, counters);
+
+  std::ofstream file(file_path);
+  if(!file.is_open()){
+    std::cout << "Can not open " << file_path << std::endl;
+    return;
+  }
+
+  file << std::fixed << std::setprecision(3);
+  file << "{\n  \"stages\": [\n";
+  for(size_t i = 0; i < stages.size(); i++){
+    const StageSummary& s = stages[i];
+    file << "    {\"name\": \"" << s.name << "\", \"count\": " << s.count << ", \"mean_ms\": " << s.mean / 1000.0
+         << ", \"p50_ms\": " << s.p50 / 1000.0 << ", \"p90_ms\": " << s.p90 / 1000.0 << ", \"p99_ms\": " << s.p99 / 1000.0
+         << ", \"max_ms\": " << s.max / 1000.0 << "}" << (i + 1 < stages.size() ? "," : "") << "\n";
+  }
+  file << "  ],\n  \"counters\": {\n";
+  for(size_t i = 0; i < counters.size(); i++){
+    file << "    \"" << counters[i].first << "\": " << counters[i].second << (i + 1 < counters.size() ? "," : "") << "\n";
+  }
+  file << "  }\n}\n";
+  file.close();
+}
+
+void LatencyStats::SaveToCsv(const std::string& file_path){
+  std::vector<StageSummary> stages;
+  std::vector<std::pair<std::string, int64_t>> counters;
+  Summarize(stages, counters);
+
+  std::ofstream file(file_path);
+  if(!file.is_open()){
+    std::cout << "Can not open " << file_path << std::endl;
+    return;
+  }
+
+  file << std::fixed << std::setprecision(3);
+  file << "stage,count,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n";
+  for(const StageSummary& s : stages){
+    file << s.name << "," << s.count << "," << s.mean / 1000.0 << "," << s.p50 / 1000.0 << ","
+         << s.p90 / 1000.0 << "," << s.p99 / 1000.0 << "," << s.max / 1000.0 << "\n";
+  }
+  file << "\ncounter,value\n";
+  for(auto& counter : counters){
+    file << counter.first << "," << counter.second << "\n";
+  }
+  file.close();
+}
+
+void LatencyStats::Print(){
+  std::vector<StageSummary> stages;
+  std::vector<std::pair<std::string, int64_t>> counters;
+  Summarize(stages, counters);
+
+  std::ios::fmtflags flags = std::cout.flags();
+  std::streamsize precision = std::cout.precision();
+  std::cout << std::fixed << std::setprecision(2);
+  for(const StageSummary& s : stages){
+    std::cout << s.name << ": count = " << s.count << ", p50 = " << s.p50 / 1000.0 << " ms, p90 = " << s.p90 / 1000.0
+              << " ms, p99 = " << s.p99 / 1000.0 << " ms, max = " << s.max / 1000.0 << " ms" << std::endl;
+  }
+  for(auto& counter : counters){
+    std::cout << counter.first << " = " << counter.second << std::endl;
+  }
+  std::cout.flags(flags);
+  std::cout.precision(precision);
+}
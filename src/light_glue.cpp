@@ -5,313 +5,330 @@
 #include "light_glue.h"
 
 #include <cfloat>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <fstream>
+#include <iostream>
 #include <opencv2/opencv.hpp>
 #include <unordered_map>
 #include <utility>
 
-using namespace tensorrt_log;
-using namespace tensorrt_buffer;
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
-SuperPointLightGlue::SuperPointLightGlue(const PointMatcherConfig &lightglue_config) : lightglue_config_(lightglue_config), engine_(nullptr) {
-  setReportableSeverity(Logger::Severity::kINTERNAL_ERROR);
+SuperPointLightGlue::SuperPointLightGlue(const PointMatcherConfig &lightglue_config) : lightglue_config_(lightglue_config), 
+    keypoints_0_num_(0), keypoints_1_num_(0), engine_(nullptr) {
 }
 
 bool SuperPointLightGlue::build() {
-  if (deserialize_engine()) {
-    return true;
+  InferenceEngineConfig engine_config;
+  engine_config.backend = lightglue_config_.backend;
+  engine_config.onnx_file = lightglue_config_.onnx_file;
+  engine_config.engine_file = lightglue_config_.engine_file;
+  engine_config.precision = TensorRTFP16;
+  engine_config.dla_core = lightglue_config_.dla_core;
+  engine_config.cpu_threads = lightglue_config_.cpu_threads;
+
+  // keypoints_0, keypoints_1, descriptors_0 and descriptors_1
+  const int max_batch_size = std::max(lightglue_config_.max_batch_size, 1);
+  for (int i = 0; i < 4; ++i) {
+    int dim = i < 2 ? 2 : 256;
+    engine_config.input_profiles.push_back(InputProfile(lightglue_config_.input_tensor_names[i], {1, 1, dim}, {1, 512, dim}, {max_batch_size, 1024, dim}));
   }
 
-  auto builder = TensorRTUniquePtr<nvinfer1::IBuilder>(nvinfer1::createInferBuilder(gLogger.getTRTLogger()));
-  if (!builder) {
-    return false;
-  }
+  engine_ = CreateInferenceEngine(engine_config);
+  if (engine_ && engine_->Build()) return true;
+  if (max_batch_size == 1) return false;
 
-  const auto explicit_batch = 1U << static_cast<uint32_t>(nvinfer1::NetworkDefinitionCreationFlag::kEXPLICIT_BATCH);
-  auto network = TensorRTUniquePtr<nvinfer1::INetworkDefinition>(builder->createNetworkV2(explicit_batch));
-  if (!network) {
-    return false;
-  }
-
-  auto config = TensorRTUniquePtr<nvinfer1::IBuilderConfig>(builder->createBuilderConfig());
-  if (!config) {
-    return false;
-  }
-
-  auto parser = TensorRTUniquePtr<nvonnxparser::IParser>(nvonnxparser::createParser(*network, gLogger.getTRTLogger()));
-  if (!parser) {
-    return false;
-  }
-
-  auto profile = builder->createOptimizationProfile();
-  if (!profile) {
-    return false;
-  }
-  profile->setDimensions(lightglue_config_.input_tensor_names[0].c_str(), nvinfer1::OptProfileSelector::kMIN, nvinfer1::Dims3(1, 1, 2));
-  profile->setDimensions(lightglue_config_.input_tensor_names[0].c_str(), nvinfer1::OptProfileSelector::kOPT, nvinfer1::Dims3(1, 512, 2));
-  profile->setDimensions(lightglue_config_.input_tensor_names[0].c_str(), nvinfer1::OptProfileSelector::kMAX, nvinfer1::Dims3(1, 1024, 2));
-
-  profile->setDimensions(lightglue_config_.input_tensor_names[1].c_str(), nvinfer1::OptProfileSelector::kMIN, nvinfer1::Dims3(1, 1, 2));
-  profile->setDimensions(lightglue_config_.input_tensor_names[1].c_str(), nvinfer1::OptProfileSelector::kOPT, nvinfer1::Dims3(1, 512, 2));
-  profile->setDimensions(lightglue_config_.input_tensor_names[1].c_str(), nvinfer1::OptProfileSelector::kMAX, nvinfer1::Dims3(1, 1024, 2));
-
-  profile->setDimensions(lightglue_config_.input_tensor_names[2].c_str(), nvinfer1::OptProfileSelector::kMIN, nvinfer1::Dims3(1, 1, 256));
-  profile->setDimensions(lightglue_config_.input_tensor_names[2].c_str(), nvinfer1::OptProfileSelector::kOPT, nvinfer1::Dims3(1, 512, 256));
-  profile->setDimensions(lightglue_config_.input_tensor_names[2].c_str(), nvinfer1::OptProfileSelector::kMAX, nvinfer1::Dims3(1, 1024, 256));
-
-  profile->setDimensions(lightglue_config_.input_tensor_names[3].c_str(), nvinfer1::OptProfileSelector::kMIN, nvinfer1::Dims3(1, 1, 256));
-  profile->setDimensions(lightglue_config_.input_tensor_names[3].c_str(), nvinfer1::OptProfileSelector::kOPT, nvinfer1::Dims3(1, 512, 256));
-  profile->setDimensions(lightglue_config_.input_tensor_names[3].c_str(), nvinfer1::OptProfileSelector::kMAX, nvinfer1::Dims3(1, 1024, 256));
+  // a model exported with a static batch axis can not be built with a batch profile
+  std::cout << "LightGlue can not be built for batches of " << max_batch_size << ", building it for single pairs" << std::endl;
+  lightglue_config_.max_batch_size = 1;
+  return build();
+}
 
-  config->addOptimizationProfile(profile);
+int SuperPointLightGlue::max_batch_size() const {
+  return std::max(lightglue_config_.max_batch_size, 1);
+}
 
-  auto constructed = construct_network(builder, network, config, parser);
-  if (!constructed) {
+bool SuperPointLightGlue::infer(const Eigen::Matrix2Xf &keypoints0, const FeatureSet &features0,
+                                const Eigen::Matrix2Xf &keypoints1, const FeatureSet &features1,
+                                Eigen::Matrix<int, Eigen::Dynamic, 2> &matches_index, Eigen::Matrix<float, Eigen::Dynamic, 1> &matches_score) {
+  assert(lightglue_config_.input_tensor_names.size() == 4);
+  if (!process_input(keypoints0, features0, keypoints1, features1)) {
     return false;
   }
 
-  auto profile_stream = makeCudaStream();
-  if (!profile_stream) {
+  if (!engine_->Run()) {
     return false;
   }
-  config->setProfileStream(*profile_stream);
 
-  TensorRTUniquePtr<nvinfer1::IHostMemory> plan{builder->buildSerializedNetwork(*network, *config)};
-  if (!plan) {
+  if (!process_output(matches_index, matches_score)) {
     return false;
   }
 
-  TensorRTUniquePtr<nvinfer1::IRuntime> runtime{nvinfer1::createInferRuntime(gLogger.getTRTLogger())};
-  if (!runtime) {
-    return false;
-  }
+  return true;
+}
 
-  engine_ = std::shared_ptr<nvinfer1::ICudaEngine>(runtime->deserializeCudaEngine(plan->data(), plan->size()));
-  if (!engine_) {
+bool SuperPointLightGlue::process_input(const Eigen::Matrix2Xf &keypoints0, const FeatureSet &features0,
+                                        const Eigen::Matrix2Xf &keypoints1, const FeatureSet &features1) {
+  keypoints_0_num_ = keypoints0.cols();
+  keypoints_1_num_ = keypoints1.cols();
+  float *keypoints_0_buffer = engine_->Input(lightglue_config_.input_tensor_names[0], {1, keypoints_0_num_, 2});
+  float *keypoints_1_buffer = engine_->Input(lightglue_config_.input_tensor_names[1], {1, keypoints_1_num_, 2});
+  float *descriptors_0_buffer = engine_->Input(lightglue_config_.input_tensor_names[2], {1, features0.Size(), 256});
+  float *descriptors_1_buffer = engine_->Input(lightglue_config_.input_tensor_names[3], {1, features1.Size(), 256});
+  if (!keypoints_0_buffer || !keypoints_1_buffer || !descriptors_0_buffer || !descriptors_1_buffer) {
     return false;
   }
 
-  save_engine();
+  // 1 x N x 2 and 1 x N x 256 tensors have the layout of the column-major 2 x N and 256 x N matrices
+  memcpy(keypoints_0_buffer, keypoints0.data(), keypoints0.size() * sizeof(float));
+  memcpy(keypoints_1_buffer, keypoints1.data(), keypoints1.size() * sizeof(float));
+  // compressed keyframe descriptors are decoded directly into the input
+  features0.DecodeDescriptors(descriptors_0_buffer);
+  features1.DecodeDescriptors(descriptors_1_buffer);
 
-  ASSERT(network->getNbInputs() == 4);
-  keypoints_0_dims_ = network->getInput(0)->getDimensions();
-  keypoints_1_dims_ = network->getInput(1)->getDimensions();
-  descriptors_0_dims_ = network->getInput(2)->getDimensions();
-  descriptors_1_dims_ = network->getInput(3)->getDimensions();
-  assert(keypoints_0_dims_.d[1] == -1);
-  assert(keypoints_1_dims_.d[1] == -1);
-  assert(descriptors_0_dims_.d[1] == -1);
-  assert(descriptors_1_dims_.d[1] == -1);
   return true;
 }
 
-bool SuperPointLightGlue::construct_network(TensorRTUniquePtr<nvinfer1::IBuilder> &builder, TensorRTUniquePtr<nvinfer1::INetworkDefinition> &network,
-                                            TensorRTUniquePtr<nvinfer1::IBuilderConfig> &config, TensorRTUniquePtr<nvonnxparser::IParser> &parser) const {
-  auto parsed = parser->parseFromFile(lightglue_config_.onnx_file.c_str(), static_cast<int>(gLogger.getReportableSeverity()));
-  if (!parsed) {
-    return false;
+// the row max of the vector lanes, the smallest column wins on ties
+inline void reduce_lanes(const float *lane_max, const int *lane_index, int lane_num, float &max_value, int &max_index) {
+  for (int k = 0; k < lane_num; ++k) {
+    if (lane_max[k] > max_value || (lane_max[k] == max_value && lane_index[k] < max_index)) {
+      max_value = lane_max[k];
+      max_index = lane_index[k];
+    }
   }
-  //    config->setMaxWorkspaceSize(512);
-  config->setFlag(nvinfer1::BuilderFlag::kFP16);
-  enableDLA(builder.get(), config.get(), lightglue_config_.dla_core);
-  return true;
 }
 
-bool SuperPointLightGlue::infer(const Eigen::Matrix<float, 258, Eigen::Dynamic> &features0, const Eigen::Matrix<float, 258, Eigen::Dynamic> &features1,
-                                Eigen::Matrix<int, Eigen::Dynamic, 2> &matches_index, Eigen::Matrix<float, Eigen::Dynamic, 1> &matches_score) {
-  if (!context_) {
-    context_ = TensorRTUniquePtr<nvinfer1::IExecutionContext>(engine_->createExecutionContext());
-    if (!context_) {
-      return false;
+// Argmax of every row and every column of the rows x cols row-major scores in one pass over the rows: the
+// row is scanned for its max (8 columns at a time with AVX2, 4 with SSE2 or NEON), and the running column maxima
+// are updated with the same loads. Ties are resolved to the smallest index as a sequential scan with '>' would do.
+void argmax_rows_and_cols(const float *scores, int rows, int cols, std::vector<int> &row_max_index,
+                          std::vector<float> &row_max_score, std::vector<int> &col_max_index,
+                          std::vector<float> &col_max_score) {
+  row_max_index.resize(rows);
+  row_max_score.resize(rows);
+  col_max_index.assign(cols, 0);
+  col_max_score.assign(cols, -FLT_MAX);
+  int *col_index = col_max_index.data();
+  float *col_score = col_max_score.data();
+
+  for (int row = 0; row < rows; ++row) {
+    const float *row_scores = scores + row * cols;
+    float max_value = -FLT_MAX;
+    int max_index = 0;
+    int col = 0;
+#if defined(__AVX2__)
+    if (cols >= 8) {
+      __m256 max8 = _mm256_set1_ps(-FLT_MAX);
+      __m256i index8 = _mm256_setzero_si256();
+      __m256i cols8 = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+      const __m256i step8 = _mm256_set1_epi32(8);
+      const __m256 row8 = _mm256_castsi256_ps(_mm256_set1_epi32(row));
+      for (; col + 8 <= cols; col += 8) {
+        __m256 value = _mm256_loadu_ps(row_scores + col);
+        __m256 greater = _mm256_cmp_ps(value, max8, _CMP_GT_OQ);
+        max8 = _mm256_blendv_ps(max8, value, greater);
+        index8 = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(index8), _mm256_castsi256_ps(cols8), greater));
+        cols8 = _mm256_add_epi32(cols8, step8);
+
+        __m256 col_max = _mm256_loadu_ps(col_score + col);
+        __m256 col_greater = _mm256_cmp_ps(value, col_max, _CMP_GT_OQ);
+        _mm256_storeu_ps(col_score + col, _mm256_blendv_ps(col_max, value, col_greater));
+        __m256 col_row = _mm256_loadu_ps(reinterpret_cast<const float *>(col_index + col));
+        _mm256_storeu_ps(reinterpret_cast<float *>(col_index + col), _mm256_blendv_ps(col_row, row8, col_greater));
+      }
+      alignas(32) float lane_max[8];
+      alignas(32) int lane_index[8];
+      _mm256_store_ps(lane_max, max8);
+      _mm256_store_si256(reinterpret_cast<__m256i *>(lane_index), index8);
+      reduce_lanes(lane_max, lane_index, 8, max_value, max_index);
+    }
+#elif defined(__SSE2__)
+    if (cols >= 4) {
+      __m128 max4 = _mm_set1_ps(-FLT_MAX);
+      __m128 index4 = _mm_setzero_ps();
+      __m128i cols4 = _mm_setr_epi32(0, 1, 2, 3);
+      const __m128i step4 = _mm_set1_epi32(4);
+      const __m128 row4 = _mm_castsi128_ps(_mm_set1_epi32(row));
+      for (; col + 4 <= cols; col += 4) {
+        __m128 value = _mm_loadu_ps(row_scores + col);
+        __m128 greater = _mm_cmpgt_ps(value, max4);
+        max4 = _mm_or_ps(_mm_and_ps(greater, value), _mm_andnot_ps(greater, max4));
+        index4 = _mm_or_ps(_mm_and_ps(greater, _mm_castsi128_ps(cols4)), _mm_andnot_ps(greater, index4));
+        cols4 = _mm_add_epi32(cols4, step4);
+
+        __m128 col_max = _mm_loadu_ps(col_score + col);
+        __m128 col_greater = _mm_cmpgt_ps(value, col_max);
+        _mm_storeu_ps(col_score + col, _mm_or_ps(_mm_and_ps(col_greater, value), _mm_andnot_ps(col_greater, col_max)));
+        __m128 col_row = _mm_loadu_ps(reinterpret_cast<const float *>(col_index + col));
+        _mm_storeu_ps(reinterpret_cast<float *>(col_index + col),
+                      _mm_or_ps(_mm_and_ps(col_greater, row4), _mm_andnot_ps(col_greater, col_row)));
+      }
+      alignas(16) float lane_max[4];
+      alignas(16) int lane_index[4];
+      _mm_store_ps(lane_max, max4);
+      _mm_store_ps(reinterpret_cast<float *>(lane_index), index4);
+      reduce_lanes(lane_max, lane_index, 4, max_value, max_index);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (cols >= 4) {
+      const uint32_t first_cols[4] = {0, 1, 2, 3};
+      float32x4_t max4 = vdupq_n_f32(-FLT_MAX);
+      uint32x4_t index4 = vdupq_n_u32(0);
+      uint32x4_t cols4 = vld1q_u32(first_cols);
+      const uint32x4_t step4 = vdupq_n_u32(4);
+      const uint32x4_t row4 = vdupq_n_u32(row);
+      for (; col + 4 <= cols; col += 4) {
+        float32x4_t value = vld1q_f32(row_scores + col);
+        uint32x4_t greater = vcgtq_f32(value, max4);
+        max4 = vbslq_f32(greater, value, max4);
+        index4 = vbslq_u32(greater, cols4, index4);
+        cols4 = vaddq_u32(cols4, step4);
+
+        float32x4_t col_max = vld1q_f32(col_score + col);
+        uint32x4_t col_greater = vcgtq_f32(value, col_max);
+        vst1q_f32(col_score + col, vbslq_f32(col_greater, value, col_max));
+        uint32x4_t col_row = vld1q_u32(reinterpret_cast<const uint32_t *>(col_index + col));
+        vst1q_u32(reinterpret_cast<uint32_t *>(col_index + col), vbslq_u32(col_greater, row4, col_row));
+      }
+      float lane_max[4];
+      int lane_index[4];
+      vst1q_f32(lane_max, max4);
+      vst1q_u32(reinterpret_cast<uint32_t *>(lane_index), index4);
+      reduce_lanes(lane_max, lane_index, 4, max_value, max_index);
+    }
+#endif
+    for (; col < cols; ++col) {
+      const float value = row_scores[col];
+      if (value > max_value) {
+        max_value = value;
+        max_index = col;
+      }
+      if (value > col_score[col]) {
+        col_score[col] = value;
+        col_index[col] = row;
+      }
     }
+    row_max_index[row] = max_index;
+    row_max_score[row] = max_value;
   }
+}
 
-  assert(engine_->getNbBindings() == 5);
-
-  const int keypoints_0_index = engine_->getBindingIndex(lightglue_config_.input_tensor_names[0].c_str());
-  const int keypoints_1_index = engine_->getBindingIndex(lightglue_config_.input_tensor_names[1].c_str());
-  const int descriptors_0_index = engine_->getBindingIndex(lightglue_config_.input_tensor_names[2].c_str());
-  const int descriptors_1_index = engine_->getBindingIndex(lightglue_config_.input_tensor_names[3].c_str());
-  //    const int scores_index = engine_->getBindingIndex(
-  //            lightglue_config_.output_tensor_names[0].c_str());
-
-  context_->setBindingDimensions(keypoints_0_index, nvinfer1::Dims3(1, features0.cols(), 2));
-  context_->setBindingDimensions(keypoints_1_index, nvinfer1::Dims3(1, features1.cols(), 2));
-  context_->setBindingDimensions(descriptors_0_index, nvinfer1::Dims3(1, features0.cols(), 256));
-  context_->setBindingDimensions(descriptors_1_index, nvinfer1::Dims3(1, features1.cols(), 256));
-  //    context_->setBindingDimensions(scores_index, nvinfer1::Dims3(1, features0.cols(), features1.cols()));
-
-  keypoints_0_dims_ = context_->getBindingDimensions(keypoints_0_index);
-  keypoints_1_dims_ = context_->getBindingDimensions(keypoints_1_index);
-  descriptors_0_dims_ = context_->getBindingDimensions(descriptors_0_index);
-  descriptors_1_dims_ = context_->getBindingDimensions(descriptors_1_index);
-  //    scores_dims_ = context_->getBindingDimensions(scores_index);
-
-  BufferManager buffers(engine_, 0, context_.get());
-
-  ASSERT(lightglue_config_.input_tensor_names.size() == 4);
-  if (!process_input(buffers, features0, features1)) {
-    return false;
+// mutual nearest neighbors with exp(score) > threshold, the scores are log-probabilities
+void filter_matches(const float *scores, int rows, int cols, std::vector<int> &row_max_index,
+                    std::vector<float> &row_max_score, std::vector<int> &col_max_index,
+                    std::vector<float> &col_max_score, Eigen::Matrix<int, Eigen::Dynamic, 2> &matches_index,
+                    Eigen::Matrix<float, Eigen::Dynamic, 1> &matches_score, float threshold = 0.1) {
+  argmax_rows_and_cols(scores, rows, cols, row_max_index, row_max_score, col_max_index, col_max_score);
+
+  // the mutual check leaves at most min(rows, cols) survivors, exp is only evaluated for them
+  int match_num = 0;
+  for (int row = 0; row < rows; ++row) {
+    if (col_max_index[row_max_index[row]] != row) {
+      row_max_index[row] = -1;
+      continue;
+    }
+    row_max_score[row] = std::exp(row_max_score[row]);
+    if (row_max_score[row] > threshold) {
+      match_num++;
+    } else {
+      row_max_index[row] = -1;
+    }
   }
 
-  buffers.copyInputToDevice();
-
-  bool status = context_->executeV2(buffers.getDeviceBindings().data());
-  if (!status) {
-    return false;
+  matches_index.resize(match_num, 2);
+  matches_score.resize(match_num, 1);
+  for (int row = 0, i = 0; row < rows; ++row) {
+    if (row_max_index[row] < 0) continue;
+    matches_index(i, 0) = row;
+    matches_index(i, 1) = row_max_index[row];
+    matches_score(i) = row_max_score[row];
+    i++;
   }
-  buffers.copyOutputToHost();
+}
 
-  if (!process_output(buffers, matches_index, matches_score)) {
+bool SuperPointLightGlue::process_output(Eigen::Matrix<int, Eigen::Dynamic, 2> &matches_index, Eigen::Matrix<float, Eigen::Dynamic, 1> &matches_score) {
+  const float *output_scores = engine_->Output(lightglue_config_.output_tensor_names[0]);
+  if (output_scores == nullptr) {
     return false;
   }
-
+  if (keypoints_0_num_ < 1 || keypoints_1_num_ < 1) {
+    matches_index.resize(0, 2);
+    matches_score.resize(0, 1);
+    return true;
+  }
+  filter_matches(output_scores, keypoints_0_num_, keypoints_1_num_, row_max_index_, row_max_score_, col_max_index_,
+                 col_max_score_, matches_index, matches_score);
   return true;
 }
 
-bool SuperPointLightGlue::process_input(const BufferManager &buffers, const Eigen::Matrix<float, 258, Eigen::Dynamic> &features0, const Eigen::Matrix<float, 258, Eigen::Dynamic> &features1) {
-  auto *keypoints_0_buffer = static_cast<float *>(buffers.getHostBuffer(lightglue_config_.input_tensor_names[0]));
-  auto *keypoints_1_buffer = static_cast<float *>(buffers.getHostBuffer(lightglue_config_.input_tensor_names[1]));
-  auto *descriptors_0_buffer = static_cast<float *>(buffers.getHostBuffer(lightglue_config_.input_tensor_names[2]));
-  auto *descriptors_1_buffer = static_cast<float *>(buffers.getHostBuffer(lightglue_config_.input_tensor_names[3]));
-
-  for (int colk0 = 0; colk0 < features0.cols(); ++colk0) {
-    for (int rowk0 = 0; rowk0 < 2; ++rowk0) {
-      keypoints_0_buffer[colk0 * 2 + rowk0] = features0(rowk0, colk0);
-    }
-  }
-
-//  *keypoints_0_buffer = features0.data()[0];
-
-
-  for (int colk1 = 0; colk1 < features1.cols(); ++colk1) {
-    for (int rowk1 = 0; rowk1 < 2; ++rowk1) {
-      keypoints_1_buffer[colk1 * 2 + rowk1] = features1(rowk1, colk1);
-    }
+bool SuperPointLightGlue::infer_batch(const Eigen::Matrix2Xf &keypoints0, const FeatureSet &features0,
+                                      const std::vector<Eigen::Matrix2Xf> &keypoints1,
+                                      const std::vector<const FeatureSet *> &features1,
+                                      std::vector<Eigen::Matrix<int, Eigen::Dynamic, 2>> &matches_index,
+                                      std::vector<Eigen::Matrix<float, Eigen::Dynamic, 1>> &matches_score) {
+  assert(lightglue_config_.input_tensor_names.size() == 4);
+  const int batch_size = features1.size();
+  if (batch_size < 1 || keypoints1.size() != features1.size()) {
+    return false;
   }
-
-//  *keypoints_1_buffer = features1.data()[0];
-
-  for (int cold0 = 0; cold0 < features0.cols(); ++cold0) {
-    for (int rowd0 = 2; rowd0 < features0.rows(); ++rowd0) {
-      descriptors_0_buffer[cold0 * 256 + (rowd0 - 2)] = features0(rowd0, cold0);
+  keypoints_0_num_ = keypoints0.cols();
+  keypoints_1_num_ = keypoints1[0].cols();
+  for (const Eigen::Matrix2Xf &keypoints : keypoints1) {
+    if (keypoints.cols() != keypoints_1_num_) {
+      return false;
     }
   }
-
-//  *descriptors_0_buffer = features0.data()[features0.cols() * 2];
-
-  for (int cold1 = 0; cold1 < features1.cols(); ++cold1) {
-    for (int rowd1 = 2; rowd1 < features1.rows(); ++rowd1) {
-      descriptors_1_buffer[cold1 * 256 + (rowd1 - 2)] = features1(rowd1, cold1);
-    }
+  if (keypoints_0_num_ < 1 || keypoints_1_num_ < 1) {
+    return false;
   }
 
-//  *descriptors_1_buffer = features1.data()[features1.cols() * 2];
-
-  return true;
-}
-
-void filter_matches(const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> &scores, Eigen::Matrix<int, Eigen::Dynamic, 2> &matches_index, Eigen::Matrix<float, Eigen::Dynamic, 1> &matches_score,
-                    float threshold = 0.1) {
-  std::vector<std::pair<int, float>> row_max;
-  row_max.resize(scores.rows());
-  for (int row = 0; row < scores.rows(); ++row) {
-    float max_value = -FLT_MAX;
-    for (int col = 0; col < scores.cols(); ++col) {
-      if (scores(row, col) > max_value) {
-        row_max[row] = std::make_pair(col, scores(row, col));
-        max_value = scores(row, col);
-      }
-    }
-//            Eigen::MatrixXd::Index max_row, max_col;
-//            float max_score = scores.block(row, 0, 1, scores.cols()).maxCoeff(&max_row, &max_col);
-//            row_max[row] = std::make_pair(max_col, max_score);
+  float *keypoints_0_buffer = engine_->Input(lightglue_config_.input_tensor_names[0], {batch_size, keypoints_0_num_, 2});
+  float *keypoints_1_buffer = engine_->Input(lightglue_config_.input_tensor_names[1], {batch_size, keypoints_1_num_, 2});
+  float *descriptors_0_buffer = engine_->Input(lightglue_config_.input_tensor_names[2], {batch_size, keypoints_0_num_, 256});
+  float *descriptors_1_buffer = engine_->Input(lightglue_config_.input_tensor_names[3], {batch_size, keypoints_1_num_, 256});
+  if (!keypoints_0_buffer || !keypoints_1_buffer || !descriptors_0_buffer || !descriptors_1_buffer) {
+    return false;
   }
 
-  std::vector<std::pair<int, float>> col_max;
-  col_max.resize(scores.cols());
-
-  for (int col = 0; col < scores.cols(); ++col) {
-    float max_value = -FLT_MAX;
-    for (int row = 0; row < scores.rows(); ++row) {
-      if (scores(row, col) > max_value) {
-        col_max[col] = std::make_pair(row, scores(row, col));
-        max_value = scores(row, col);
-      }
-    }
-//            Eigen::MatrixXd::Index max_row, max_col;
-//            float max_score = scores.block(0, col, scores.rows(), 1).maxCoeff(&max_row, &max_col);
-//            row_max[col] = std::make_pair(max_row, max_score);
-  }
-  std::vector<int> matches_index0_vec;
-  std::vector<int> matches_index1_vec;
-  std::vector<float> matches_score_vec;
-  for (int row = 0; row < row_max.size(); ++row) {
-    if (row == col_max[row_max[row].first].first) {
-      float score_exp = std::exp(row_max[row].second);
-      if (score_exp > threshold) {
-        matches_index0_vec.push_back(row);
-        matches_index1_vec.push_back(row_max[row].first);
-        matches_score_vec.push_back(score_exp);
-      }
-    }
+  // the query is decoded once and repeated for every pair of the batch
+  memcpy(keypoints_0_buffer, keypoints0.data(), keypoints0.size() * sizeof(float));
+  features0.DecodeDescriptors(descriptors_0_buffer);
+  const size_t keypoints_0_size = keypoints_0_num_ * 2;
+  const size_t descriptors_0_size = keypoints_0_num_ * 256;
+  for (int b = 1; b < batch_size; ++b) {
+    memcpy(keypoints_0_buffer + b * keypoints_0_size, keypoints_0_buffer, keypoints_0_size * sizeof(float));
+    memcpy(descriptors_0_buffer + b * descriptors_0_size, descriptors_0_buffer, descriptors_0_size * sizeof(float));
   }
-  matches_index.resize(matches_index0_vec.size(), 2);
-  matches_score.resize(matches_score_vec.size(), 1);
-  for (int i = 0; i < matches_index0_vec.size(); ++i) {
-    matches_index(i, 0) = matches_index0_vec[i];
-    matches_index(i, 1) = matches_index1_vec[i];
-    matches_score(i) = matches_score_vec[i];
+  const size_t keypoints_1_size = keypoints_1_num_ * 2;
+  const size_t descriptors_1_size = keypoints_1_num_ * 256;
+  for (int b = 0; b < batch_size; ++b) {
+    memcpy(keypoints_1_buffer + b * keypoints_1_size, keypoints1[b].data(), keypoints_1_size * sizeof(float));
+    features1[b]->DecodeDescriptors(descriptors_1_buffer + b * descriptors_1_size);
   }
-}
 
-bool SuperPointLightGlue::process_output(const BufferManager &buffers, Eigen::Matrix<int, Eigen::Dynamic, 2> &matches_index, Eigen::Matrix<float, Eigen::Dynamic, 1> &matches_score) {
-  auto *output_scores = static_cast<float *>(buffers.getHostBuffer(lightglue_config_.output_tensor_names[0]));
-  int scores_rows = keypoints_0_dims_.d[1];
-  int scores_cols = keypoints_1_dims_.d[1];
-  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> scores_matrix;
-  scores_matrix.resize(scores_rows, scores_cols);
-  for (int row = 0; row < scores_rows; ++row) {
-    for (int col = 0; col < scores_cols; ++col) {
-      scores_matrix(row, col) = output_scores[row * scores_cols + col];
-    }
+  if (!engine_->Run()) {
+    return false;
   }
-  filter_matches(scores_matrix, matches_index, matches_score);
-  return true;
-}
 
-void SuperPointLightGlue::save_engine() {
-  if (lightglue_config_.engine_file.empty()) return;
-  if (engine_ != nullptr) {
-    nvinfer1::IHostMemory *data = engine_->serialize();
-    std::ofstream file(lightglue_config_.engine_file, std::ios::binary);
-    ;
-    if (!file) return;
-    file.write(reinterpret_cast<const char *>(data->data()), data->size());
+  const float *output_scores = engine_->Output(lightglue_config_.output_tensor_names[0]);
+  if (output_scores == nullptr) {
+    return false;
   }
-}
-
-bool SuperPointLightGlue::deserialize_engine() {
-  std::ifstream file(lightglue_config_.engine_file, std::ios::binary);
-  if (file.is_open()) {
-    file.seekg(0, std::ifstream::end);
-    size_t size = file.tellg();
-    file.seekg(0, std::ifstream::beg);
-    char *model_stream = new char[size];
-    file.read(model_stream, size);
-    file.close();
-    nvinfer1::IRuntime *runtime = nvinfer1::createInferRuntime(gLogger);
-    if (runtime == nullptr) {
-      delete[] model_stream;
-      return false;
-    }
-    engine_ = std::shared_ptr<nvinfer1::ICudaEngine>(runtime->deserializeCudaEngine(model_stream, size));
-    if (engine_ == nullptr) {
-      delete[] model_stream;
-      return false;
-    }
-    delete[] model_stream;
-    return true;
+  matches_index.resize(batch_size);
+  matches_score.resize(batch_size);
+  const size_t scores_size = keypoints_0_num_ * keypoints_1_num_;
+  for (int b = 0; b < batch_size; ++b) {
+    filter_matches(output_scores + b * scores_size, keypoints_0_num_, keypoints_1_num_, row_max_index_, row_max_score_,
+                   col_max_index_, col_max_score_, matches_index[b], matches_score[b]);
   }
-  return false;
+  return true;
 }
@@ -4,6 +4,7 @@
 #include <float.h>
 #include <iostream>
 #include <numeric>
+#include <algorithm>
 
 #include "camera.h"
 #include "timer.h"
@@ -65,117 +66,211 @@ float AngleDiff(float& angle1, float& angle2){
   return std::min(d_angle_case1, d_angle_case2);
 }
 
-void AssignPointsToLines(std::vector<Eigen::Vector4d>& lines, Eigen::Matrix<float, 259, Eigen::Dynamic>& points, 
-    std::vector<std::map<int, double>>& relation){
-  Eigen::Array2Xd point_array = points.middleRows(1, 2).array().cast<double>();
-  Eigen::Array4Xd line_array = Eigen::Map<Eigen::Array4Xd, Eigen::Unaligned>(lines[0].data(), 4, lines.size());
-
-  Eigen::ArrayXd x = point_array.row(0);
-  Eigen::ArrayXd y = point_array.row(1); 
-
-  Eigen::ArrayXd x1 = line_array.row(0);
-  Eigen::ArrayXd y1 = line_array.row(1);
-  Eigen::ArrayXd x2 = line_array.row(2);
-  Eigen::ArrayXd y2 = line_array.row(3);
+void AssignPointsToLines(std::vector<Eigen::Vector4d>& lines, const Eigen::Matrix2Xf& points, 
+    const std::vector<int>* grid, int grid_cols, int grid_rows, double grid_width_inv, double grid_height_inv,
+    PointsOnLines& relation){
+  relation.Clear();
+  const int point_num = points.cols();
+  if(point_num < 1){
+    relation.offsets.assign(lines.size() + 1, 0);
+    return;
+  }
 
-  Eigen::ArrayXd A = y2 - y1;
-  Eigen::ArrayXd B = x1 - x2;
-  Eigen::ArrayXd C = x2 * y1 - x1 * y2;
-  Eigen::ArrayXd D = (A.square() + B.square()).sqrt();
+  // coordinates of the points in the cells a line overlaps, gathered so the distances are computed on packets
+  std::vector<int> candidates;
+  candidates.reserve(point_num);
+  Eigen::ArrayXd px(point_num), py(point_num), distance(point_num), side1(point_num), side2(point_num);
 
-  relation.clear();
-  relation.reserve(lines.size());
   for(int i = 0, line_num = lines.size(); i < line_num; i++){
-    std::map<int, double> points_on_line;
-    for(int j = 0, point_num = points.cols(); j < point_num; j++){
-      // filter by x, y
-      double lx1 = x1(i);
-      double ly1 = y1(i);
-      double lx2 = x2(i);
-      double ly2 = y2(i);
-      double px = x(j);
-      double py = y(j);
-      
-      double min_lx = lx1;
-      double max_lx = lx2;
-      double min_ly = ly1;
-      double max_ly = ly2;
-      if(lx1 > lx2) std::swap(min_lx, max_lx);
-      if(ly1 > ly2) std::swap(min_ly, max_ly);
-      if(px < min_lx - 3 || px > max_lx + 3 || py < min_ly - 3 || py > max_ly + 3) continue;
-
-      // check distance
-      float pl_distance = std::abs((A(i) * px + B(i) * py + C(i))) / D(i);
-      if(pl_distance > 3) continue;
+    const double lx1 = lines[i](0);
+    const double ly1 = lines[i](1);
+    const double lx2 = lines[i](2);
+    const double ly2 = lines[i](3);
+    const double min_lx = std::min(lx1, lx2) - 3;
+    const double max_lx = std::max(lx1, lx2) + 3;
+    const double min_ly = std::min(ly1, ly2) - 3;
+    const double max_ly = std::max(ly1, ly2) + 3;
+
+    // cells as in Frame::FindGrid, rounding and clamping keep the order so the range covers the dilated box
+    const int min_gx = std::min(std::max((int)std::round(min_lx * grid_width_inv), 0), grid_cols - 1);
+    const int max_gx = std::min(std::max((int)std::round(max_lx * grid_width_inv), 0), grid_cols - 1);
+    const double slope = (std::abs(lx2 - lx1) > 1e-6) ? (ly2 - ly1) / (lx2 - lx1) : 0;
+
+    candidates.clear();
+    for(int gx = min_gx; gx <= max_gx; gx++){
+      // a point within 3 pixels of the segment is within 3 pixels of its part over the column dilated by 3, so
+      // only the rows of the box of that part are walked, one more pixel is kept for the rounding
+      double min_y = min_ly, max_y = max_ly;
+      if(slope != 0){
+        const double cell_x1 = (gx == 0) ? min_lx : std::max((gx - 0.5) / grid_width_inv - 3, min_lx);
+        const double cell_x2 = (gx == grid_cols - 1) ? max_lx : std::min((gx + 0.5) / grid_width_inv + 3, max_lx);
+        const double y1 = ly1 + (cell_x1 - lx1) * slope;
+        const double y2 = ly1 + (cell_x2 - lx1) * slope;
+        min_y = std::max(std::min(y1, y2) - 4, min_ly);
+        max_y = std::min(std::max(y1, y2) + 4, max_ly);
+      }
+      const int min_gy = std::min(std::max((int)std::round(min_y * grid_height_inv), 0), grid_rows - 1);
+      const int max_gy = std::min(std::max((int)std::round(max_y * grid_height_inv), 0), grid_rows - 1);
+      for(int gy = min_gy; gy <= max_gy; gy++){
+        for(int j : grid[gx * grid_rows + gy]){
+          const double x = points(0, j);
+          const double y = points(1, j);
+          if(x < min_lx || x > max_lx || y < min_ly || y > max_ly) continue;
+          px(candidates.size()) = x;
+          py(candidates.size()) = y;
+          candidates.push_back(j);
+        }
+      }
+    }
+    const int n = candidates.size();
+    if(n < 1){
+      relation.FinishLine();
+      continue;
+    }
 
-      double side1 = std::pow((lx1 - px), 2) + std::pow((ly1 - py), 2);
-      double side2 = std::pow((lx2 - px), 2) + std::pow((ly2 - py), 2);
-      double line_side = std::pow(D(i), 2);
-      if(side1 <= 9 || side2 <= 9 || ((side1 < line_side + side2) && (side2 < line_side + side1))){
-        points_on_line[j] = pl_distance;
+    const double A = ly2 - ly1;
+    const double B = lx1 - lx2;
+    const double C = lx2 * ly1 - lx1 * ly2;
+    const double D = std::sqrt(A * A + B * B);
+    distance.head(n) = (A * px.head(n) + B * py.head(n) + C).abs() / D;
+    side1.head(n) = (px.head(n) - lx1).square() + (py.head(n) - ly1).square();
+    side2.head(n) = (px.head(n) - lx2).square() + (py.head(n) - ly2).square();
+
+    const double line_side = D * D;
+    for(int k = 0; k < n; k++){
+      float pl_distance = distance(k);
+      if(pl_distance > 3) continue;
+      if(side1(k) <= 9 || side2(k) <= 9 || ((side1(k) < line_side + side2(k)) && (side2(k) < line_side + side1(k)))){
+        relation.AddPoint(candidates[k], pl_distance);
       }
     }
-    relation.push_back(points_on_line);
+    relation.FinishLine();
   }
 }
 
-void MatchLines(const std::vector<std::map<int, double>>& points_on_line0, 
-    const std::vector<std::map<int, double>>& points_on_line1, const std::vector<cv::DMatch>& point_matches, 
-    size_t point_num0, size_t point_num1, std::vector<int>& line_matches){
-  size_t line_num0 = points_on_line0.size();
-  size_t line_num1 = points_on_line1.size();
-  line_matches.clear();
-  line_matches.resize(line_num0);
-  for(size_t i = 0; i < line_num0; i++){
-    line_matches[i] = -1;
+// scratch buffers of MatchLines, kept for each thread so the stereo matching and the tracking reuse them
+struct LineMatchingBuffers{
+  std::vector<int> line_offsets0, lines0;
+  std::vector<int> line_offsets1, lines1;
+  std::vector<std::pair<int, int>> votes;
+  std::vector<int> vote_offsets, sorted_votes, vote_num;
+  std::vector<int> row_max_value, row_max_location;
+  std::vector<int> col_max_value, col_max_location;
+};
+
+// the inverse of the relation, the lines of point k are lines[offsets[k], offsets[k+1]) in increasing order
+void AssignLinesToPoints(const PointsOnLines& points_on_lines, size_t point_num, 
+    std::vector<int>& offsets, std::vector<int>& lines){
+  offsets.assign(point_num + 1, 0);
+  for(const PointOnLine& point : points_on_lines.points){
+    offsets[point.index + 1]++;
   }
-  if(point_num0 == 0 || point_num1 == 0 || line_num0 == 0 || line_num1 == 0) return;
-
-  std::vector<std::vector<int>> assigned_lines0, assigned_lines1;
-  assigned_lines0.resize(point_num0);
-  assigned_lines1.resize(point_num1);
-  for(size_t i = 0; i < points_on_line0.size(); i++){
-    for(auto& kv : points_on_line0[i]){
-      assigned_lines0[kv.first].push_back(i);
-    }
+  for(size_t k = 0; k < point_num; k++){
+    offsets[k + 1] += offsets[k];
   }
-  
-  for(size_t i = 0; i < points_on_line1.size(); i++){
-    for(auto& kv : points_on_line1[i]){
-      assigned_lines1[kv.first].push_back(i);
+  lines.resize(points_on_lines.PointNum());
+  for(size_t i = 0; i < points_on_lines.LineNum(); i++){
+    for(const PointOnLine& point : points_on_lines[i]){
+      lines[offsets[point.index]++] = i;
     }
   }
+  for(size_t k = point_num; k > 0; k--){
+    offsets[k] = offsets[k - 1];
+  }
+  offsets[0] = 0;
+}
+
+void MatchLines(const PointsOnLines& points_on_line0, 
+    const PointsOnLines& points_on_line1, const std::vector<cv::DMatch>& point_matches, 
+    size_t point_num0, size_t point_num1, std::vector<int>& line_matches){
+  size_t line_num0 = points_on_line0.LineNum();
+  size_t line_num1 = points_on_line1.LineNum();
+  line_matches.assign(line_num0, -1);
+  if(point_num0 == 0 || point_num1 == 0 || line_num0 == 0 || line_num1 == 0) return;
 
-  // fill in matching matrix
-  Eigen::MatrixXi matching_matrix = Eigen::MatrixXi::Zero(line_num0, line_num1);
+  static thread_local LineMatchingBuffers buffers;
+  std::vector<int>& line_offsets0 = buffers.line_offsets0;
+  std::vector<int>& line_offsets1 = buffers.line_offsets1;
+  std::vector<int>& lines0 = buffers.lines0;
+  std::vector<int>& lines1 = buffers.lines1;
+  AssignLinesToPoints(points_on_line0, point_num0, line_offsets0, lines0);
+  AssignLinesToPoints(points_on_line1, point_num1, line_offsets1, lines1);
+
+  // one vote (l0, l1) for every point match on the lines l0 and l1, the entry (l0, l1) of the matching matrix 
+  // is the number of its votes
+  std::vector<std::pair<int, int>>& votes = buffers.votes;
+  std::vector<int>& vote_offsets = buffers.vote_offsets;
+  votes.clear();
+  vote_offsets.assign(line_num0 + 1, 0);
   for(auto& point_match : point_matches){
     int idx0 = point_match.queryIdx;
     int idx1 = point_match.trainIdx;
-
-    for(auto& l0 : assigned_lines0[idx0]){
-      for(auto& l1 : assigned_lines1[idx1]){
-        matching_matrix(l0, l1) += 1;
+    for(int k0 = line_offsets0[idx0]; k0 < line_offsets0[idx0 + 1]; k0++){
+      int l0 = lines0[k0];
+      for(int k1 = line_offsets1[idx1]; k1 < line_offsets1[idx1 + 1]; k1++){
+        votes.emplace_back(l0, lines1[k1]);
+        vote_offsets[l0 + 1]++;
       }
     }
   }
+  if(votes.empty()) return;
 
-  // find good matches
-  int line_match_num = 0;
-  std::vector<int> row_max_value(line_num0), col_max_value(line_num1);
-  std::vector<Eigen::VectorXi::Index> row_max_location(line_num0), col_max_location(line_num1);
+  // counting sort of the votes by l0, the votes of row l0 are sorted_votes[vote_offsets[l0], vote_offsets[l0+1])
   for(size_t i = 0; i < line_num0; i++){
-    row_max_value[i] = matching_matrix.row(i).maxCoeff(&row_max_location[i]);
+    vote_offsets[i + 1] += vote_offsets[i];
+  }
+  std::vector<int>& sorted_votes = buffers.sorted_votes;
+  sorted_votes.resize(votes.size());
+  for(auto& vote : votes){
+    sorted_votes[vote_offsets[vote.first]++] = vote.second;
+  }
+  for(size_t i = line_num0; i > 0; i--){
+    vote_offsets[i] = vote_offsets[i - 1];
   }
+  vote_offsets[0] = 0;
+
+  // maximums of the rows and the columns from the non-zero entries of each row, the rows are visited in order 
+  // and the lower column is taken on ties, so the first maximum is kept as Eigen's maxCoeff does
+  std::vector<int>& vote_num = buffers.vote_num;
+  std::vector<int>& row_max_value = buffers.row_max_value;
+  std::vector<int>& row_max_location = buffers.row_max_location;
+  std::vector<int>& col_max_value = buffers.col_max_value;
+  std::vector<int>& col_max_location = buffers.col_max_location;
+  vote_num.assign(line_num1, 0);
+  row_max_value.assign(line_num0, 0);
+  row_max_location.assign(line_num0, 0);
+  col_max_value.assign(line_num1, 0);
+  col_max_location.assign(line_num1, 0);
+  for(size_t l0 = 0; l0 < line_num0; l0++){
+    for(int k = vote_offsets[l0]; k < vote_offsets[l0 + 1]; k++){
+      vote_num[sorted_votes[k]]++;
+    }
+    for(int k = vote_offsets[l0]; k < vote_offsets[l0 + 1]; k++){
+      int l1 = sorted_votes[k];
+      int value = vote_num[l1];
+      if(value == 0) continue;
+      vote_num[l1] = 0;
+      if(value > row_max_value[l0] || (value == row_max_value[l0] && l1 < row_max_location[l0])){
+        row_max_value[l0] = value;
+        row_max_location[l0] = l1;
+      }
+      if(value > col_max_value[l1]){
+        col_max_value[l1] = value;
+        col_max_location[l1] = l0;
+      }
+    }
+  }
+
+  // find good matches
   for(size_t j = 0; j < line_num1; j++){
-    Eigen::VectorXi::Index col_max_location;
-    int col_max_val = matching_matrix.col(j).maxCoeff(&col_max_location);
-    if(col_max_val < 2 || row_max_location[col_max_location] != j) continue;
+    int col_max_val = col_max_value[j];
+    int col_max_loc = col_max_location[j];
+    if(col_max_val < 2 || row_max_location[col_max_loc] != j) continue;
 
-    float score = (float)(col_max_val * col_max_val) / std::min(points_on_line0[col_max_location].size(), points_on_line1[j].size());
+    float score = (float)(col_max_val * col_max_val) / std::min(points_on_line0[col_max_loc].size(), points_on_line1[j].size());
     if(score < 0.8) continue;
 
-    line_matches[col_max_location] = j;
-    line_match_num++;
+    line_matches[col_max_loc] = j;
   }
 }
 
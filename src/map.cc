@@ -18,6 +18,7 @@
 #include "g2o_optimization/g2o_optimization.h"
 #include "g2o_optimization/types.h"
 #include "timer.h"
+#include "latency_stats.h"
 
 Map::Map(): _imu_init(false), imu_init_stage(0){
 }
@@ -28,6 +29,15 @@ Map::Map(OptimizationConfig& backend_optimization_config, CameraPtr camera, RosP
 }
 
 void Map::InsertKeyframe(FramePtr frame){
+  std::unique_lock<std::mutex> lock(_map_mutex);
+  AddKeyframe(frame);
+  lock.unlock();
+
+  ProcessKeyframe(frame);
+}
+
+void Map::AddKeyframe(FramePtr frame){
+  LATENCY_SCOPE("map_add_keyframe");
   // insert keyframe to map
   int frame_id = frame->GetFrameId();
   _keyframes[frame_id] = frame;
@@ -107,16 +117,27 @@ void Map::InsertKeyframe(FramePtr frame){
     InsertMapline(mpl);
   }
 
-  // optimization
   if(_keyframes.size() < 2){
     imu_init_frame = frame;
-  }else{
-    LocalMapOptimization(frame);
-    if(!IMUInit() && _camera->UseIMU()){
-      InitializeIMU(frame);
-    }
   }
+}
+
+void Map::ProcessKeyframe(FramePtr frame, const std::atomic<bool>* abort_flag){
+  LATENCY_SCOPE("map_process_keyframe");
+  std::unique_lock<std::mutex> lock(_map_mutex);
+  if(frame->GetFrameId() == _keyframes.begin()->first) return;
+  lock.unlock();
+
+  LocalMapOptimization(frame, abort_flag);
+
+  lock.lock();
+  if(!IMUInit() && _camera->UseIMU()){
+    InitializeIMU(frame);
+  }
+}
 
+std::mutex& Map::GetMapMutex(){
+  return _map_mutex;
 }
 
 void Map::CheckAndDeleteMappoint(MappointPtr mpt){
@@ -200,9 +221,8 @@ bool Map::UppdateMapline(MaplinePtr mapline){
     int frame_id = kv.first;
     FramePtr frame = GetFramePtr(frame_id);
     if(!frame) continue;
-    std::map<int, double> points_on_line = frame->GetPointsOnLine(kv.second);
-    for(auto& point : points_on_line){
-      MappointPtr mpt = frame->GetMappoint(point.first);
+    for(const PointOnLine& point : frame->GetPointsOnLine(kv.second)){
+      MappointPtr mpt = frame->GetMappoint(point.index);
       if(mpt && mpt->IsValid()){
         points.push_back(mpt->GetPosition());
       }
@@ -427,10 +447,9 @@ bool Map::TriangulateMaplineByMappoints(MaplinePtr mapline){
     Eigen::Matrix3d Rcw = Twc.block<3, 3>(0, 0).transpose();
     Eigen::Vector3d tcw = -Rcw * Twc.block<3, 1>(0, 3);
 
-    std::map<int, double> points_on_line = frame->GetPointsOnLine(kv.second);
-    for(auto& pkv : points_on_line){
-      MappointPtr mpt = frame->GetMappoint(pkv.first);
-      if(!mpt || !mpt->IsValid() || point_id_set.count(mpt->GetId())>0 || pkv.second > 3) continue;
+    for(const PointOnLine& point : frame->GetPointsOnLine(kv.second)){
+      MappointPtr mpt = frame->GetMappoint(point.index);
+      if(!mpt || !mpt->IsValid() || point_id_set.count(mpt->GetId())>0 || point.distance > 3) continue;
       Eigen::Vector3d p = mpt->GetPosition();
       points.emplace_back(p(0), p(1), p(2));
       point_id_set.insert(mpt->GetId());
@@ -553,7 +572,10 @@ bool Map::UpdateMappointDescriptor(MappointPtr mappoint){
   return true;
 }
 
-void Map::LocalMapOptimization(FramePtr new_frame){
+void Map::LocalMapOptimization(FramePtr new_frame, const std::atomic<bool>* abort_flag){
+  // the problem is built from a snapshot of the map and solved without holding the map mutex, 
+  // so that the tracking thread is only blocked while collecting and writing back the data
+  std::unique_lock<std::mutex> lock(_map_mutex);
   int new_frame_id = new_frame->GetFrameId();  
 
   MapOfPoses poses;
@@ -753,8 +775,14 @@ void Map::LocalMapOptimization(FramePtr new_frame){
     }
   }
 
-  LocalmapOptimization(poses, points, lines, velocities, biases, camera_list, mono_point_constraints, 
-      stereo_point_constraints, mono_line_constraints, stereo_line_constraints, imu_constraints, Rwg, _backend_optimization_config);
+  lock.unlock();
+  {
+    LATENCY_SCOPE("local_map_optimization");
+    LocalmapOptimization(poses, points, lines, velocities, biases, camera_list, mono_point_constraints, 
+        stereo_point_constraints, mono_line_constraints, stereo_line_constraints, imu_constraints, Rwg, 
+        _backend_optimization_config, abort_flag);
+  }
+  lock.lock();
 
   // erase point outliers
   std::vector<std::pair<FramePtr, MappointPtr>> outliers;
@@ -948,7 +976,8 @@ void Map::SearchByProjection(FramePtr frame, std::vector<MappointPtr>& mappoints
   Eigen::Matrix4d pose = frame->GetPose();
   Eigen::Matrix3d Rwc = pose.block<3, 3>(0, 0);
   Eigen::Vector3d twc = pose.block<3, 1>(0, 3);
-  Eigen::Matrix<float, 259, Eigen::Dynamic>& features = frame->GetAllFeatures();
+  FeatureSet::Descriptors buffer;
+  const FeatureSet::Descriptors& descriptors = frame->GetAllFeatures().DecodedDescriptors(buffer);
   CameraPtr camera = frame->GetCamera();
   double image_width = camera->ImageWidth();
   double image_height = camera->ImageHeight();
@@ -978,7 +1007,7 @@ void Map::SearchByProjection(FramePtr frame, std::vector<MappointPtr>& mappoints
     int best_idx = -1;
     double second_dist = 4.0;
     for(auto& idx : candidate_ids){
-      double dist = DescriptorDistance(mpd_desc, features.block<256, 1>(3, idx));
+      double dist = DescriptorDistance(mpd_desc, descriptors.col(idx));
       if(dist < best_dist){
         second_dist = best_dist;
         best_dist = dist;
@@ -1242,7 +1271,8 @@ void Map::SaveMap(const std::string& map_root){
     }
     frame_lines.emplace_back(metadata);
     
-    Eigen::Matrix<float, 259, Eigen::Dynamic>& features = frame->GetAllFeatures();
+    // one line of track id, score, x, y and descriptor per feature
+    FeatureSet::PackedFeatures features = frame->GetAllFeatures().ToPacked();
     std::vector<int>& track_ids = frame->GetAllTrackIds();
     assert(features.cols() == track_ids.size());
     for(size_t i = 0; i < track_ids.size(); i++){
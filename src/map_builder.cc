@@ -16,22 +16,74 @@
 #include "camera.h"
 #include "frame.h"
 #include "point_matcher.h"
+#include "feature_log.h"
 #include "map.h"
 #include "g2o_optimization/g2o_optimization.h"
 #include "timer.h"
+#include "latency_stats.h"
 #include "debug.h"
 
-MapBuilder::MapBuilder(VisualOdometryConfigs& configs, ros::NodeHandle nh): _shutdown(false), _feature_thread_stop(false), 
-    _tracking_trhead_stop(false), _init(false), _insert_next_keyframe(false), _track_id(0), _line_track_id(0), _configs(configs){
+MapBuilder::MapBuilder(VisualOdometryConfigs& configs, ros::NodeHandle nh): _data_buffer(4), _tracking_data_buffer(6), 
+    _keyframe_buffer(3), _shutdown(false), _feature_thread_stop(false), _tracking_trhead_stop(false), 
+    _local_mapping_thread_stop(false), _abort_local_mapping(false), _dropped_input_frames(0), _dropped_tracking_frames(0), _init(false), _insert_next_keyframe(false), _track_id(0), _line_track_id(0), _configs(configs){
   _camera = std::shared_ptr<Camera>(new Camera(configs.camera_config_path));
   _preinteration_keyframe.SetNoiseAndWalk(_camera->GyrNoise(), _camera->AccNoise(), _camera->GyrWalk(), _camera->AccWalk());
-  _point_matcher = std::shared_ptr<PointMatcher>(new PointMatcher(configs.point_matcher_config));
-  _feature_detector = std::shared_ptr<FeatureDetector>(new FeatureDetector(configs.plnet_config));
+  _optimized_gyr_bias.setZero();
+  _optimized_acc_bias.setZero();
+  if(configs.feature_log_mode == FeatureLog::Mode::Record){
+    FeatureLogPtr feature_log = std::shared_ptr<FeatureLog>(new FeatureLog(configs.feature_log_path, FeatureLog::Mode::Record));
+    _point_matcher = std::shared_ptr<PointMatcher>(new PointMatcherRecorder(configs.point_matcher_config, feature_log));
+    _feature_detector = std::shared_ptr<FeatureDetector>(new FeatureDetectorRecorder(configs.plnet_config, feature_log));
+  }else if(configs.feature_log_mode == FeatureLog::Mode::Replay){
+    FeatureLogPtr feature_log = std::shared_ptr<FeatureLog>(new FeatureLog(configs.feature_log_path, FeatureLog::Mode::Replay));
+    _point_matcher = std::shared_ptr<PointMatcher>(new PointMatcherReplayer(feature_log));
+    _feature_detector = std::shared_ptr<FeatureDetector>(new FeatureDetectorReplayer(feature_log));
+  }else{
+    _point_matcher = std::shared_ptr<PointMatcher>(new PointMatcher(configs.point_matcher_config));
+    _feature_detector = std::shared_ptr<FeatureDetector>(new FeatureDetector(configs.plnet_config));
+  }
+  if(_configs.keyframe_config.projection_tracking && configs.feature_log_mode != 0){
+    // the projection depends on the progress of the tracking thread, so the point matcher calls would not replay
+    std::cout << "projection_tracking is disabled when recording or replaying the features" << std::endl;
+    _configs.keyframe_config.projection_tracking = 0;
+  }
+  if(_configs.input_policy != InputPolicy::BlockInput && configs.feature_log_mode != 0){
+    // the dropped frames depend on the thread timing and the records have no frame id, so a replay would give 
+    // the records to other frames than the recorded ones
+    std::cout << "input_policy is set to block the input when recording or replaying the features" << std::endl;
+    _configs.input_policy = InputPolicy::BlockInput;
+  }
+  if(configs.point_matcher_config.stereo_matcher){
+    _stereo_matcher = std::shared_ptr<StereoMatcher>(new StereoMatcher(configs.point_matcher_config, _camera));
+  }
   _ros_publisher = std::shared_ptr<RosPublisher>(new RosPublisher(configs.ros_publisher_config, nh));
   _map = std::shared_ptr<Map>(new Map(_configs.backend_optimization_config, _camera, _ros_publisher));
 
+  // rectified images may be referenced by the queues, the threads, the last keyframe and the publisher
+  const size_t image_pool_size = 32;
+  _image_pool = std::shared_ptr<ImagePool>(new ImagePool(_camera->ImageHeight(), _camera->ImageWidth(), CV_8UC1, image_pool_size));
+
+  if(configs.budget_controller_config.enable){
+    std::string log_path = ConcatenateFolderAndFileName(configs.saving_dir, "budget_controller.csv");
+    _budget_controller = std::shared_ptr<BudgetController>(
+        new BudgetController(configs.budget_controller_config, configs.plnet_config, log_path));
+  }
+
   _feature_thread = std::thread(boost::bind(&MapBuilder::ExtractFeatureThread, this));
   _tracking_thread = std::thread(boost::bind(&MapBuilder::TrackingThread, this));
+  _local_mapping_thread = std::thread(boost::bind(&MapBuilder::LocalMappingThread, this));
+}
+
+// prepend the imu data of a dropped frame, so the preinteration still covers the whole interval
+void MergeImuData(const ImuDataList& dropped_imu_data, ImuDataList& next_imu_data){
+  if(dropped_imu_data.empty()) return;
+  ImuDataList merged_imu_data = dropped_imu_data;
+  double last_time = dropped_imu_data.back().timestamp;
+  for(const ImuData& imu_data : next_imu_data){
+    // the batches of adjacent frames overlap
+    if(imu_data.timestamp > last_time) merged_imu_data.emplace_back(imu_data);
+  }
+  next_imu_data.swap(merged_imu_data);
 }
 
 bool MapBuilder::UseIMU(){
@@ -39,51 +91,75 @@ bool MapBuilder::UseIMU(){
 }
 
 void MapBuilder::AddInput(InputDataPtr data){
-  cv::Mat image_left_rect, image_right_rect;
-  _camera->UndistortImage(data->image_left, data->image_right, image_left_rect, image_right_rect);
+  // remap writes into the pooled buffers directly
+  cv::Mat image_left_rect = _image_pool->Acquire(data->image_left.rows, data->image_left.cols, data->image_left.type());
+  cv::Mat image_right_rect = _image_pool->Acquire(data->image_right.rows, data->image_right.cols, data->image_right.type());
+  {
+    LATENCY_SCOPE("undistortion");
+    _camera->UndistortImage(data->image_left, data->image_right, image_left_rect, image_right_rect);
+  }
   data->image_left = image_left_rect;
   data->image_right = image_right_rect;
 
-  while(_data_buffer.size() > 3 && !_shutdown){
-    usleep(2000);
+  if(_configs.input_policy == InputPolicy::BlockInput){
+    // block until the feature thread has room, return immediately after Stop()
+    _data_buffer.Push(data);
+  }else{
+    // no keyframe has been chosen before feature extraction, so any queued input can be dropped
+    bool latest_only = (_configs.input_policy == InputPolicy::LatestInputOnly);
+    int dropped_num = _data_buffer.PushDropping(data, latest_only, [](const InputDataPtr&){ return true; }, 
+        [](const InputDataPtr& dropped, const InputDataPtr& next){ MergeImuData(dropped->batch_imu_data, next->batch_imu_data); });
+    if(dropped_num > 0){
+      _dropped_input_frames += dropped_num;
+      LATENCY_COUNT("dropped_input_frames", dropped_num);
+    }
   }
-
-  _buffer_mutex.lock();
-  _data_buffer.push(data);
-  _buffer_mutex.unlock();
 }
 
 void MapBuilder::ExtractFeatureThread(){
-  while(!_shutdown || !_data_buffer.empty()){
-    if(_data_buffer.empty()){
-      usleep(2000);
-      continue;
+  InputDataPtr input_data;
+  while(_data_buffer.Pop(input_data)){
+    auto feature_start = std::chrono::steady_clock::now();
+    if(_budget_controller){
+      int max_keypoints;
+      float line_length_threshold;
+      _budget_controller->GetBudget(max_keypoints, line_length_threshold);
+      _feature_detector->SetDetectionBudget(max_keypoints, line_length_threshold);
     }
 
-    InputDataPtr input_data;
-    _buffer_mutex.lock();
-    input_data = _data_buffer.front();
-    _data_buffer.pop();
-    _buffer_mutex.unlock();
-
     int frame_id = input_data->index;
     double timestamp = input_data->time;
-    cv::Mat image_left_rect = input_data->image_left.clone();
-    cv::Mat image_right_rect = input_data->image_right.clone();
-
+    cv::Mat image_left_rect = input_data->image_left;
+    cv::Mat image_right_rect = input_data->image_right;
+
+    if(_configs.keyframe_config.projection_tracking && UseIMU()){
+      ImuDataList recent_imu_data = input_data->batch_imu_data;
+      MergeImuData(_motion_imu_data, recent_imu_data);
+      _motion_imu_data.swap(recent_imu_data);
+      // PredictPose never integrates over more than one second
+      auto first_recent = std::lower_bound(_motion_imu_data.begin(), _motion_imu_data.end(), timestamp - 2.0, 
+          [](const ImuData& imu_data, double t){ return imu_data.timestamp < t; });
+      _motion_imu_data.erase(_motion_imu_data.begin(), first_recent);
+    }
 
     // construct frame
     FramePtr frame = std::shared_ptr<Frame>(new Frame(frame_id, false, _camera, timestamp));
 
-    Eigen::Matrix<float, 259, Eigen::Dynamic> left_features, right_features; 
+    FeatureSet left_features, right_features; 
     std::vector<Eigen::Vector4d> left_lines, right_lines;
     std::vector<cv::DMatch> matches, stereo_matches;
     int good_stereo_point = 0;
     FrameType frame_type;
     if(!_init || _insert_next_keyframe){
-      Eigen::Matrix<float, 259, Eigen::Dynamic> junctions;
-      _feature_detector->Detect(image_left_rect, image_right_rect, left_features, right_features, left_lines, right_lines, junctions);
-      _point_matcher->MatchingPoints(left_features, right_features, stereo_matches, false);
+      FeatureSet junctions;
+      {
+        LATENCY_SCOPE("stereo_detection");
+        _feature_detector->Detect(image_left_rect, image_right_rect, left_features, right_features, left_lines, right_lines, junctions);
+      }
+      {
+        LATENCY_SCOPE("stereo_matching");
+        MatchStereoFeatures(left_features, right_features, stereo_matches);
+      }
       frame->AddLeftFeatures(left_features, left_lines);
       good_stereo_point = frame->AddRightFeatures(right_features, right_lines, stereo_matches);
       frame_type = _init ? FrameType::KeyFrame : FrameType::InitializationFrame;
@@ -91,20 +167,54 @@ void MapBuilder::ExtractFeatureThread(){
       frame->AddJunctions(junctions);
       // SaveLineDetectionResult(image_left_rect, left_lines, _configs.saving_dir, std::to_string(frame->GetFrameId()));
     }else{
-      _feature_detector->Detect(image_left_rect, left_features);
+      {
+        LATENCY_SCOPE("detection");
+        _feature_detector->Detect(image_left_rect, left_features);
+      }
       frame->AddLeftFeatures(left_features, left_lines);
       frame_type = FrameType::NormalFrame;
     }
 
+    bool point_matcher_matches = false;
     if(_init){
-      const Eigen::Matrix<float, 259, Eigen::Dynamic> features_last_keyframe = _last_keyframe_feature->GetAllFeatures();
-      _point_matcher->MatchingPoints(features_last_keyframe, left_features, matches, true);
-      int enough_match = AddKeyframeCheck(_last_keyframe_feature, frame, matches);
+      int enough_match = -1;
+      // a frame that is already detected as a keyframe is always matched by the point matcher below
+      if(_configs.keyframe_config.projection_tracking && frame_type == FrameType::NormalFrame){
+        int projection_match_num;
+        {
+          LATENCY_SCOPE("projection_matching");
+          projection_match_num = MatchByProjection(_last_keyframe_feature, frame, matches);
+        }
+        if(projection_match_num >= _configs.keyframe_config.min_projection_match){
+          enough_match = AddKeyframeCheck(_last_keyframe_feature, frame, matches);
+        }
+      }
+
+      // the projection only matches the triangulated points, so the keyframe decision and the matches of every
+      // keyframe are left to the point matcher, otherwise the tracks of the untriangulated points would be cut
+      if(enough_match != 2 || frame_type != FrameType::NormalFrame){
+        matches.clear();
+        const FeatureSet features_last_keyframe = _last_keyframe_feature->GetAllFeatures();
+        {
+          LATENCY_SCOPE("tracking_matching");
+          _point_matcher->MatchingPoints(features_last_keyframe, left_features, matches, true);
+        }
+        point_matcher_matches = true;
+        enough_match = AddKeyframeCheck(_last_keyframe_feature, frame, matches);
+      }else{
+        LATENCY_COUNT("projection_tracked_frames", 1);
+      }
 
       if(enough_match == 0){  // try to insert this frame as keyframe
         if(frame_type == FrameType::NormalFrame){
-          _feature_detector->Detect(image_right_rect, right_features);
-          _point_matcher->MatchingPoints(left_features, right_features, stereo_matches, false);
+          {
+            LATENCY_SCOPE("detection_right");
+            _feature_detector->DetectRight(image_right_rect, right_features);
+          }
+          {
+            LATENCY_SCOPE("stereo_matching");
+            MatchStereoFeatures(left_features, right_features, stereo_matches);
+          }
           good_stereo_point = frame->AddRightFeatures(right_features, right_lines, stereo_matches);
         }
 
@@ -134,50 +244,63 @@ void MapBuilder::ExtractFeatureThread(){
     tracking_data->frame_type = frame_type;
     tracking_data->ref_keyframe = _last_keyframe_feature;
     tracking_data->matches = matches;
+    tracking_data->point_matcher_matches = point_matcher_matches;
     tracking_data->input_data = input_data;
+    tracking_data->feature_time = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - feature_start).count() / 1000.0;
 
     if(frame_type != FrameType::NormalFrame){
       _last_keyframe_feature = frame;
     }
 
-    while(_tracking_data_buffer.size() > 5){
-      usleep(2000);
+    if(_configs.input_policy == InputPolicy::BlockInput){
+      _tracking_data_buffer.Push(tracking_data);
+    }else{
+      // keyframes and the initialization frame are never dropped
+      bool latest_only = (_configs.input_policy == InputPolicy::LatestInputOnly);
+      int dropped_num = _tracking_data_buffer.PushDropping(tracking_data, latest_only, 
+          [](const TrackingDataPtr& data){ return data->frame_type == FrameType::NormalFrame; },
+          [](const TrackingDataPtr& dropped, const TrackingDataPtr& next){ 
+              MergeImuData(dropped->input_data->batch_imu_data, next->input_data->batch_imu_data); });
+      if(dropped_num > 0){
+        _dropped_tracking_frames += dropped_num;
+        LATENCY_COUNT("dropped_tracking_frames", dropped_num);
+      }
     }
-
-    _tracking_mutex.lock();
-    _tracking_data_buffer.push(tracking_data);
-    _tracking_mutex.unlock();
   }  
 
+  // all input data have been processed, let the tracking thread drain its queue
+  _tracking_data_buffer.Shutdown();
+
   _stop_mutex.lock();
   _feature_thread_stop = true;
   _stop_mutex.unlock();
 }
 
 void MapBuilder::TrackingThread(){ 
-  while(!_shutdown || !_data_buffer.empty() || !_tracking_data_buffer.empty()){
-    if(_tracking_data_buffer.empty()){
-      usleep(2000);
-      continue;
-    }
-
-    TrackingDataPtr tracking_data;
-    _tracking_mutex.lock();
-    tracking_data = _tracking_data_buffer.front();
-    _tracking_data_buffer.pop();
-    _tracking_mutex.unlock();
-
+  TrackingDataPtr tracking_data;
+  while(_tracking_data_buffer.Pop(tracking_data)){
+    auto tracking_start = std::chrono::steady_clock::now();
     FramePtr frame = tracking_data->frame;
     FrameType frame_type = tracking_data->frame_type;
     FramePtr ref_keyframe = tracking_data->ref_keyframe;
     InputDataPtr input_data = tracking_data->input_data;
     std::vector<cv::DMatch> matches = tracking_data->matches;
 
+    // InsertKeyframe gives new track ids to the keypoints without matches, so a keyframe matched only by the
+    // projection of the triangulated points would cut the tracks of the others
+    if(frame_type == FrameType::KeyFrame && !tracking_data->point_matcher_matches){
+      std::cout << "Error: keyframe " << frame->GetFrameId() << " is not matched by the point matcher" << std::endl;
+      assert(false);
+    }
+
     double timestamp = input_data->time;
-    cv::Mat image_left_rect = input_data->image_left.clone();
-    cv::Mat image_right_rect = input_data->image_right.clone();
+    cv::Mat image_left_rect = input_data->image_left;
     ImuDataList batch_imu_data = input_data->batch_imu_data;
 
+    // the local BA of the local mapping thread runs without holding this lock
+    std::unique_lock<std::mutex> map_lock(_map->GetMapMutex());
+    int track_inliers = -1;
     if(frame_type == FrameType::InitializationFrame){
       Eigen::Matrix4d init_pose;
       init_pose << 1, 0, 0, 0, 0, 0, 1, 0, 0, -1, 0, 1, 0, 0, 0, 1;
@@ -193,51 +316,97 @@ void MapBuilder::TrackingThread(){
       _last_keyframe_tracking = frame;
       _last_tracked_frame = frame;
       _last_keyimage = image_left_rect;
+    }else{
+      // SaveTrackingResult(_last_keyimage, image_left_rect, ref_keyframe, frame, matches, _configs.saving_dir);
 
-      PublishFrame(frame, image_left_rect, frame_type, matches);
-      continue;
-    }
+      // IMU preinteration
+      _preinteration_keyframe.AddBatchData(batch_imu_data, ref_keyframe->GetTimestamp(), timestamp);
+      frame->SetIMUPreinteration(_preinteration_keyframe);
 
-    // SaveTrackingResult(_last_keyimage, image_left_rect, ref_keyframe, frame, matches, _configs.saving_dir);
+      track_inliers = TrackFrame(ref_keyframe, frame, matches, _preinteration_keyframe);
 
-    // IMU preinteration
-    _preinteration_keyframe.AddBatchData(batch_imu_data, ref_keyframe->GetTimestamp(), timestamp);
-    frame->SetIMUPreinteration(_preinteration_keyframe);
+      frame->SetPreviousFrame(ref_keyframe);
 
-    int track_inliers = TrackFrame(ref_keyframe, frame, matches, _preinteration_keyframe);
+      if(track_inliers > _configs.keyframe_config.lost_num_match){ 
+        _last_tracked_frame = frame;
+      }else{
+        LATENCY_COUNT("lost_frames", 1);
+      }
 
-    frame->SetPreviousFrame(ref_keyframe);
+      if(frame_type == FrameType::KeyFrame){
+        std::cout << "insert keyframe, id = " << frame->GetFrameId() << std::endl;
+        InsertKeyframe(frame);
+        // the feature thread already matches against the new keyframe, the previous one is only kept in the map
+        _last_keyframe_tracking->CompressDescriptors(_configs.keyframe_config.descriptor_precision);
+        _last_keyframe_tracking = frame;
+        _last_keyimage = image_left_rect;
+      }
+    }
 
-    if(track_inliers > _configs.keyframe_config.lost_num_match){ 
-      _last_tracked_frame = frame;
+    if(_configs.keyframe_config.projection_tracking){
+      bool good_tracking = (frame_type == FrameType::InitializationFrame) || 
+          (track_inliers >= _configs.keyframe_config.min_projection_match);
+      UpdateMotionPrior(frame, good_tracking);
     }
 
-    if(frame_type == FrameType::KeyFrame){
-      std::cout << "insert keyframe, id = " << frame->GetFrameId() << std::endl;
-      InsertKeyframe(frame);
-      _last_keyframe_tracking = frame;
-      _last_keyimage = image_left_rect;
+    {
+      LATENCY_SCOPE("publish");
+      PublishFrame(frame, image_left_rect, frame_type, matches);
+    }
+    map_lock.unlock();
+    LATENCY_COUNT("frames", 1);
+
+    if(_budget_controller && track_inliers >= 0){
+      double tracking_time = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - tracking_start).count() / 1000.0;
+      _budget_controller->Update(frame->GetFrameId(), tracking_data->feature_time, tracking_time, track_inliers);
     }
 
-    PublishFrame(frame, image_left_rect, frame_type, matches);
+    // hand the new keyframe over to the local mapping thread and interrupt the running local BA
+    if(frame_type != FrameType::NormalFrame){
+      _abort_local_mapping = true;
+      _keyframe_buffer.Push(frame);
+    }
   }  
 
+  // let the local mapping thread drain its queue
+  _keyframe_buffer.Shutdown();
+
   _stop_mutex.lock();
   _tracking_trhead_stop = true;
   _stop_mutex.unlock();
 }
 
+void MapBuilder::LocalMappingThread(){
+  FramePtr keyframe;
+  while(_keyframe_buffer.Pop(keyframe)){
+    // stop the optimization early if a newer keyframe is already waiting
+    _abort_local_mapping = !_keyframe_buffer.Empty();
+    _map->ProcessKeyframe(keyframe, &_abort_local_mapping);
+    LATENCY_COUNT("keyframes", 1);
+
+    std::unique_lock<std::mutex> map_lock(_map->GetMapMutex());
+    keyframe->GetBias(_optimized_gyr_bias, _optimized_acc_bias);
+    _track_id = _map->UpdateFrameTrackIds(_track_id);
+    _line_track_id = _map->UpdateFrameLineTrackIds(_line_track_id);
+  }
+
+  _stop_mutex.lock();
+  _local_mapping_thread_stop = true;
+  _stop_mutex.unlock();
+}
+
 int MapBuilder::TrackFrame(FramePtr ref_frame, FramePtr current_frame, std::vector<cv::DMatch>& matches, Preinteration& _preinteration){
   // line tracking
-  Eigen::Matrix<float, 259, Eigen::Dynamic>& ref_features = ref_frame->GetAllFeatures();
-  Eigen::Matrix<float, 259, Eigen::Dynamic>& current_features = current_frame->GetAllFeatures();
-  std::vector<std::map<int, double>> ref_points_on_lines = ref_frame->GetPointsOnLines();
-  std::vector<std::map<int, double>> current_points_on_lines = current_frame->GetPointsOnLines();
+  FeatureSet& ref_features = ref_frame->GetAllFeatures();
+  FeatureSet& current_features = current_frame->GetAllFeatures();
+  const PointsOnLines& ref_points_on_lines = ref_frame->GetPointsOnLines();
+  const PointsOnLines& current_points_on_lines = current_frame->GetPointsOnLines();
   std::vector<int> line_matches;
-  MatchLines(ref_points_on_lines, current_points_on_lines, matches, ref_features.cols(), current_features.cols(), line_matches);
+  MatchLines(ref_points_on_lines, current_points_on_lines, matches, ref_features.Size(), current_features.Size(), line_matches);
 
   std::vector<int> inliers(current_frame->FeatureNum(), -1);
-  std::vector<MappointPtr> matched_mappoints(current_features.cols(), nullptr);
+  std::vector<MappointPtr> matched_mappoints(current_features.Size(), nullptr);
   std::vector<MappointPtr>& ref_frame_mappoints = ref_frame->GetAllMappoints();
   for(auto& match : matches){
     int idx0 = match.queryIdx;
@@ -246,7 +415,11 @@ int MapBuilder::TrackFrame(FramePtr ref_frame, FramePtr current_frame, std::vect
     inliers[idx1] = ref_frame->GetTrackId(idx0);
   }
 
-  int num_inliers = FramePoseOptimization(ref_frame, current_frame, matched_mappoints, inliers, _preinteration);
+  int num_inliers;
+  {
+    LATENCY_SCOPE("frame_pose_optimization");
+    num_inliers = FramePoseOptimization(ref_frame, current_frame, matched_mappoints, inliers, _preinteration);
+  }
 
   // update track id
   if(num_inliers > _configs.keyframe_config.lost_num_match){
@@ -430,8 +603,8 @@ int MapBuilder::AddKeyframeCheck(FramePtr ref_keyframe, FramePtr current_frame,
   int match_num = matches.size();
   if(match_num < _configs.keyframe_config.min_num_match) return 0;
 
-  const Eigen::Matrix<float, 259, Eigen::Dynamic>& ref_features = ref_keyframe->GetAllFeatures();
-  const Eigen::Matrix<float, 259, Eigen::Dynamic>& current_features = current_frame->GetAllFeatures();
+  const FeatureSet& ref_features = ref_keyframe->GetAllFeatures();
+  const FeatureSet& current_features = current_frame->GetAllFeatures();
 
   float feature_tracking_thr = _configs.keyframe_config.tracking_point_rate;
   double ration_thr = _configs.keyframe_config.tracking_parallax_rate;
@@ -440,7 +613,7 @@ int MapBuilder::AddKeyframeCheck(FramePtr ref_keyframe, FramePtr current_frame,
     ration_thr *= 0.7;
   }
 
-  if((float)match_num/ref_features.cols() < feature_tracking_thr || (float)match_num/current_features.cols() < feature_tracking_thr || match_num < _configs.keyframe_config.max_num_match){
+  if((float)match_num/ref_features.Size() < feature_tracking_thr || (float)match_num/current_features.Size() < feature_tracking_thr || match_num < _configs.keyframe_config.max_num_match){
     return 1;
   }
 
@@ -449,8 +622,8 @@ int MapBuilder::AddKeyframeCheck(FramePtr ref_keyframe, FramePtr current_frame,
     int idx0 = matches[i].queryIdx;
     int idx1 = matches[i].trainIdx;
 
-    ref_keypoints.col(i) = ref_features.block<2, 1>(1, idx0);
-    current_keypoints.col(i) = current_features.block<2, 1>(1, idx1);
+    ref_keypoints.col(i) = ref_features.keypoints.col(idx0);
+    current_keypoints.col(i) = current_features.keypoints.col(idx1);
   }
 
 
@@ -465,6 +638,110 @@ int MapBuilder::AddKeyframeCheck(FramePtr ref_keyframe, FramePtr current_frame,
   return 2;
 }
 
+int MapBuilder::MatchByProjection(FramePtr ref_keyframe, FramePtr frame, std::vector<cv::DMatch>& matches){
+  matches.clear();
+  Eigen::Matrix4d Twc;
+  if(!PredictPose(ref_keyframe->GetFrameId(), frame->GetTimestamp(), Twc)) return 0;
+  // the tracking thread starts from its own prediction, the pose is only used for the projection
+  frame->SetPose(Twc);
+
+  std::vector<std::pair<int, MappointPtr>> good_projections;
+  std::map<int, int> ref_keypoint_indexes;
+  {
+    std::unique_lock<std::mutex> map_lock(_map->GetMapMutex());
+    std::vector<MappointPtr> mappoints = ref_keyframe->GetAllMappoints();
+    for(size_t i = 0; i < mappoints.size(); i++){
+      if(mappoints[i]) ref_keypoint_indexes[mappoints[i]->GetId()] = i;
+    }
+    _map->SearchByProjection(frame, mappoints, 1, good_projections);
+  }
+
+  // a keypoint may be the best candidate of several mappoints
+  std::vector<bool> matched(frame->FeatureNum(), false);
+  for(auto& kv : good_projections){
+    int idx = kv.first;
+    if(matched[idx]) continue;
+    matched[idx] = true;
+    matches.emplace_back(ref_keypoint_indexes[kv.second->GetId()], idx, 0);
+  }
+  return matches.size();
+}
+
+bool MapBuilder::PredictPose(int ref_keyframe_id, double timestamp, Eigen::Matrix4d& Twc){
+  MotionPrior prior;
+  {
+    std::unique_lock<std::mutex> lock(_motion_prior_mutex);
+    prior = _motion_prior;
+  }
+  // the mappoints of the reference keyframe are created by the tracking thread
+  if(!prior.valid || !prior.good_tracking || prior.keyframe_id != ref_keyframe_id) return false;
+  double dt = timestamp - prior.timestamp;
+  if(dt <= 0 || dt > 1.0) return false;
+
+  if(prior.imu_init){
+    Preinteration preinteration;
+    preinteration.SetBias(prior.gyr_bias, prior.acc_bias, false);
+    preinteration.AddBatchData(_motion_imu_data, prior.timestamp, timestamp);
+    if(preinteration.Valid()){
+      Eigen::Matrix4d Twb;
+      Eigen::Vector3d vwb;
+      preinteration.Predict(prior.Twb, prior.vwb, Twb, vwb);
+      Twc = Twb * _camera->CameraToBody();
+      return true;
+    }
+  }
+
+  // constant velocity model
+  Twc = prior.Twc;
+  double last_dt = prior.timestamp - prior.last_timestamp;
+  if(prior.last_timestamp < 0 || last_dt <= 0) return true;
+  Eigen::Matrix4d last_motion = prior.last_Twc.inverse() * prior.Twc;
+  Eigen::Vector3d rotation_vector;
+  SO3Log(last_motion.block<3, 3>(0, 0), rotation_vector);
+  double scale = dt / last_dt;
+  Eigen::Matrix4d motion = Eigen::Matrix4d::Identity();
+  Eigen::Matrix3d R;
+  SO3Exp(rotation_vector * scale, R);
+  motion.block<3, 3>(0, 0) = R;
+  motion.block<3, 1>(0, 3) = last_motion.block<3, 1>(0, 3) * scale;
+  Twc = prior.Twc * motion;
+  return true;
+}
+
+void MapBuilder::UpdateMotionPrior(FramePtr frame, bool good_tracking){
+  std::unique_lock<std::mutex> lock(_motion_prior_mutex);
+  _motion_prior.keyframe_id = _last_keyframe_tracking->GetFrameId();
+  _motion_prior.good_tracking = good_tracking;
+  if(!good_tracking){
+    // the velocity is not continued over a lost frame
+    _motion_prior.valid = false;
+    return;
+  }
+
+  if(_motion_prior.valid){
+    _motion_prior.last_timestamp = _motion_prior.timestamp;
+    _motion_prior.last_Twc = _motion_prior.Twc;
+  }else{
+    _motion_prior.last_timestamp = -1;
+  }
+  _motion_prior.valid = true;
+  _motion_prior.timestamp = frame->GetTimestamp();
+  _motion_prior.Twc = frame->GetPose();
+  _motion_prior.imu_init = UseIMU() && _map->IMUInit();
+  _motion_prior.Twb = frame->IMUPose();
+  _motion_prior.vwb = frame->GetVelocity();
+  frame->GetBias(_motion_prior.gyr_bias, _motion_prior.acc_bias);
+}
+
+void MapBuilder::MatchStereoFeatures(const FeatureSet& left_features, const FeatureSet& right_features, 
+    std::vector<cv::DMatch>& stereo_matches){
+  if(_stereo_matcher){
+    _stereo_matcher->MatchingPoints(left_features, right_features, stereo_matches);
+  }else{
+    _point_matcher->MatchingPoints(left_features, right_features, stereo_matches, false);
+  }
+}
+
 void MapBuilder::InsertKeyframe(FramePtr frame){
   // create new track id
   std::vector<int>& track_ids = frame->GetAllTrackIds();
@@ -482,16 +759,11 @@ void MapBuilder::InsertKeyframe(FramePtr frame){
     }
   }
 
-  // insert keyframe to map
-  _map->InsertKeyframe(frame); 
-
-  _track_id = _map->UpdateFrameTrackIds(_track_id);
-  _line_track_id = _map->UpdateFrameLineTrackIds(_line_track_id);
+  // insert keyframe to map, the local BA is done later in the local mapping thread
+  _map->AddKeyframe(frame); 
 
-  Eigen::Vector3d gyr_bias, acc_bias;
-  frame->GetBias(gyr_bias, acc_bias);
   _preinteration_keyframe.Reset();
-  _preinteration_keyframe.SetBias(gyr_bias, acc_bias, false);
+  _preinteration_keyframe.SetBias(_optimized_gyr_bias, _optimized_acc_bias, false);
 }
 
 void MapBuilder::PublishFrame(FramePtr frame, cv::Mat& image, FrameType frame_type, std::vector<cv::DMatch>& matches){
@@ -499,7 +771,7 @@ void MapBuilder::PublishFrame(FramePtr frame, cv::Mat& image, FrameType frame_ty
   double timestamp = frame->GetTimestamp();
   const std::vector<cv::KeyPoint>& keypoints = frame->GetAllKeypoints();
   const std::vector<Eigen::Vector4d>& lines = frame->GatAllLines();
-  const std::vector<std::map<int, double>>& points_on_lines = frame->GetPointsOnLines();
+  const PointsOnLines& points_on_lines = frame->GetPointsOnLines();
   std::vector<bool> inliers_feature_message;
   frame->GetInlierFlag(inliers_feature_message);
   const Eigen::Matrix4d& pose = frame->GetPose();
@@ -564,6 +836,9 @@ void MapBuilder::SaveMap(const std::string& map_root){
   boost::archive::binary_oarchive oa(ofs);
 
   _map->CheckMap();
+  if(_last_keyframe_tracking){
+    _last_keyframe_tracking->CompressDescriptors(_configs.keyframe_config.descriptor_precision);
+  }
 
   std::cout << "Map saveing..... " << std::endl;
   oa << _map;
@@ -575,12 +850,30 @@ void MapBuilder::Stop(){
   _stop_mutex.lock();
   _shutdown = true;
   _stop_mutex.unlock();
+  _data_buffer.Shutdown();
   _ros_publisher->ShutDown();
   _feature_thread.join();
   _tracking_thread.join();
+  _local_mapping_thread.join();
+}
+
+size_t MapBuilder::ImageAllocationCount(){
+  return _image_pool->AllocationCount();
+}
+
+void MapBuilder::PrintQueueStats(){
+  std::cout << "Input policy: " << _configs.input_policy << std::endl;
+  std::cout << "Dropped input frames: " << _dropped_input_frames << ", dropped tracking frames: " 
+            << _dropped_tracking_frames << std::endl;
+  std::cout << "Input queue occupancy: mean = " << _data_buffer.MeanSize() << ", max = " << _data_buffer.MaxSize() 
+            << " / " << _data_buffer.Capacity() << std::endl;
+  std::cout << "Tracking queue occupancy: mean = " << _tracking_data_buffer.MeanSize() << ", max = " 
+            << _tracking_data_buffer.MaxSize() << " / " << _tracking_data_buffer.Capacity() << std::endl;
+  std::cout << "Keyframe queue occupancy: mean = " << _keyframe_buffer.MeanSize() << ", max = " 
+            << _keyframe_buffer.MaxSize() << " / " << _keyframe_buffer.Capacity() << std::endl;
 }
 
 bool MapBuilder::IsStopped(){
-  bool have_stopped = (_feature_thread_stop && _tracking_trhead_stop);
+  bool have_stopped = (_feature_thread_stop && _tracking_trhead_stop && _local_mapping_thread_stop);
   return have_stopped;
 }
\ No newline at end of file
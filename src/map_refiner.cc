@@ -214,12 +214,16 @@ void MapRefiner::LoopDetection(FramePtr frame, DBoW2::WordIdToFeatures& word_fea
   const int GoodCandidateNum = group_vector.size() <= 5 ? group_vector.size() : 5; 
   std::vector<cv::DMatch> best_matches;
   FramePtr best_candidate;
-  const Eigen::Matrix<float, 259, Eigen::Dynamic>& query_features = frame->GetAllFeatures();
+  const FeatureSet& query_features = frame->GetAllFeatures();
+  std::vector<const FeatureSet*> candidate_features;
+  for(int i = 0; i < GoodCandidateNum; i++){
+    candidate_features.push_back(&group_vector[i].first->GetAllFeatures());
+  }
+  std::vector<std::vector<cv::DMatch>> candidate_matches;
+  _point_matcher->MatchingPointsBatch(query_features, candidate_features, candidate_matches, true);
   for(int i = 0; i < GoodCandidateNum; i++){
     FramePtr good_candidate = group_vector[i].first;
-    const Eigen::Matrix<float, 259, Eigen::Dynamic>& good_candidate_features = good_candidate->GetAllFeatures();
-    std::vector<cv::DMatch> matches;
-    _point_matcher->MatchingPoints(query_features, good_candidate_features, matches, true);
+    std::vector<cv::DMatch>& matches = candidate_matches[i];
     // if(matches.size() > 50){
     //   RelativatePoseEstimation(frame, word_features, good_candidate, matches, group_candidates);
     // }
@@ -722,13 +726,13 @@ void MapRefiner::MergeMaplines(){
     FramePtr frame = kv.second;
     const std::vector<MaplinePtr>& maplines = frame->GetAllMaplines();
 
-    const std::vector<std::map<int, double>>& points_on_lines = frame->GetPointsOnLines();
-    for(int i = 0; i < points_on_lines.size(); i++){
+    const PointsOnLines& points_on_lines = frame->GetPointsOnLines();
+    for(int i = 0; i < points_on_lines.LineNum(); i++){
       if(points_on_lines[i].empty()) continue;
 
-      for(const auto& points_and_distances : points_on_lines[i]){
+      for(const PointOnLine& point : points_on_lines[i]){
         MaplinePtr mpl = maplines[i];
-        MappointPtr mpt = frame->GetMappoint(points_and_distances.first);
+        MappointPtr mpt = frame->GetMappoint(point.index);
 
         if(mpt && mpl && _map->_mappoints.count(mpt->GetId())> 0 && _map->_maplines.count(mpl->GetId())>0 ){
           maplines_share_mappoint[mpt].insert(mpl->GetId());
@@ -966,11 +970,13 @@ void MapRefiner::BuildJunctionDatabase(){
   _map_mutex.lock();
   for(const auto& kv : _map->_keyframes){
     FramePtr frame = kv.second;
-    const Eigen::Matrix<float, 259, Eigen::Dynamic>& junctions = frame->GetJunctions();
+    const FeatureSet& junctions = frame->GetJunctions();
+    FeatureSet::Descriptors buffer;
+    const FeatureSet::Descriptors& descriptors = junctions.DecodedDescriptors(buffer);
     std::vector<Eigen::Matrix<float, 256, 1>> frame_feature;
-    frame_feature.reserve(junctions.cols());
-    for(int j = 0; j < junctions.cols(); j++){
-      frame_feature.emplace_back(junctions.block(3, j, 256, 1));
+    frame_feature.reserve(junctions.Size());
+    for(int j = 0; j < junctions.Size(); j++){
+      frame_feature.emplace_back(descriptors.col(j));
     }
     features.emplace_back(frame_feature);
 
@@ -985,7 +991,7 @@ void MapRefiner::BuildJunctionDatabase(){
   _map_mutex.lock();
   for(const auto& kv : _map->_keyframes){
     FramePtr frame = kv.second;
-    Eigen::Matrix<float, 259, Eigen::Dynamic> junctions = frame->GetJunctions();
+    const FeatureSet& junctions = frame->GetJunctions();
     DBoW2::WordIdToFeatures word_features; 
     DBoW2::BowVector bow_vector;
     std::vector<DBoW2::WordId> word_of_features;
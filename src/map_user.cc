@@ -106,7 +106,7 @@ void MapUser::LoadVocabulary(const std::string voc_path){
 bool MapUser::Relocalization(cv::Mat& image, Eigen::Matrix4d& pose){
   cv::Mat image_rect;
   _camera->UndistortImage(image, image_rect);
-  Eigen::Matrix<float, 259, Eigen::Dynamic> features, junctions;
+  FeatureSet features, junctions;
   std::vector<Eigen::Vector4d> feature_lines;
   _feature_detector->Detect(image_rect, features, feature_lines, junctions);
 
@@ -361,12 +361,16 @@ bool MapUser::Relocalization(cv::Mat& image, Eigen::Matrix4d& pose){
   std::vector<cv::DMatch> relocalization_matches;
   FramePtr relocalization_frame;
   const size_t GoodCandidateNum = std::min((size_t)3, group_vector.size());    
-  const Eigen::Matrix<float, 259, Eigen::Dynamic>& query_features = frame->GetAllFeatures();
+  const FeatureSet& query_features = frame->GetAllFeatures();
+  std::vector<const FeatureSet*> candidate_features;
+  for(size_t i = 0; i < GoodCandidateNum; i++){
+    candidate_features.push_back(&group_vector[i].first->GetAllFeatures());
+  }
+  std::vector<std::vector<cv::DMatch>> candidate_matches;
+  _point_matcher->MatchingPointsBatch(query_features, candidate_features, candidate_matches, true);
   for(size_t i = 0; i < GoodCandidateNum; i++){
     FramePtr good_candidate = group_vector[i].first;
-    const Eigen::Matrix<float, 259, Eigen::Dynamic>& good_candidate_features = good_candidate->GetAllFeatures();
-    std::vector<cv::DMatch> matches;
-    _point_matcher->MatchingPoints(query_features, good_candidate_features, matches, true);
+    std::vector<cv::DMatch>& matches = candidate_matches[i];
     if(matches.size() > relocalization_matches.size()){
       relocalization_matches = matches;
       relocalization_frame = good_candidate;
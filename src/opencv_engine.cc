@@ -0,0 +1,80 @@
+#include "opencv_engine.h"
+
+#include <iostream>
+#include <algorithm>
+#include <opencv2/core.hpp>
+
+OpenCVEngine::OpenCVEngine(const InferenceEngineConfig& config) : _config(config){
+}
+
+bool OpenCVEngine::Build(){
+  try{
+    _net = cv::dnn::readNetFromONNX(_config.onnx_file);
+  }catch(const cv::Exception& e){
+    std::cout << "Error in loading " << _config.onnx_file << ": " << e.what() << std::endl;
+    return false;
+  }
+  if(_net.empty()) return false;
+
+  _net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+  _net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+  _output_names = _net.getUnconnectedOutLayersNames();
+  // OpenCV DNN has no thread count per Net, this also changes every other OpenCV parallel loop of the process
+  if(_config.cpu_threads > 0){
+    if(cv::getNumThreads() != _config.cpu_threads){
+      std::cout << "OpenCV threads of the process set to " << _config.cpu_threads << " by " << _config.onnx_file << std::endl;
+    }
+    cv::setNumThreads(_config.cpu_threads);
+  }
+  return true;
+}
+
+float* OpenCVEngine::Input(const std::string& name, const std::vector<int>& shape){
+  size_t volume = 1;
+  for(int s : shape){
+    volume *= s;
+  }
+  std::vector<float>& buffer = _input_buffers[name];
+  if(buffer.size() < volume){
+    buffer.resize(volume);
+  }
+  if(_input_shapes.find(name) == _input_shapes.end()){
+    _input_names.push_back(name);
+  }
+  _input_shapes[name] = shape;
+  return buffer.data();
+}
+
+bool OpenCVEngine::Run(){
+  try{
+    for(const std::string& name : _input_names){
+      std::vector<int>& shape = _input_shapes[name];
+      cv::Mat blob(shape.size(), shape.data(), CV_32F, _input_buffers[name].data());
+      _net.setInput(blob, name);
+    }
+    _net.forward(_outputs, _output_names);
+  }catch(const cv::Exception& e){
+    std::cout << "Error in running " << _config.onnx_file << ": " << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int OpenCVEngine::OutputIndex(const std::string& name) const{
+  auto it = std::find(_output_names.begin(), _output_names.end(), name);
+  if(it == _output_names.end() || (it - _output_names.begin()) >= (int)_outputs.size()) return -1;
+  return it - _output_names.begin();
+}
+
+const float* OpenCVEngine::Output(const std::string& name){
+  int index = OutputIndex(name);
+  if(index < 0) return nullptr;
+  return _outputs[index].ptr<float>();
+}
+
+std::vector<int> OpenCVEngine::OutputShape(const std::string& name){
+  int index = OutputIndex(name);
+  if(index < 0) return std::vector<int>();
+  const cv::Mat& output = _outputs[index];
+  return std::vector<int>(output.size.p, output.size.p + output.dims);
+}
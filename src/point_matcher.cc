@@ -1,9 +1,13 @@
 #include "point_matcher.h"
 
+#include <map>
 #include <opencv2/opencv.hpp>
 
 
-PointMatcher::PointMatcher(const PointMatcherConfig& config) : _config(config){
+PointMatcher::PointMatcher() : _batch_enabled(false){
+}
+
+PointMatcher::PointMatcher(const PointMatcherConfig& config) : _config(config), _batch_enabled(config.max_batch_size > 1){
   if(_config.matcher == 0){ // lightglue
     _config.dla_core = -1;
     _config.input_tensor_names.push_back("keypoints_0");
@@ -16,6 +20,7 @@ PointMatcher::PointMatcher(const PointMatcherConfig& config) : _config(config){
     if (!_lightglue->build()){
       std::cout << "Erron lightglue building" << std::endl;
     }
+    _batch_enabled = _batch_enabled && _lightglue->max_batch_size() > 1;
   }else if(_config.matcher == 1){
     _config.dla_core = -1;
     _config.input_tensor_names.push_back("keypoints_0");
@@ -36,73 +41,136 @@ PointMatcher::PointMatcher(const PointMatcherConfig& config) : _config(config){
   }
 }
 
-void PointMatcher::NormalizeKeypoints(const Eigen::Matrix<float, 259, Eigen::Dynamic> &features, 
-                                      Eigen::Matrix<float, 259, Eigen::Dynamic>& normalized_features, 
+void PointMatcher::NormalizeKeypoints(const Eigen::Matrix2Xf &keypoints, 
+                                      Eigen::Matrix2Xf& normalized_keypoints, 
                                       int width, int height, float scale) {
-  normalized_features = features;
   float L_inv = 1.0 / std::max(width, height) * scale;
-  for (int col = 0; col < features.cols(); ++col) {
-    normalized_features(1, col) = (features(1, col) - width / 2) * L_inv;
-    normalized_features(2, col) = (features(2, col) - height / 2) * L_inv;
-  }
+  Eigen::Vector2f center(width / 2, height / 2);
+  normalized_keypoints = (keypoints.colwise() - center) * L_inv;
 }
 
-int PointMatcher::MatchingPoints(const Eigen::Matrix<float, 259, Eigen::Dynamic>& features0,
-                                  const Eigen::Matrix<float, 259, Eigen::Dynamic>& features1, 
+int PointMatcher::MatchingPoints(const FeatureSet& features0,
+                                  const FeatureSet& features1, 
                                   std::vector<cv::DMatch>& matches, bool outlier_rejection){
-  if(features0.cols() < 1 || features1.cols() < 1){
+  if(features0.Size() < 1 || features1.Size() < 1){
     return 0;
   }
 
-  Eigen::Matrix<float, 259, Eigen::Dynamic> normalized_features0, normalized_features1; 
+  Eigen::Matrix2Xf normalized_keypoints0, normalized_keypoints1; 
   float scale = _config.matcher ? 0.7 : 0.5;
-  NormalizeKeypoints(features0, normalized_features0, _config.image_width, _config.image_height, scale);
-  NormalizeKeypoints(features1, normalized_features1, _config.image_width, _config.image_height, scale);
+  NormalizeKeypoints(features0.keypoints, normalized_keypoints0, _config.image_width, _config.image_height, scale);
+  NormalizeKeypoints(features1.keypoints, normalized_keypoints1, _config.image_width, _config.image_height, scale);
 
   matches.clear();
-  std::vector<cv::Point> points0, points1;
   if(_config.matcher == 0){ // lightglue
     Eigen::Matrix<int, Eigen::Dynamic, 2> matches_index;
     Eigen::Matrix<float, Eigen::Dynamic, 1> matches_score;
-    _lightglue->infer(normalized_features0.bottomRows(258), normalized_features1.bottomRows(258), matches_index, matches_score);
-
-    for (size_t i = 0; i < matches_index.rows(); i++) {
-      matches.emplace_back(matches_index(i, 0), matches_index(i, 1), 1.0 - matches_score(i));
-      if(outlier_rejection){
-        points0.emplace_back(features0(1, matches_index(i, 0)), features0(2, matches_index(i, 0)));
-        points1.emplace_back(features1(1, matches_index(i, 1)), features1(2, matches_index(i, 1)));
-      }
-    }
+    _lightglue->infer(normalized_keypoints0, features0, normalized_keypoints1, features1, matches_index, matches_score);
+    LightGlueMatches(features0, features1, matches_index, matches_score, matches);
   }else if(_config.matcher == 1){ // superglue
     Eigen::VectorXi indices0, indices1;
     Eigen::VectorXd mscores0, mscores1;
-    _superglue->infer(normalized_features0, normalized_features1, indices0, indices1, mscores0, mscores1);
-    int num_match = 0;
-    std::vector<int> point_indexes;
+    _superglue->infer(normalized_keypoints0, features0, normalized_keypoints1, features1, indices0, indices1, mscores0, mscores1);
     for(size_t i = 0; i < indices0.size(); i++){
       if(indices0(i) < indices1.size() && indices0(i) >= 0 && indices1(indices0(i)) == i){
         double d = 1.0 - (mscores0[i] + mscores1[indices0[i]]) / 2.0;
         matches.emplace_back(i, indices0[i], d);
-        if(outlier_rejection){
-          points0.emplace_back(features0(1, i), features0(2, i));
-          points1.emplace_back(features1(1, indices0(i)), features1(2, indices0(i)));
-        }
       }
     }
   }
 
-  // reject outliers
-  if(outlier_rejection && matches.size() > 8){
-    std::vector<uchar> inliers;
-    cv::findFundamentalMat(points0, points1, cv::FM_RANSAC, 20, 0.99, inliers);
-    int j = 0;
-    for(int i = 0; i < matches.size(); i++){
-      if(inliers[i]){
-        matches[j++] = matches[i];
+  if(outlier_rejection){
+    RejectOutliers(features0, features1, matches);
+  }
+
+  return matches.size();
+}
+
+int PointMatcher::MatchingPointsBatch(const FeatureSet& features0, 
+    const std::vector<const FeatureSet*>& features1_list, 
+    std::vector<std::vector<cv::DMatch>>& matches_list, bool outlier_rejection){
+  const size_t candidate_num = features1_list.size();
+  matches_list.assign(candidate_num, std::vector<cv::DMatch>());
+  std::vector<bool> matched(candidate_num, false);
+
+  if(_batch_enabled && _lightglue && features0.Size() > 0){
+    Eigen::Matrix2Xf normalized_keypoints0; 
+    NormalizeKeypoints(features0.keypoints, normalized_keypoints0, _config.image_width, _config.image_height, 0.5);
+
+    // a batch needs the same number of keypoints in all candidates
+    std::map<int, std::vector<size_t>> size_groups;
+    for(size_t i = 0; i < candidate_num; i++){
+      if(features1_list[i]->Size() > 0) size_groups[features1_list[i]->Size()].push_back(i);
+    }
+
+    for(auto& kv : size_groups){
+      const std::vector<size_t>& group = kv.second;
+      for(size_t start = 0; start + 1 < group.size() && _batch_enabled; start += _config.max_batch_size){
+        size_t end = std::min(group.size(), start + _config.max_batch_size);
+        std::vector<const FeatureSet*> batch_features;
+        std::vector<Eigen::Matrix2Xf> batch_keypoints(end - start);
+        for(size_t k = start; k < end; k++){
+          batch_features.push_back(features1_list[group[k]]);
+          NormalizeKeypoints(features1_list[group[k]]->keypoints, batch_keypoints[k - start], 
+              _config.image_width, _config.image_height, 0.5);
+        }
+
+        std::vector<Eigen::Matrix<int, Eigen::Dynamic, 2>> matches_index;
+        std::vector<Eigen::Matrix<float, Eigen::Dynamic, 1>> matches_score;
+        if(!_lightglue->infer_batch(normalized_keypoints0, features0, batch_keypoints, batch_features, 
+            matches_index, matches_score)){
+          std::cout << "The point matcher does not accept batches, the candidates are matched one by one" << std::endl;
+          _batch_enabled = false;
+          break;
+        }
+
+        for(size_t k = start; k < end; k++){
+          size_t i = group[k];
+          LightGlueMatches(features0, *features1_list[i], matches_index[k - start], matches_score[k - start], matches_list[i]);
+          if(outlier_rejection){
+            RejectOutliers(features0, *features1_list[i], matches_list[i]);
+          }
+          matched[i] = true;
+        }
       }
     }
-    matches.resize(j);
   }
 
-  return matches.size();
-}
\ No newline at end of file
+  int match_num = 0;
+  for(size_t i = 0; i < candidate_num; i++){
+    if(!matched[i]){
+      MatchingPoints(features0, *features1_list[i], matches_list[i], outlier_rejection);
+    }
+    match_num += matches_list[i].size();
+  }
+  return match_num;
+}
+
+void PointMatcher::LightGlueMatches(const FeatureSet& features0, const FeatureSet& features1, 
+    const Eigen::Matrix<int, Eigen::Dynamic, 2>& matches_index, 
+    const Eigen::Matrix<float, Eigen::Dynamic, 1>& matches_score, std::vector<cv::DMatch>& matches){
+  matches.clear();
+  for (size_t i = 0; i < matches_index.rows(); i++) {
+    matches.emplace_back(matches_index(i, 0), matches_index(i, 1), 1.0 - matches_score(i));
+  }
+}
+
+void PointMatcher::RejectOutliers(const FeatureSet& features0, const FeatureSet& features1, 
+    std::vector<cv::DMatch>& matches){
+  if(matches.size() <= 8) return;
+  std::vector<cv::Point> points0, points1;
+  for(const cv::DMatch& match : matches){
+    points0.emplace_back(features0.keypoints(0, match.queryIdx), features0.keypoints(1, match.queryIdx));
+    points1.emplace_back(features1.keypoints(0, match.trainIdx), features1.keypoints(1, match.trainIdx));
+  }
+
+  std::vector<uchar> inliers;
+  cv::findFundamentalMat(points0, points1, cv::FM_RANSAC, 20, 0.99, inliers);
+  int j = 0;
+  for(int i = 0; i < matches.size(); i++){
+    if(inliers[i]){
+      matches[j++] = matches[i];
+    }
+  }
+  matches.resize(j);
+}
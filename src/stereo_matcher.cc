@@ -0,0 +1,105 @@
+#include "stereo_matcher.h"
+
+#include <cmath>
+#include <algorithm>
+
+StereoMatcher::StereoMatcher(const PointMatcherConfig& config, CameraPtr camera) :
+    _min_score(config.stereo_min_score), _ratio(config.stereo_ratio), _camera(camera){
+}
+
+void StereoMatcher::BuildRowIndex(const Eigen::Matrix2Xf& keypoints){
+  const int rows = std::max((int)_camera->ImageHeight(), 1);
+  const int n = keypoints.cols();
+
+  // counting sort by row
+  std::vector<int> point_rows(n);
+  _row_starts.assign(rows + 1, 0);
+  for(int i = 0; i < n; ++i){
+    point_rows[i] = std::min(std::max((int)keypoints(1, i), 0), rows - 1);
+    _row_starts[point_rows[i] + 1]++;
+  }
+  for(int r = 0; r < rows; ++r){
+    _row_starts[r + 1] += _row_starts[r];
+  }
+  std::vector<int> offsets(_row_starts.begin(), _row_starts.end() - 1);
+  _row_indexes.resize(n);
+  for(int i = 0; i < n; ++i){
+    _row_indexes[offsets[point_rows[i]]++] = i;
+  }
+
+  for(int r = 0; r < rows; ++r){
+    if(_row_starts[r + 1] - _row_starts[r] < 2) continue;
+    std::sort(_row_indexes.begin() + _row_starts[r], _row_indexes.begin() + _row_starts[r + 1],
+        [&keypoints](int a, int b){ return keypoints(0, a) < keypoints(0, b); });
+  }
+  _row_xs.resize(n);
+  for(int k = 0; k < n; ++k){
+    _row_xs[k] = keypoints(0, _row_indexes[k]);
+  }
+}
+
+int StereoMatcher::MatchingPoints(const FeatureSet& left_features, const FeatureSet& right_features,
+    std::vector<cv::DMatch>& matches){
+  matches.clear();
+  const int left_num = left_features.Size();
+  const int right_num = right_features.Size();
+  if(left_num < 1 || right_num < 1) return 0;
+
+  BuildRowIndex(right_features.keypoints);
+  const FeatureSet::Descriptors& left_descriptors = left_features.DecodedDescriptors(_left_descriptors);
+  const FeatureSet::Descriptors& right_descriptors = right_features.DecodedDescriptors(_right_descriptors);
+
+  const float min_x_diff = _camera->MinXDiff();
+  const float max_x_diff = _camera->MaxXDiff();
+  const float max_y_diff = _camera->MaxYDiff();
+  const int rows = _row_starts.size() - 1;
+
+  std::vector<int> best_right(left_num, -1);
+  std::vector<float> best_score(left_num, -1.0f);
+  std::vector<float> second_score(left_num, -1.0f);
+  std::vector<int> best_left(right_num, -1);
+  std::vector<float> best_left_score(right_num, -1.0f);
+
+  for(int i = 0; i < left_num; ++i){
+    const float x = left_features.keypoints(0, i);
+    const float y = left_features.keypoints(1, i);
+    const int row_min = std::max((int)std::floor(y - max_y_diff), 0);
+    const int row_max = std::min((int)std::floor(y + max_y_diff), rows - 1);
+    // the disparity x - x_right must be in (min_x_diff, max_x_diff) as in Frame::AddRightFeatures
+    const float x_min = x - max_x_diff;
+    const float x_max = x - min_x_diff;
+
+    for(int r = row_min; r <= row_max; ++r){
+      auto row_begin = _row_xs.begin() + _row_starts[r];
+      auto row_end = _row_xs.begin() + _row_starts[r + 1];
+      for(auto it = std::upper_bound(row_begin, row_end, x_min); it != row_end && *it < x_max; ++it){
+        const int j = _row_indexes[it - _row_xs.begin()];
+        if(std::abs(right_features.keypoints(1, j) - y) > max_y_diff) continue;
+
+        // fixed-size columns, so Eigen vectorizes the dot product
+        const float score = left_descriptors.col(i).dot(right_descriptors.col(j));
+        if(score > best_score[i]){
+          second_score[i] = best_score[i];
+          best_score[i] = score;
+          best_right[i] = j;
+        }else if(score > second_score[i]){
+          second_score[i] = score;
+        }
+        if(score > best_left_score[j]){
+          best_left_score[j] = score;
+          best_left[j] = i;
+        }
+      }
+    }
+  }
+
+  // the descriptors are normalized, so the squared distance is 2 - 2 * score
+  const float ratio_square = _ratio * _ratio;
+  for(int i = 0; i < left_num; ++i){
+    const int j = best_right[i];
+    if(j < 0 || best_left[j] != i || best_score[i] < _min_score) continue;
+    if((2.0f - 2.0f * best_score[i]) > ratio_square * (2.0f - 2.0f * second_score[i])) continue;
+    matches.emplace_back(i, j, 1.0f - best_score[i]);
+  }
+  return matches.size();
+}
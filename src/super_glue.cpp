@@ -4,243 +4,92 @@
 
 #include "super_glue.h"
 #include <cfloat>
+#include <cassert>
+#include <cstring>
 #include <utility>
 #include <unordered_map>
 #include <fstream>
 #include <opencv2/opencv.hpp>
 
-using namespace tensorrt_log;
-using namespace tensorrt_buffer;
-
-SuperGlue::SuperGlue(const PointMatcherConfig &superglue_config) : superglue_config_(superglue_config), engine_(nullptr) {
-    setReportableSeverity(Logger::Severity::kINTERNAL_ERROR);
-    // setReportableSeverity(Logger::Severity::kINFO);
+SuperGlue::SuperGlue(const PointMatcherConfig &superglue_config) : superglue_config_(superglue_config),
+    keypoints_0_num_(0), keypoints_1_num_(0), engine_(nullptr) {
 }
 
 bool SuperGlue::build() {
-    // cudaSetDevice(2);
-    if(deserialize_engine()){
-        return true;
-    }
-
-    auto builder = TensorRTUniquePtr<nvinfer1::IBuilder>(nvinfer1::createInferBuilder(gLogger.getTRTLogger()));
-    if (!builder) {
-        return false;
-    }
-
-    const auto explicit_batch = 1U << static_cast<uint32_t>(nvinfer1::NetworkDefinitionCreationFlag::kEXPLICIT_BATCH);
-    auto network = TensorRTUniquePtr<nvinfer1::INetworkDefinition>(builder->createNetworkV2(explicit_batch));
-    if (!network) {
-        return false;
-    }
-
-    auto config = TensorRTUniquePtr<nvinfer1::IBuilderConfig>(builder->createBuilderConfig());
-    if (!config) {
-        return false;
-    }
-
-    auto parser = TensorRTUniquePtr<nvonnxparser::IParser>(
-            nvonnxparser::createParser(*network, gLogger.getTRTLogger()));
-    if (!parser) {
-        return false;
-    }
-
-    auto profile = builder->createOptimizationProfile();
-    if (!profile) {
-        return false;
-    }
-    profile->setDimensions(superglue_config_.input_tensor_names[0].c_str(), nvinfer1::OptProfileSelector::kMIN, nvinfer1::Dims3(1, 1, 2));
-    profile->setDimensions(superglue_config_.input_tensor_names[0].c_str(), nvinfer1::OptProfileSelector::kOPT, nvinfer1::Dims3(1, 512, 2));
-    profile->setDimensions(superglue_config_.input_tensor_names[0].c_str(), nvinfer1::OptProfileSelector::kMAX,
-                           nvinfer1::Dims3(1, 1024, 2));
-    profile->setDimensions(superglue_config_.input_tensor_names[1].c_str(), nvinfer1::OptProfileSelector::kMIN, nvinfer1::Dims2(1, 1));
-    profile->setDimensions(superglue_config_.input_tensor_names[1].c_str(), nvinfer1::OptProfileSelector::kOPT, nvinfer1::Dims2(1, 512));
-    profile->setDimensions(superglue_config_.input_tensor_names[1].c_str(), nvinfer1::OptProfileSelector::kMAX, nvinfer1::Dims2(1, 1024));
-    profile->setDimensions(superglue_config_.input_tensor_names[2].c_str(), nvinfer1::OptProfileSelector::kMIN, nvinfer1::Dims3(1, 256, 1));
-    profile->setDimensions(superglue_config_.input_tensor_names[2].c_str(), nvinfer1::OptProfileSelector::kOPT,
-                           nvinfer1::Dims3(1, 256, 512));
-    profile->setDimensions(superglue_config_.input_tensor_names[2].c_str(), nvinfer1::OptProfileSelector::kMAX,
-                           nvinfer1::Dims3(1, 256, 1024));
-    profile->setDimensions(superglue_config_.input_tensor_names[3].c_str(), nvinfer1::OptProfileSelector::kMIN, nvinfer1::Dims3(1, 1, 2));
-    profile->setDimensions(superglue_config_.input_tensor_names[3].c_str(), nvinfer1::OptProfileSelector::kOPT, nvinfer1::Dims3(1, 512, 2));
-    profile->setDimensions(superglue_config_.input_tensor_names[3].c_str(), nvinfer1::OptProfileSelector::kMAX,
-                           nvinfer1::Dims3(1, 1024, 2));
-    profile->setDimensions(superglue_config_.input_tensor_names[4].c_str(), nvinfer1::OptProfileSelector::kMIN, nvinfer1::Dims2(1, 1));
-    profile->setDimensions(superglue_config_.input_tensor_names[4].c_str(), nvinfer1::OptProfileSelector::kOPT, nvinfer1::Dims2(1, 512));
-    profile->setDimensions(superglue_config_.input_tensor_names[4].c_str(), nvinfer1::OptProfileSelector::kMAX, nvinfer1::Dims2(1, 1024));
-    profile->setDimensions(superglue_config_.input_tensor_names[5].c_str(), nvinfer1::OptProfileSelector::kMIN, nvinfer1::Dims3(1, 256, 1));
-    profile->setDimensions(superglue_config_.input_tensor_names[5].c_str(), nvinfer1::OptProfileSelector::kOPT,
-                           nvinfer1::Dims3(1, 256, 512));
-    profile->setDimensions(superglue_config_.input_tensor_names[5].c_str(), nvinfer1::OptProfileSelector::kMAX,
-                           nvinfer1::Dims3(1, 256, 1024));
-    config->addOptimizationProfile(profile);
-
-    auto constructed = construct_network(builder, network, config, parser);
-    if (!constructed) {
-        return false;
-    }
-
-    auto profile_stream = makeCudaStream();
-    if (!profile_stream) {
-        return false;
-    }
-    config->setProfileStream(*profile_stream);
-
-    TensorRTUniquePtr<nvinfer1::IHostMemory> plan{builder->buildSerializedNetwork(*network, *config)};
-    if (!plan) {
-        return false;
-    }
-
-    TensorRTUniquePtr<nvinfer1::IRuntime> runtime{nvinfer1::createInferRuntime(gLogger.getTRTLogger())};
-    if (!runtime) {
-        return false;
-    }
-
-    engine_ = std::shared_ptr<nvinfer1::ICudaEngine>(runtime->deserializeCudaEngine(plan->data(), plan->size()));
-    if (!engine_) {
-        return false;
-    }
-
-    save_engine();
-
-    ASSERT(network->getNbInputs() == 6);
-    keypoints_0_dims_ = network->getInput(0)->getDimensions();
-    scores_0_dims_ = network->getInput(1)->getDimensions();
-    descriptors_0_dims_ = network->getInput(2)->getDimensions();
-    keypoints_1_dims_ = network->getInput(3)->getDimensions();
-    scores_1_dims_ = network->getInput(4)->getDimensions();
-    descriptors_1_dims_ = network->getInput(5)->getDimensions();
-    assert(keypoints_0_dims_.d[1] == -1);
-    assert(scores_0_dims_.d[1] == -1);
-    assert(descriptors_0_dims_.d[2] == -1);
-    assert(keypoints_1_dims_.d[1] == -1);
-    assert(scores_1_dims_.d[1] == -1);
-    assert(descriptors_1_dims_.d[2] == -1);
-    return true;
-}
-
-bool SuperGlue::construct_network(TensorRTUniquePtr<nvinfer1::IBuilder> &builder,
-                                  TensorRTUniquePtr<nvinfer1::INetworkDefinition> &network,
-                                  TensorRTUniquePtr<nvinfer1::IBuilderConfig> &config,
-                                  TensorRTUniquePtr<nvonnxparser::IParser> &parser) const {
-    auto parsed = parser->parseFromFile(superglue_config_.onnx_file.c_str(),
-                                        static_cast<int>(gLogger.getReportableSeverity()));
-    if (!parsed) {
-        return false;
-    }
-    // config->setMaxWorkspaceSize(512_MiB);
-    config->setFlag(nvinfer1::BuilderFlag::kFP16);
-    enableDLA(builder.get(), config.get(), superglue_config_.dla_core);
-    return true;
+    InferenceEngineConfig engine_config;
+    engine_config.backend = superglue_config_.backend;
+    engine_config.onnx_file = superglue_config_.onnx_file;
+    engine_config.engine_file = superglue_config_.engine_file;
+    engine_config.precision = TensorRTFP16;
+    engine_config.dla_core = superglue_config_.dla_core;
+    engine_config.cpu_threads = superglue_config_.cpu_threads;
+
+    // keypoints, scores and descriptors of the two images
+    for (int i = 0; i < 6; i += 3) {
+        const std::vector<std::string> &names = superglue_config_.input_tensor_names;
+        engine_config.input_profiles.push_back(InputProfile(names[i], {1, 1, 2}, {1, 512, 2}, {1, 1024, 2}));
+        engine_config.input_profiles.push_back(InputProfile(names[i + 1], {1, 1}, {1, 512}, {1, 1024}));
+        engine_config.input_profiles.push_back(InputProfile(names[i + 2], {1, 256, 1}, {1, 256, 512}, {1, 256, 1024}));
+    }
+
+    engine_ = CreateInferenceEngine(engine_config);
+    return engine_ && engine_->Build();
 }
 
-bool SuperGlue::infer(const Eigen::Matrix<float, 259, Eigen::Dynamic> &features0,
-                      const Eigen::Matrix<float, 259, Eigen::Dynamic> &features1,
+bool SuperGlue::infer(const Eigen::Matrix2Xf &keypoints0,
+                      const FeatureSet &features0,
+                      const Eigen::Matrix2Xf &keypoints1,
+                      const FeatureSet &features1,
                       Eigen::VectorXi &indices0,
                       Eigen::VectorXi &indices1,
                       Eigen::VectorXd &mscores0,
                       Eigen::VectorXd &mscores1) {
-    // Create RAII buffer manager object
-    if (!context_) {
-        context_ = TensorRTUniquePtr<nvinfer1::IExecutionContext>(engine_->createExecutionContext());
-        if (!context_) {
-            return false;
-    }
-    }
-
-    assert(engine_->getNbBindings() == 7);
-
-    const int keypoints_0_index = engine_->getBindingIndex(superglue_config_.input_tensor_names[0].c_str());
-    const int scores_0_index = engine_->getBindingIndex(superglue_config_.input_tensor_names[1].c_str());
-    const int descriptors_0_index = engine_->getBindingIndex(superglue_config_.input_tensor_names[2].c_str());
-    const int keypoints_1_index = engine_->getBindingIndex(superglue_config_.input_tensor_names[3].c_str());
-    const int scores_1_index = engine_->getBindingIndex(superglue_config_.input_tensor_names[4].c_str());
-    const int descriptors_1_index = engine_->getBindingIndex(superglue_config_.input_tensor_names[5].c_str());
-    const int output_score_index = engine_->getBindingIndex(superglue_config_.output_tensor_names[0].c_str());
-
-    context_->setBindingDimensions(keypoints_0_index, nvinfer1::Dims3(1, features0.cols(), 2));
-    context_->setBindingDimensions(scores_0_index, nvinfer1::Dims2(1, features0.cols()));
-    context_->setBindingDimensions(descriptors_0_index, nvinfer1::Dims3(1, 256, features0.cols()));
-    context_->setBindingDimensions(keypoints_1_index, nvinfer1::Dims3(1, features1.cols(), 2));
-    context_->setBindingDimensions(scores_1_index, nvinfer1::Dims2(1, features1.cols()));
-    context_->setBindingDimensions(descriptors_1_index, nvinfer1::Dims3(1, 256, features1.cols()));
-
-    keypoints_0_dims_ = context_->getBindingDimensions(keypoints_0_index);
-    scores_0_dims_ = context_->getBindingDimensions(scores_0_index);
-    descriptors_0_dims_ = context_->getBindingDimensions(descriptors_0_index);
-    keypoints_1_dims_ = context_->getBindingDimensions(keypoints_1_index);
-    scores_1_dims_ = context_->getBindingDimensions(scores_1_index);
-    descriptors_1_dims_ = context_->getBindingDimensions(descriptors_1_index);
-    output_scores_dims_ = context_->getBindingDimensions(output_score_index);
-
-    BufferManager buffers(engine_, 0, context_.get());
-
-    ASSERT(superglue_config_.input_tensor_names.size() == 6);
-    if (!process_input(buffers, features0, features1)) {
+    assert(superglue_config_.input_tensor_names.size() == 6);
+    if (!process_input(keypoints0, features0, keypoints1, features1)) {
         return false;
     }
 
-    buffers.copyInputToDevice();
-
-    bool status = context_->executeV2(buffers.getDeviceBindings().data());
-    if (!status) {
+    if (!engine_->Run()) {
         return false;
     }
-    buffers.copyOutputToHost();
 
     // Verify results
-    if (!process_output(buffers, indices0, indices1, mscores0, mscores1)) {
+    if (!process_output(indices0, indices1, mscores0, mscores1)) {
         return false;
     }
 
     return true;
 }
 
-bool SuperGlue::process_input(const BufferManager &buffers,
-                              const Eigen::Matrix<float, 259, Eigen::Dynamic> &features0,
-                              const Eigen::Matrix<float, 259, Eigen::Dynamic> &features1) {
-    auto *keypoints_0_buffer = static_cast<float *>(buffers.getHostBuffer(superglue_config_.input_tensor_names[0]));
-    auto *scores_0_buffer = static_cast<float *>(buffers.getHostBuffer(superglue_config_.input_tensor_names[1]));
-    auto *descriptors_0_buffer = static_cast<float *>(buffers.getHostBuffer(superglue_config_.input_tensor_names[2]));
-    auto *keypoints_1_buffer = static_cast<float *>(buffers.getHostBuffer(superglue_config_.input_tensor_names[3]));
-    auto *scores_1_buffer = static_cast<float *>(buffers.getHostBuffer(superglue_config_.input_tensor_names[4]));
-    auto *descriptors_1_buffer = static_cast<float *>(buffers.getHostBuffer(superglue_config_.input_tensor_names[5]));
-
-    for (int rows0 = 0; rows0 < 1; ++rows0) {
-        for (int cols0 = 0; cols0 < features0.cols(); ++cols0) {
-            scores_0_buffer[rows0 * features0.cols() + cols0] = features0(rows0, cols0);
-        }
-    }
-
-    for (int colk0 = 0; colk0 < features0.cols(); ++colk0) {
-        for (int rowk0 = 1; rowk0 < 3; ++rowk0) {
-            keypoints_0_buffer[colk0 * 2 + (rowk0 - 1)] = features0(rowk0, colk0);
-        }
-    }
-
-    for (int rowd0 = 3; rowd0 < features0.rows(); ++rowd0) {
-        for (int cold0 = 0; cold0 < features0.cols(); ++cold0) {
-            descriptors_0_buffer[(rowd0 - 3) * features0.cols() + cold0] = features0(rowd0, cold0);
-        }
+bool SuperGlue::process_input(const Eigen::Matrix2Xf &keypoints0,
+                              const FeatureSet &features0,
+                              const Eigen::Matrix2Xf &keypoints1,
+                              const FeatureSet &features1) {
+    const int n0 = features0.Size();
+    const int n1 = features1.Size();
+    keypoints_0_num_ = n0;
+    keypoints_1_num_ = n1;
+    float *keypoints_0_buffer = engine_->Input(superglue_config_.input_tensor_names[0], {1, n0, 2});
+    float *scores_0_buffer = engine_->Input(superglue_config_.input_tensor_names[1], {1, n0});
+    float *descriptors_0_buffer = engine_->Input(superglue_config_.input_tensor_names[2], {1, 256, n0});
+    float *keypoints_1_buffer = engine_->Input(superglue_config_.input_tensor_names[3], {1, n1, 2});
+    float *scores_1_buffer = engine_->Input(superglue_config_.input_tensor_names[4], {1, n1});
+    float *descriptors_1_buffer = engine_->Input(superglue_config_.input_tensor_names[5], {1, 256, n1});
+    if (!keypoints_0_buffer || !scores_0_buffer || !descriptors_0_buffer ||
+        !keypoints_1_buffer || !scores_1_buffer || !descriptors_1_buffer) {
+        return false;
     }
 
-    for (int rows1 = 0; rows1 < 1; ++rows1) {
-        for (int cols1 = 0; cols1 < features1.cols(); ++cols1) {
-            scores_1_buffer[rows1 * features1.cols() + cols1] = features1(rows1, cols1);
-        }
-    }
+    typedef Eigen::Map<Eigen::Matrix<float, 256, Eigen::Dynamic, Eigen::RowMajor>> DescriptorBuffer;
+    FeatureSet::Descriptors decoded_descriptors0, decoded_descriptors1;
 
-    for (int colk1 = 0; colk1 < features1.cols(); ++colk1) {
-        for (int rowk1 = 1; rowk1 < 3; ++rowk1) {
-            keypoints_1_buffer[colk1 * 2 + (rowk1 - 1)] = features1(rowk1, colk1);
-        }
-    }
+    memcpy(scores_0_buffer, features0.scores.data(), features0.scores.size() * sizeof(float));
+    memcpy(keypoints_0_buffer, keypoints0.data(), keypoints0.size() * sizeof(float));
+    DescriptorBuffer(descriptors_0_buffer, 256, n0) = features0.DecodedDescriptors(decoded_descriptors0);
 
-    for (int rowd1 = 3; rowd1 < features1.rows(); ++rowd1) {
-        for (int cold1 = 0; cold1 < features1.cols(); ++cold1) {
-            descriptors_1_buffer[(rowd1 - 3) * features1.cols() + cold1] = features1(rowd1, cold1);
-        }
-    }
+    memcpy(scores_1_buffer, features1.scores.data(), features1.scores.size() * sizeof(float));
+    memcpy(keypoints_1_buffer, keypoints1.data(), keypoints1.size() * sizeof(float));
+    DescriptorBuffer(descriptors_1_buffer, 256, n1) = features1.DecodedDescriptors(decoded_descriptors1);
 
     return true;
 }
@@ -336,7 +185,7 @@ void and_gather(const int *mutual1, const int *valid0, const int *indices1, int
     }
 }
 
-void decode(float *scores, int h, int w, std::vector<int> &indices0, std::vector<int> &indices1,
+void decode(const float *scores, int h, int w, std::vector<int> &indices0, std::vector<int> &indices1,
             std::vector<float> &mscores0, std::vector<float> &mscores1) {
     auto *max_indices0 = new int[h - 1];
     auto *max_indices1 = new int[w - 1];
@@ -366,76 +215,7 @@ void decode(float *scores, int h, int w, std::vector<int> &indices0, std::vector
     delete[] valid1;
 }
 
-void log_sinkhorn_iterations(float *couplings, float *Z, int m, int n,
-                             float *log_mu, float *log_nu, int iters) {
-  auto *u = new float[m]();
-  auto *v = new float[n]();
-  for (int k = 0; k < iters; ++k) {
-    for (int ki = 0; ki < m; ++ki) {
-      float nu_expsum = 0.0;
-      for (int kn = 0; kn < n; ++kn) {
-        nu_expsum += std::exp(couplings[ki * n + kn] + v[kn]);
-      }
-      u[ki] = log_mu[ki] - std::log(nu_expsum);
-    }
-    for (int kj = 0; kj < n; ++kj) {
-      float nu_expsum = 0.0;
-      for (int km = 0; km < m; ++km) {
-        nu_expsum += std::exp(couplings[km * n + kj] + u[km]);
-      }
-      v[kj] = log_nu[kj] - std::log(nu_expsum);
-    }
-  }
-
-  for (int i = 0; i < m; ++i) {
-    for (int j = 0; j < n; ++j) {
-      Z[i * n + j] = couplings[i * n + j] + u[i] + v[j];
-    }
-  }
-  delete[] u;
-  delete[] v;
-}
-
-void log_optimal_transport(float *scores, float *Z, int m, int n,
-                           float alpha = 2.3457, int iters = 100) {
-  auto *couplings = new float[(m + 1) * (n + 1)];
-  for (int i = 0; i < m + 1; ++i) {
-    for (int j = 0; j < n + 1; ++j) {
-      if (i == m || j == n) {
-        couplings[i * (n + 1) + j] = alpha;
-      } else {
-        couplings[i * (n + 1) + j] = scores[i * n + j];
-      }
-    }
-  }
-
-  float norm = -std::log(m + n);
-
-  auto *log_mu = new float[m + 1];
-  auto *log_nu = new float[n + 1];
-  for (int ii = 0; ii < m; ++ii) {
-    log_mu[ii] = norm;
-  }
-  log_mu[m] = std::log(n) + norm;
-
-  for (int jj = 0; jj < n; ++jj) {
-    log_nu[jj] = norm;
-  }
-  log_nu[n] = std::log(m) + norm;
-
-  log_sinkhorn_iterations(couplings, Z, m + 1, n + 1, log_mu, log_nu, iters);
-  for (int ii = 0; ii < m + 1; ++ii) {
-    for (int jj = 0; jj < n + 1; ++jj) {
-      Z[ii * (n + 1) + jj] = Z[ii * (n + 1) + jj] - norm;
-    }
-  }
-  delete[] couplings;
-  delete[] log_mu;
-  delete[] log_nu;
-}
-
-bool SuperGlue::process_output(const BufferManager &buffers,
-                               Eigen::VectorXi &indices0,
+bool SuperGlue::process_output(Eigen::VectorXi &indices0,
                                Eigen::VectorXi &indices1,
                                Eigen::VectorXd &mscores0,
                                Eigen::VectorXd &mscores1) {
@@ -443,13 +223,21 @@ bool SuperGlue::process_output(const BufferManager &buffers,
     indices1_.clear();
     mscores0_.clear();
     mscores1_.clear();
-    auto *output_score = static_cast<float *>(buffers.getHostBuffer(superglue_config_.output_tensor_names[0]));
-    int scores_map_h = output_scores_dims_.d[1];
-    int scores_map_w = output_scores_dims_.d[2];
-    // auto *scores = new float[(scores_map_h + 1) * (scores_map_w + 1)];
-    //log_optimal_transport(output_score, scores, scores_map_h, scores_map_w);
-    //scores_map_h = scores_map_h + 1;
-    //scores_map_w = scores_map_w + 1;
+    const float *output_score = engine_->Output(superglue_config_.output_tensor_names[0]);
+    std::vector<int> output_scores_shape = engine_->OutputShape(superglue_config_.output_tensor_names[0]);
+    if (output_score == nullptr || output_scores_shape.size() != 3) {
+        return false;
+    }
+    int scores_map_h = output_scores_shape[1];
+    int scores_map_w = output_scores_shape[2];
+    // a model exported without the Sinkhorn iterations outputs the scores without the dustbins
+    if (scores_map_h == keypoints_0_num_ && scores_map_w == keypoints_1_num_) {
+        assignment_.resize((scores_map_h + 1) * (scores_map_w + 1));
+        optimal_transport_.Solve(output_score, scores_map_h, scores_map_w, 2.3457, 100, 1e-3, assignment_.data());
+        output_score = assignment_.data();
+        scores_map_h = scores_map_h + 1;
+        scores_map_w = scores_map_w + 1;
+    }
     decode(output_score, scores_map_h, scores_map_w, indices0_, indices1_, mscores0_, mscores1_);
     indices0.resize(indices0_.size());
     indices1.resize(indices1_.size());
@@ -469,38 +257,3 @@ bool SuperGlue::process_output(const BufferManager &buffers,
     }
     return true;
 }
-
-void SuperGlue::save_engine() {
-    if (superglue_config_.engine_file.empty()) return;
-    if (engine_ != nullptr) {
-        nvinfer1::IHostMemory *data = engine_->serialize();
-        std::ofstream file(superglue_config_.engine_file, std::ios::binary);;
-        if (!file) return;
-        file.write(reinterpret_cast<const char *>(data->data()), data->size());
-    }
-}
-
-bool SuperGlue::deserialize_engine() {
-    std::ifstream file(superglue_config_.engine_file, std::ios::binary);
-    if (file.is_open()) {
-        file.seekg(0, std::ifstream::end);
-        size_t size = file.tellg();
-        file.seekg(0, std::ifstream::beg);
-        char *model_stream = new char[size];
-        file.read(model_stream, size);
-        file.close();
-	nvinfer1::IRuntime *runtime = nvinfer1::createInferRuntime(gLogger);
-        // if (runtime == nullptr) return false;
-        if (runtime == nullptr) {
-            delete[] model_stream;
-            return false;
-        }
-        engine_ = std::shared_ptr<nvinfer1::ICudaEngine>(runtime->deserializeCudaEngine(model_stream, size));
-        delete[] model_stream;
-        if (engine_ == nullptr) return false;
-        return true;
-    }
-    return false;
-}
-
-
@@ -0,0 +1,182 @@
+#include "tensorrt_engine.h"
+
+#include <fstream>
+#include <iostream>
+
+using namespace tensorrt_log;
+using namespace tensorrt_buffer;
+
+nvinfer1::Dims ToTensorRTDims(const std::vector<int>& shape){
+  nvinfer1::Dims dims;
+  dims.nbDims = shape.size();
+  for(size_t i = 0; i < shape.size(); ++i){
+    dims.d[i] = shape[i];
+  }
+  return dims;
+}
+
+TensorRTEngine::TensorRTEngine(const InferenceEngineConfig& config) : _config(config), _engine(nullptr){
+  setReportableSeverity(Logger::Severity::kINTERNAL_ERROR);
+}
+
+bool TensorRTEngine::Build(){
+  if(!Deserialize() && !BuildFromOnnx()) return false;
+  return CreateContext();
+}
+
+bool TensorRTEngine::Deserialize(){
+  std::ifstream file(_config.engine_file, std::ios::binary);
+  if(!file.is_open()) return false;
+  file.seekg(0, std::ifstream::end);
+  size_t size = file.tellg();
+  file.seekg(0, std::ifstream::beg);
+  std::vector<char> model_stream(size);
+  file.read(model_stream.data(), size);
+  file.close();
+
+  TensorRTUniquePtr<nvinfer1::IRuntime> runtime{nvinfer1::createInferRuntime(gLogger.getTRTLogger())};
+  if(!runtime) return false;
+  _engine = std::shared_ptr<nvinfer1::ICudaEngine>(runtime->deserializeCudaEngine(model_stream.data(), size));
+  if(!_engine) return false;
+
+  if(!ProfileCoversInputs()){
+    std::cout << _config.engine_file << " was built for other input shapes, rebuilding it from " << _config.onnx_file << std::endl;
+    _engine = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool TensorRTEngine::ProfileCoversInputs(){
+  if(_engine->getNbOptimizationProfiles() < 1) return _config.input_profiles.empty();
+  for(const InputProfile& input : _config.input_profiles){
+    const int index = _engine->getBindingIndex(input.name.c_str());
+    if(index < 0 || !_engine->bindingIsInput(index)) return false;
+    nvinfer1::Dims min_dims = _engine->getProfileDimensions(index, 0, nvinfer1::OptProfileSelector::kMIN);
+    nvinfer1::Dims max_dims = _engine->getProfileDimensions(index, 0, nvinfer1::OptProfileSelector::kMAX);
+    if(min_dims.nbDims != (int)input.min_shape.size() || max_dims.nbDims != (int)input.max_shape.size()) return false;
+    for(int i = 0; i < min_dims.nbDims; ++i){
+      if(min_dims.d[i] > input.min_shape[i] || max_dims.d[i] < input.max_shape[i]) return false;
+    }
+  }
+  return true;
+}
+
+bool TensorRTEngine::BuildFromOnnx(){
+  auto builder = TensorRTUniquePtr<nvinfer1::IBuilder>(nvinfer1::createInferBuilder(gLogger.getTRTLogger()));
+  if(!builder) return false;
+  const auto explicit_batch = 1U << static_cast<uint32_t>(nvinfer1::NetworkDefinitionCreationFlag::kEXPLICIT_BATCH);
+  auto network = TensorRTUniquePtr<nvinfer1::INetworkDefinition>(builder->createNetworkV2(explicit_batch));
+  if(!network) return false;
+  auto config = TensorRTUniquePtr<nvinfer1::IBuilderConfig>(builder->createBuilderConfig());
+  if(!config) return false;
+  auto parser = TensorRTUniquePtr<nvonnxparser::IParser>(nvonnxparser::createParser(*network, gLogger.getTRTLogger()));
+  if(!parser) return false;
+
+  auto profile = builder->createOptimizationProfile();
+  if(!profile) return false;
+  for(const InputProfile& input : _config.input_profiles){
+    profile->setDimensions(input.name.c_str(), nvinfer1::OptProfileSelector::kMIN, ToTensorRTDims(input.min_shape));
+    profile->setDimensions(input.name.c_str(), nvinfer1::OptProfileSelector::kOPT, ToTensorRTDims(input.opt_shape));
+    profile->setDimensions(input.name.c_str(), nvinfer1::OptProfileSelector::kMAX, ToTensorRTDims(input.max_shape));
+  }
+  config->addOptimizationProfile(profile);
+
+  auto parsed = parser->parseFromFile(_config.onnx_file.c_str(), static_cast<int>(gLogger.getReportableSeverity()));
+  if(!parsed) return false;
+  if(_config.precision == TensorRTTF32){
+    config->setFlag(nvinfer1::BuilderFlag::kTF32);
+  }else{
+    config->setFlag(nvinfer1::BuilderFlag::kFP16);
+  }
+  enableDLA(builder.get(), config.get(), _config.dla_core);
+
+  auto profile_stream = makeCudaStream();
+  if(!profile_stream) return false;
+  config->setProfileStream(*profile_stream);
+  TensorRTUniquePtr<nvinfer1::IHostMemory> plan{builder->buildSerializedNetwork(*network, *config)};
+  if(!plan) return false;
+  TensorRTUniquePtr<nvinfer1::IRuntime> runtime{nvinfer1::createInferRuntime(gLogger.getTRTLogger())};
+  if(!runtime) return false;
+  _engine = std::shared_ptr<nvinfer1::ICudaEngine>(runtime->deserializeCudaEngine(plan->data(), plan->size()));
+  if(!_engine) return false;
+
+  SaveEngine();
+  return true;
+}
+
+void TensorRTEngine::SaveEngine(){
+  if(_config.engine_file.empty() || _engine == nullptr) return;
+  TensorRTUniquePtr<nvinfer1::IHostMemory> data{_engine->serialize()};
+  std::ofstream file(_config.engine_file, std::ios::binary);
+  if(!file || !data) return;
+  file.write(reinterpret_cast<const char *>(data->data()), data->size());
+}
+
+bool TensorRTEngine::CreateContext(){
+  _context = std::shared_ptr<nvinfer1::IExecutionContext>(_engine->createExecutionContext());
+  if(!_context) return false;
+
+  _buffers.clear();
+  for(int i = 0; i < _engine->getNbBindings(); ++i){
+    std::unique_ptr<ManagedBuffer> buffer{new ManagedBuffer()};
+    nvinfer1::DataType type = _engine->getBindingDataType(i);
+    buffer->deviceBuffer = DeviceBuffer(type);
+    buffer->hostBuffer = HostBuffer(type);
+    _buffers.emplace_back(std::move(buffer));
+  }
+  _device_bindings.resize(_buffers.size(), nullptr);
+  return true;
+}
+
+float* TensorRTEngine::Input(const std::string& name, const std::vector<int>& shape){
+  const int index = _engine->getBindingIndex(name.c_str());
+  if(index < 0 || !_engine->bindingIsInput(index)) return nullptr;
+  nvinfer1::Dims dims = ToTensorRTDims(shape);
+  if(!_context->setBindingDimensions(index, dims)) return nullptr;
+  _buffers[index]->hostBuffer.resize(dims);
+  _buffers[index]->deviceBuffer.resize(dims);
+  return static_cast<float*>(_buffers[index]->hostBuffer.data());
+}
+
+bool TensorRTEngine::Run(){
+  if(!_context->allInputDimensionsSpecified()) return false;
+
+  for(size_t i = 0; i < _buffers.size(); ++i){
+    ManagedBuffer& buffer = *_buffers[i];
+    if(_engine->bindingIsInput(i)){
+      if(cudaMemcpy(buffer.deviceBuffer.data(), buffer.hostBuffer.data(), buffer.hostBuffer.nbBytes(),
+          cudaMemcpyHostToDevice) != cudaSuccess) return false;
+    }else{
+      nvinfer1::Dims dims = _context->getBindingDimensions(i);
+      buffer.hostBuffer.resize(dims);
+      buffer.deviceBuffer.resize(dims);
+    }
+    _device_bindings[i] = buffer.deviceBuffer.data();
+  }
+
+  if(!_context->executeV2(_device_bindings.data())) return false;
+
+  for(size_t i = 0; i < _buffers.size(); ++i){
+    if(_engine->bindingIsInput(i)) continue;
+    ManagedBuffer& buffer = *_buffers[i];
+    if(cudaMemcpy(buffer.hostBuffer.data(), buffer.deviceBuffer.data(), buffer.deviceBuffer.nbBytes(),
+        cudaMemcpyDeviceToHost) != cudaSuccess) return false;
+  }
+  return true;
+}
+
+const float* TensorRTEngine::Output(const std::string& name){
+  const int index = _engine->getBindingIndex(name.c_str());
+  if(index < 0) return nullptr;
+  return static_cast<const float*>(_buffers[index]->hostBuffer.data());
+}
+
+std::vector<int> TensorRTEngine::OutputShape(const std::string& name){
+  std::vector<int> shape;
+  const int index = _engine->getBindingIndex(name.c_str());
+  if(index < 0) return shape;
+  nvinfer1::Dims dims = _context->getBindingDimensions(index);
+  shape.assign(dims.d, dims.d + dims.nbDims);
+  return shape;
+}
@@ -12,7 +12,8 @@ void ConvertVectorToRt(Eigen::Matrix<double, 7, 1>& m, Eigen::Matrix3d& R, Eigen
 }
 
 // (f1 - f2) * (f1 - f2) = f1 * f1 + f2 * f2 - 2 * f1 *f2 = 2 - 2 * f1 * f2 -> [0, 4]
-float DescriptorDistance(const Eigen::Matrix<float, 256, 1>& f1, const Eigen::Matrix<float, 256, 1>& f2){
+float DescriptorDistance(const Eigen::Ref<const Eigen::Matrix<float, 256, 1>>& f1, 
+    const Eigen::Ref<const Eigen::Matrix<float, 256, 1>>& f2){
   return 2 * (1.0 - f1.transpose() * f2);
 }
 
@@ -104,7 +105,7 @@ cv::Mat DrawFeatures(const cv::Mat& image, const std::vector<cv::KeyPoint>& keyp
 
 cv::Mat DrawFeatures(const cv::Mat& image, const std::vector<cv::KeyPoint>& keypoints, 
     const std::vector<bool>& inliers, const std::vector<Eigen::Vector4d>& lines, 
-    const std::vector<int>& line_track_ids, const std::vector<std::map<int, double>>& points_on_lines){
+    const std::vector<int>& line_track_ids, const PointsOnLines& points_on_lines){
   cv::Mat img_color;
   cv::cvtColor(image, img_color, cv::COLOR_GRAY2RGB);
 
@@ -123,10 +124,10 @@ cv::Mat DrawFeatures(const cv::Mat& image, const std::vector<cv::KeyPoint>& keyp
     cv::putText(img_color, std::to_string(line_track_ids[i]), cv::Point((int)((line(0)+line(2))/2), 
         (int)((line(1)+line(3))/2)), cv::FONT_HERSHEY_DUPLEX, 1.0, color, 2);
 
-    for(auto& kv : points_on_lines[i]){
-      colors[kv.first] = color;
-      // radii[kv.first] *= 2;
-      radii[kv.first] = 3;
+    for(const PointOnLine& point : points_on_lines[i]){
+      colors[point.index] = color;
+      // radii[point.index] *= 2;
+      radii[point.index] = 3;
     }
   }
 